@@ -0,0 +1,222 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "admission.h"
+#include "utils.h"
+
+void
+ptest_admission_init(struct ptest_admission *adm)
+{
+	adm->proc = ADMISSION_DEFAULT_PROC;
+	adm->cpu = -1;
+	adm->memory = -1;
+	adm->io = -1;
+	adm->mem_available_kb = 0;
+	adm->max_wait = ADMISSION_DEFAULT_MAX_WAIT;
+}
+
+/* spec is a comma separated list of cpu, memory, io, mem_available and max_wait. */
+int
+ptest_admission_parse(struct ptest_admission *adm, const char *spec)
+{
+	char *s, *tok, *saveptr;
+	int rc = 0;
+
+	s = strdup(spec);
+	CHECK_ALLOCATION(s, strlen(spec), 0);
+	if (s == NULL)
+		return -1;
+
+	for (tok = strtok_r(s, ",", &saveptr); tok != NULL;
+	     tok = strtok_r(NULL, ",", &saveptr)) {
+		char *value = strchr(tok, '=');
+		char *end;
+		double d;
+
+		if (value == NULL) {
+			rc = -1;
+			break;
+		}
+		*value++ = '\0';
+
+		errno = 0;
+		d = strtod(value, &end);
+		if (errno != 0 || end == value || *end != '\0' || d < 0) {
+			rc = -1;
+			break;
+		}
+
+		if (strcmp(tok, "cpu") == 0)
+			adm->cpu = d;
+		else if (strcmp(tok, "memory") == 0)
+			adm->memory = d;
+		else if (strcmp(tok, "io") == 0)
+			adm->io = d;
+		else if (strcmp(tok, "mem_available") == 0)
+			adm->mem_available_kb = (long) d;
+		else if (strcmp(tok, "max_wait") == 0)
+			adm->max_wait = (unsigned int) d;
+		else {
+			rc = -1;
+			break;
+		}
+	}
+
+	if (rc == -1)
+		fprintf(stderr, "Invalid admission '%s', expected cpu=, memory=, io=,"
+				" mem_available= or max_wait= separated by commas.\n", spec);
+	free(s);
+
+	return rc;
+}
+
+/* avg10 of the "some" line, 0 when PSI isn't available. */
+static double
+read_psi(const char *proc, const char *resource)
+{
+	char path[PATH_MAX];
+	double avg10 = 0;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/pressure/%s", proc, resource);
+	fp = fopen(path, "re");
+	if (fp == NULL)
+		return 0;
+	if (fscanf(fp, "some avg10=%lf", &avg10) != 1)
+		avg10 = 0;
+	fclose(fp);
+
+	return avg10;
+}
+
+static long
+read_mem_available(const char *proc)
+{
+	char path[PATH_MAX], line[256];
+	long kb = -1;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/meminfo", proc);
+	fp = fopen(path, "re");
+	if (fp == NULL)
+		return -1;
+	while (fgets(line, sizeof(line), fp) != NULL)
+		if (sscanf(line, "MemAvailable: %ld kB", &kb) == 1)
+			break;
+	fclose(fp);
+
+	return kb;
+}
+
+int
+ptest_pressure_read(const char *proc, struct ptest_pressure *pr)
+{
+	pr->cpu = read_psi(proc, "cpu");
+	pr->memory = read_psi(proc, "memory");
+	pr->io = read_psi(proc, "io");
+	pr->mem_available_kb = read_mem_available(proc);
+
+	return 0;
+}
+
+/*
+ * Returns which threshold is exceeded, 0 for none, with a description
+ * in reason when a launch has to wait.
+ */
+int
+ptest_admission_check(const struct ptest_admission *adm,
+		const struct ptest_pressure *pr, char *reason, size_t size)
+{
+	if (adm->memory >= 0 && pr->memory > adm->memory) {
+		snprintf(reason, size, "memory pressure %.2f > %.2f",
+				pr->memory, adm->memory);
+		return 1;
+	}
+	if (adm->mem_available_kb > 0 && pr->mem_available_kb >= 0 &&
+	    pr->mem_available_kb < adm->mem_available_kb) {
+		snprintf(reason, size, "MemAvailable %ld kB < %ld kB",
+				pr->mem_available_kb, adm->mem_available_kb);
+		return 2;
+	}
+	if (adm->io >= 0 && pr->io > adm->io) {
+		snprintf(reason, size, "io pressure %.2f > %.2f", pr->io, adm->io);
+		return 3;
+	}
+	if (adm->cpu >= 0 && pr->cpu > adm->cpu) {
+		snprintf(reason, size, "cpu pressure %.2f > %.2f", pr->cpu, adm->cpu);
+		return 4;
+	}
+
+	return 0;
+}
+
+/*
+ * Block until the system is below the thresholds or max_wait passed,
+ * logging to fp when and why a ptest was held back. Waits on the clock
+ * of be, the system for NULL. Returns the milliseconds waited.
+ */
+int64_t
+ptest_admission_wait(const struct ptest_admission *adm, const char *ptest,
+		const struct ptest_backend *be, FILE *fp)
+{
+	struct ptest_pressure pr;
+	char reason[128];
+	int64_t start = ptest_backend_clock_ms(be), waited = 0;
+	int blocked, last = 0;
+
+	for (;;) {
+		ptest_pressure_read(adm->proc, &pr);
+		blocked = ptest_admission_check(adm, &pr, reason, sizeof(reason));
+		if (!blocked)
+			break;
+
+		waited = ptest_backend_clock_ms(be) - start;
+		if (waited >= (int64_t) adm->max_wait * 1000) {
+			fprintf(fp, "ADMITTED: %s after %jd ms, still %s\n", ptest,
+					(intmax_t) waited, reason);
+			return waited;
+		}
+
+		/* Only log when the reason changes, not every poll. */
+		if (blocked != last) {
+			fprintf(fp, "DELAYED: %s, %s\n", ptest, reason);
+			fflush(fp);
+			last = blocked;
+		}
+		ptest_backend_sleep(be, ADMISSION_POLL_MS);
+	}
+
+	waited = ptest_backend_clock_ms(be) - start;
+	if (last)
+		fprintf(fp, "ADMITTED: %s after %jd ms\n", ptest, (intmax_t) waited);
+
+	return waited;
+}
@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_ADMISSION_H
+#define PTEST_RUNNER_ADMISSION_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define ADMISSION_DEFAULT_PROC "/proc"
+#define ADMISSION_DEFAULT_MAX_WAIT 300
+#define ADMISSION_POLL_MS 500
+
+/*
+ * Thresholds checked before every ptest launch, pressures are the "some"
+ * avg10 percentages of /proc/pressure/{cpu,memory,io}, mem_available_kb
+ * the minimum MemAvailable. A negative pressure or 0 KiB disables the
+ * check. After max_wait seconds the ptest is started anyway.
+ */
+struct ptest_admission {
+	const char *proc;
+	double cpu;
+	double memory;
+	double io;
+	long mem_available_kb;
+	unsigned int max_wait;
+	int padding1;
+};
+
+struct ptest_pressure {
+	double cpu;
+	double memory;
+	double io;
+	long mem_available_kb;
+};
+
+extern void ptest_admission_init(struct ptest_admission *);
+extern int ptest_admission_parse(struct ptest_admission *, const char *);
+extern int ptest_pressure_read(const char *, struct ptest_pressure *);
+extern int ptest_admission_check(const struct ptest_admission *,
+		const struct ptest_pressure *, char *, size_t);
+struct ptest_backend;
+
+extern int64_t ptest_admission_wait(const struct ptest_admission *,
+		const char *, const struct ptest_backend *, FILE *);
+
+#endif // PTEST_RUNNER_ADMISSION_H
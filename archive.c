@@ -0,0 +1,446 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "archive.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+#define ARCHIVE_HEADER_SIZE 16
+#define ARCHIVE_TRAILER_SIZE 24
+
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 127)
+#define LZ_MAX_LITERALS 128
+#define LZ_MAX_OFFSET 65535
+
+static void
+put_le(unsigned char *buf, uint64_t v, int bytes)
+{
+	int i;
+
+	for (i = 0; i < bytes; i++)
+		buf[i] = (unsigned char) (v >> (8 * i));
+}
+
+static uint64_t
+get_le(const unsigned char *buf, int bytes)
+{
+	uint64_t v = 0;
+	int i;
+
+	for (i = bytes - 1; i >= 0; i--)
+		v = (v << 8) | buf[i];
+
+	return v;
+}
+
+static size_t
+lz_literals(const unsigned char *in, size_t len, unsigned char *out)
+{
+	size_t o = 0, n;
+
+	while (len > 0) {
+		n = len > LZ_MAX_LITERALS ? LZ_MAX_LITERALS : len;
+		out[o++] = (unsigned char) (n - 1);
+		memcpy(out + o, in, n);
+		o += n;
+		in += n;
+		len -= n;
+	}
+
+	return o;
+}
+
+/*
+ * Byte oriented LZ77 for blocks of at most 64 KiB. A control byte below
+ * 0x80 is followed by that many plus one literals, otherwise its low
+ * bits plus LZ_MIN_MATCH bytes are copied from a little endian u16
+ * distance back. Cheap enough to run on every output block, test logs
+ * are repetitive enough for it to pay off.
+ */
+size_t
+ptest_lz_compress(const unsigned char *in, size_t len, unsigned char *out)
+{
+	int table[1 << LZ_HASH_BITS];
+	size_t i = 0, lit = 0, o = 0, m;
+	uint32_t v, h;
+
+	memset(table, 0xff, sizeof(table));
+
+	while (i + LZ_MIN_MATCH <= len) {
+		memcpy(&v, in + i, sizeof(v));
+		h = (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+		int ref = table[h];
+		table[h] = (int) i;
+
+		if (ref < 0 || i - (size_t) ref > LZ_MAX_OFFSET ||
+		    memcmp(in + ref, in + i, LZ_MIN_MATCH) != 0) {
+			i++;
+			continue;
+		}
+
+		o += lz_literals(in + lit, i - lit, out + o);
+		for (m = LZ_MIN_MATCH; i + m < len && m < LZ_MAX_MATCH &&
+		    in[(size_t) ref + m] == in[i + m]; m++)
+			;
+		out[o++] = (unsigned char) (0x80 | (m - LZ_MIN_MATCH));
+		put_le(out + o, i - (size_t) ref, 2);
+		o += 2;
+		i += m;
+		lit = i;
+	}
+	o += lz_literals(in + lit, len - lit, out + o);
+
+	return o;
+}
+
+long
+ptest_lz_decompress(const unsigned char *in, size_t len, unsigned char *out,
+		size_t size)
+{
+	size_t i = 0, o = 0, n, dist;
+
+	while (i < len) {
+		unsigned char c = in[i++];
+
+		if (c < 0x80) {
+			n = (size_t) c + 1;
+			if (i + n > len || o + n > size)
+				return -1;
+			memcpy(out + o, in + i, n);
+			i += n;
+		} else {
+			n = (size_t) (c & 0x7f) + LZ_MIN_MATCH;
+			if (i + 2 > len)
+				return -1;
+			dist = (size_t) get_le(in + i, 2);
+			i += 2;
+			if (dist == 0 || dist > o || o + n > size)
+				return -1;
+			/* Overlapping copies repeat the last bytes, go one by one. */
+			for (; n > 0; n--, o++)
+				out[o] = out[o - dist];
+			continue;
+		}
+		o += n;
+	}
+
+	return (long) o;
+}
+
+static void
+archive_flush_block(struct ptest_archive *a)
+{
+	unsigned char hdr[8];
+	size_t n;
+
+	if (a->len == 0)
+		return;
+
+	n = ptest_lz_compress(a->block, a->len, a->packed);
+	put_le(hdr, a->len, 4);
+	if (n >= a->len) {
+		put_le(hdr + 4, a->len, 4);
+		fwrite(hdr, sizeof(hdr), 1, a->fp);
+		fwrite(a->block, a->len, 1, a->fp);
+		n = a->len;
+	} else {
+		put_le(hdr + 4, n, 4);
+		fwrite(hdr, sizeof(hdr), 1, a->fp);
+		fwrite(a->packed, n, 1, a->fp);
+	}
+	a->offset += sizeof(hdr) + n;
+	a->len = 0;
+}
+
+static void
+archive_start(void *data, const struct ptest_list *p, pid_t pid)
+{
+	struct ptest_archive *a = data;
+
+	a->start = a->offset;
+	a->raw = 0;
+	a->len = 0;
+	a->running = 1;
+}
+
+static void
+archive_output(void *data, const struct ptest_list *p, int stream,
+		const char *buf, size_t len)
+{
+	struct ptest_archive *a = data;
+	size_t n;
+
+	a->raw += len;
+	while (len > 0) {
+		n = ARCHIVE_BLOCK_SIZE - a->len;
+		if (n > len)
+			n = len;
+		memcpy(a->block + a->len, buf, n);
+		a->len += n;
+		buf += n;
+		len -= n;
+		if (a->len == ARCHIVE_BLOCK_SIZE)
+			archive_flush_block(a);
+	}
+}
+
+static void
+archive_end(void *data, const struct ptest_list *p)
+{
+	struct ptest_archive *a = data;
+	struct ptest_archive_entry *e;
+
+	archive_flush_block(a);
+	a->running = 0;
+
+	e = realloc(a->entries, (a->entries_no + 1) * sizeof(*e));
+	CHECK_ALLOCATION(e, (a->entries_no + 1) * sizeof(*e), 0);
+	if (e == NULL)
+		return;
+	a->entries = e;
+	e += a->entries_no;
+	e->name = strdup(p->ptest);
+	CHECK_ALLOCATION(e->name, strlen(p->ptest) + 1, 0);
+	if (e->name == NULL)
+		return;
+	e->offset = a->start;
+	e->size = a->offset - a->start;
+	e->raw = a->raw;
+	e->status = (uint32_t) p->status;
+	a->entries_no++;
+}
+
+/* Keeps the output of a ptest cut short by the time budget. */
+static void
+archive_skipped(void *data, const struct ptest_list *p, const char *reason)
+{
+	struct ptest_archive *a = data;
+
+	if (a->running)
+		archive_end(data, p);
+}
+
+struct ptest_archive *
+ptest_archive_open(const char *file)
+{
+	struct ptest_archive *a;
+	unsigned char hdr[ARCHIVE_HEADER_SIZE];
+
+	a = calloc(1, sizeof(struct ptest_archive));
+	CHECK_ALLOCATION(a, sizeof(struct ptest_archive), 0);
+	if (a == NULL)
+		return NULL;
+
+	a->fp = fopen(file, "we");
+	if (a->fp == NULL) {
+		fprintf(stderr, "Archive '%s' could not be opened. %s.\n",
+				file, strerror(errno));
+		free(a);
+		return NULL;
+	}
+
+	memcpy(hdr, ARCHIVE_MAGIC, 8);
+	put_le(hdr + 8, ARCHIVE_VERSION, 4);
+	put_le(hdr + 12, ARCHIVE_BLOCK_SIZE, 4);
+	fwrite(hdr, sizeof(hdr), 1, a->fp);
+	a->offset = sizeof(hdr);
+
+	a->callbacks.start = archive_start;
+	a->callbacks.output = archive_output;
+	a->callbacks.end = archive_end;
+	a->callbacks.skipped = archive_skipped;
+	a->callbacks.data = a;
+
+	return a;
+}
+
+/* Writes the index, returns -1 if anything written to the archive failed. */
+int
+ptest_archive_close(struct ptest_archive *a)
+{
+	unsigned char buf[ARCHIVE_TRAILER_SIZE];
+	uint64_t index = 0;
+	size_t i, n;
+	int rc;
+
+	if (a == NULL)
+		return 0;
+
+	index = a->offset;
+	for (i = 0; i < a->entries_no; i++) {
+		struct ptest_archive_entry *e = &a->entries[i];
+
+		n = strlen(e->name);
+		put_le(buf, n, 2);
+		fwrite(buf, 2, 1, a->fp);
+		fwrite(e->name, n, 1, a->fp);
+		put_le(buf, e->offset, 8);
+		put_le(buf + 8, e->size, 8);
+		put_le(buf + 16, e->raw, 8);
+		fwrite(buf, 24, 1, a->fp);
+		put_le(buf, e->status, 4);
+		fwrite(buf, 4, 1, a->fp);
+		free(e->name);
+	}
+
+	memcpy(buf, ARCHIVE_INDEX_MAGIC, 8);
+	put_le(buf + 8, index, 8);
+	put_le(buf + 16, a->entries_no, 4);
+	put_le(buf + 20, 0, 4);
+	fwrite(buf, sizeof(buf), 1, a->fp);
+
+	rc = ferror(a->fp) ? -1 : 0;
+	if (fclose(a->fp) != 0)
+		rc = -1;
+	free(a->entries);
+	free(a);
+
+	return rc;
+}
+
+static int
+archive_show_blocks(const unsigned char *map, uint64_t offset, uint64_t size,
+		FILE *fp)
+{
+	unsigned char out[ARCHIVE_BLOCK_SIZE];
+	const unsigned char *b = map + offset, *end = b + size;
+	size_t raw, stored;
+	long n;
+
+	while (b < end) {
+		if (end - b < 8)
+			return -1;
+		raw = (size_t) get_le(b, 4);
+		stored = (size_t) get_le(b + 4, 4);
+		b += 8;
+		if (raw > ARCHIVE_BLOCK_SIZE || stored > (size_t) (end - b))
+			return -1;
+		if (stored == raw) {
+			fwrite(b, raw, 1, fp);
+		} else {
+			n = ptest_lz_decompress(b, stored, out, sizeof(out));
+			if (n != (long) raw)
+				return -1;
+			fwrite(out, raw, 1, fp);
+		}
+		b += stored;
+	}
+
+	return 0;
+}
+
+/*
+ * Writes the output of ptest name from the archive to fp, only the
+ * index and that ptest's blocks are paged in. Returns 0 when found,
+ * 1 when the archive has no such ptest and -1 on errors.
+ */
+int
+ptest_archive_show(const char *file, const char *name, FILE *fp)
+{
+	const unsigned char *map, *e, *end;
+	uint64_t index, offset, size;
+	size_t entries, n, i;
+	struct stat st;
+	int fd, rc = -1;
+
+	fd = open(file, O_RDONLY | O_CLOEXEC);
+	if (fd == -1 || fstat(fd, &st) == -1) {
+		fprintf(stderr, "Archive '%s' could not be opened. %s.\n",
+				file, strerror(errno));
+		if (fd != -1)
+			close(fd);
+		return -1;
+	}
+	if (st.st_size < ARCHIVE_HEADER_SIZE + ARCHIVE_TRAILER_SIZE) {
+		fprintf(stderr, "Archive '%s' is truncated.\n", file);
+		close(fd);
+		return -1;
+	}
+
+	map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "Archive '%s' could not be mapped. %s.\n",
+				file, strerror(errno));
+		return -1;
+	}
+
+	end = map + st.st_size - ARCHIVE_TRAILER_SIZE;
+	index = get_le(end + 8, 8);
+	entries = (size_t) get_le(end + 16, 4);
+	if (memcmp(map, ARCHIVE_MAGIC, 8) != 0 ||
+	    get_le(map + 8, 4) != ARCHIVE_VERSION ||
+	    memcmp(end, ARCHIVE_INDEX_MAGIC, 8) != 0 ||
+	    index < ARCHIVE_HEADER_SIZE || index > (uint64_t) (end - map)) {
+		fprintf(stderr, "Archive '%s' has no valid index.\n", file);
+		goto out;
+	}
+
+	for (e = map + index, i = 0; i < entries; i++) {
+		if (end - e < 2)
+			break;
+		n = (size_t) get_le(e, 2);
+		if ((size_t) (end - e) < 2 + n + 28)
+			break;
+		if (strlen(name) != n || memcmp(e + 2, name, n) != 0) {
+			e += 2 + n + 28;
+			continue;
+		}
+
+		offset = get_le(e + 2 + n, 8);
+		size = get_le(e + 2 + n + 8, 8);
+		if (offset > index || size > index - offset ||
+		    archive_show_blocks(map, offset, size, fp) == -1) {
+			fprintf(stderr, "Archive '%s' is corrupted.\n", file);
+			goto out;
+		}
+		rc = 0;
+		goto out;
+	}
+
+	if (i < entries)
+		fprintf(stderr, "Archive '%s' is corrupted.\n", file);
+	else {
+		fprintf(stderr, "No ptest '%s' in archive '%s'.\n", name, file);
+		rc = 1;
+	}
+
+out:
+	munmap((void *) map, (size_t) st.st_size);
+	return rc;
+}
@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_ARCHIVE_H
+#define PTEST_RUNNER_ARCHIVE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "utils.h"
+
+#define ARCHIVE_MAGIC "PTESTLOG"
+#define ARCHIVE_INDEX_MAGIC "PTESTIDX"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_BLOCK_SIZE 65536
+/* Worst case of ptest_lz_compress(), one extra byte per 128 literals. */
+#define ARCHIVE_PACKED_SIZE (ARCHIVE_BLOCK_SIZE + ARCHIVE_BLOCK_SIZE / 128 + 16)
+
+/*
+ * Single file holding the output of every ptest, written while the run
+ * goes on and indexed at the end. All integers are little endian.
+ *
+ *   header  "PTESTLOG" u32 version u32 block size
+ *   blocks  u32 raw length, u32 stored length, stored bytes; a stored
+ *           length equal to the raw one means the block is not
+ *           compressed, see ptest_lz_compress()
+ *   index   per ptest: u16 name length, name, u64 offset of its first
+ *           block, u64 bytes of blocks, u64 raw bytes, u32 status
+ *   trailer "PTESTIDX" u64 index offset, u32 entries, u32 zero
+ *
+ * Output of one ptest is a run of consecutive blocks, the index is only
+ * written by ptest_archive_close() so an interrupted run leaves no index.
+ */
+struct ptest_archive_entry {
+	char *name;
+	uint64_t offset;
+	uint64_t size;
+	uint64_t raw;
+	uint32_t status;
+	uint32_t padding1;
+};
+
+struct ptest_archive {
+	FILE *fp;
+	uint64_t offset;
+	uint64_t start;
+	uint64_t raw;
+	size_t len;
+	struct ptest_archive_entry *entries;
+	size_t entries_no;
+	int running;
+	int padding1;
+	unsigned char block[ARCHIVE_BLOCK_SIZE];
+	unsigned char packed[ARCHIVE_PACKED_SIZE];
+
+	struct ptest_callbacks callbacks;
+};
+
+extern size_t ptest_lz_compress(const unsigned char *, size_t, unsigned char *);
+extern long ptest_lz_decompress(const unsigned char *, size_t, unsigned char *,
+		size_t);
+
+extern struct ptest_archive *ptest_archive_open(const char *);
+extern int ptest_archive_close(struct ptest_archive *);
+extern int ptest_archive_show(const char *, const char *, FILE *);
+
+#endif // PTEST_RUNNER_ARCHIVE_H
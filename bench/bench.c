@@ -0,0 +1,367 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+/*
+ * Runner benchmark, generates a synthetic ptest tree and measures the
+ * runner overhead on it. Results are printed as a single JSON object so
+ * they can be compared between releases.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <ftw.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "ptest_runner.h"
+
+#define BENCH_VERSION 1
+#define BENCH_DEFAULT_PTESTS 2000
+#define BENCH_DEFAULT_SPAWNS 200
+#define BENCH_DEFAULT_OUTPUT_MB 64
+#define BENCH_DEFAULT_RATE 100
+#define BENCH_DEFAULT_REPEAT 5
+/* Inactivity timeout of the runs that must not time out, 0 kills at once. */
+#define BENCH_TIMEOUT 60
+#define BENCH_HANG_TIMEOUT 1
+
+struct bench {
+	int64_t run_start_us;
+	int64_t start_us;
+	int64_t last_end_us;
+	int64_t spawn_gap_us;
+	int64_t relay_us;
+	uint64_t output_bytes;
+	int spawns;
+	int padding1;
+};
+
+static int64_t
+bench_clock_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+bench_run_start(void *data, int ptests)
+{
+	struct bench *b = data;
+
+	b->run_start_us = b->last_end_us = bench_clock_us();
+}
+
+/* Time from the previous ptest end (or run start) until the next fork. */
+static void
+bench_start(void *data, const struct ptest_list *p, pid_t pid)
+{
+	struct bench *b = data;
+
+	b->start_us = bench_clock_us();
+	b->spawn_gap_us += b->start_us - b->last_end_us;
+	b->spawns++;
+}
+
+static void
+bench_output(void *data, const struct ptest_list *p, int stream,
+		const char *buf, size_t len)
+{
+	struct bench *b = data;
+
+	b->output_bytes += len;
+}
+
+static void
+bench_end(void *data, const struct ptest_list *p)
+{
+	struct bench *b = data;
+
+	b->last_end_us = bench_clock_us();
+	b->relay_us += b->last_end_us - b->start_us;
+}
+
+static int
+write_ptest(const char *root, const char *name, const char *fmt, ...)
+{
+	char path[PATH_MAX];
+	va_list ap;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/%s", root, name);
+	if (mkdir(path, 0755) == -1)
+		return -1;
+	snprintf(path, sizeof(path), "%s/%s/ptest", root, name);
+	if (mkdir(path, 0755) == -1)
+		return -1;
+	snprintf(path, sizeof(path), "%s/%s/ptest/run-ptest", root, name);
+	fp = fopen(path, "w");
+	if (fp == NULL)
+		return -1;
+
+	fprintf(fp, "#!/bin/sh\n");
+	va_start(ap, fmt);
+	vfprintf(fp, fmt, ap);
+	va_end(ap);
+	fclose(fp);
+
+	return chmod(path, 0755);
+}
+
+/*
+ * ptests instant-N exit at once, every tenth one has a link-N symlink
+ * duplicate and a nodir-N without run-ptest. output writes output_mb
+ * as fast as possible, trickle writes rate lines during one second and
+ * hang never exits.
+ */
+static int
+generate_tree(const char *root, int ptests, int output_mb, int rate)
+{
+	char name[NAME_MAX], path[PATH_MAX];
+	int i;
+
+	for (i = 0; i < ptests; i++) {
+		snprintf(name, sizeof(name), "instant-%05d", i);
+		if (write_ptest(root, name, "exit 0\n") == -1)
+			return -1;
+
+		if (i % 10)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/link-%05d", root, i);
+		if (symlink(name, path) == -1)
+			return -1;
+		snprintf(path, sizeof(path), "%s/nodir-%05d", root, i);
+		if (mkdir(path, 0755) == -1)
+			return -1;
+	}
+
+	if (write_ptest(root, "output", "yes 0123456789abcdef0123456789abcdef"
+			" | head -c %d\n", output_mb * 1024 * 1024) == -1)
+		return -1;
+	if (write_ptest(root, "trickle", "i=0\nwhile [ $i -lt %d ]; do\n"
+			"\techo line $i\n\tsleep %f\n\ti=$((i + 1))\ndone\n",
+			rate, 1.0 / rate) == -1)
+		return -1;
+	if (write_ptest(root, "hang", "while true; do\n\tsleep 1\ndone\n") == -1)
+		return -1;
+
+	return 0;
+}
+
+static int
+remove_entry(const char *path, const struct stat *st, int flag,
+		struct FTW *ftw)
+{
+	return remove(path);
+}
+
+static int
+bench_run(struct ptest_list *head, char **names, int names_no,
+		unsigned int timeout, struct bench *b)
+{
+	struct ptest_list *filtered;
+	struct ptest_options opts;
+	struct ptest_callbacks callbacks = {
+		.run_start = bench_run_start,
+		.start = bench_start,
+		.output = bench_output,
+		.end = bench_end,
+		.data = b,
+	};
+	FILE *out;
+	int rc;
+
+	memset(b, 0, sizeof(struct bench));
+	memset(&opts, 0, sizeof(opts));
+	opts.timeout = timeout;
+	opts.callbacks = &callbacks;
+
+	filtered = filter_ptests(head, names, names_no);
+	if (filtered == NULL)
+		return -1;
+
+	out = fopen("/dev/null", "w");
+	rc = run_ptests(filtered, &opts, "ptest-runner-bench", out, out);
+	fclose(out);
+	ptest_list_free_all(filtered);
+
+	return rc;
+}
+
+static inline void
+print_usage(FILE *stream, char *progname)
+{
+	fprintf(stream, "Usage: %s [-n ptests] [-k spawns] [-s output_mb]"
+			" [-r lines_per_second] [-R repeat] [-d dir] [-o file] [-h]\n",
+			progname);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int ptests = BENCH_DEFAULT_PTESTS;
+	int spawns = BENCH_DEFAULT_SPAWNS;
+	int output_mb = BENCH_DEFAULT_OUTPUT_MB;
+	int rate = BENCH_DEFAULT_RATE;
+	int repeat = BENCH_DEFAULT_REPEAT;
+	char tmpdir[] = "/tmp/ptest-bench-XXXXXX";
+	char *root = NULL, *output = NULL;
+	char **names, *name;
+	struct ptest_list *head = NULL;
+	struct bench b;
+	struct rusage ru;
+	int64_t discovery_us, start_us;
+	int found = 0, opt, i;
+	FILE *fp;
+
+	while ((opt = getopt(argc, argv, "n:k:s:r:R:d:o:h")) != -1) {
+		switch (opt) {
+			case 'n':
+				ptests = atoi(optarg);
+			break;
+			case 'k':
+				spawns = atoi(optarg);
+			break;
+			case 's':
+				output_mb = atoi(optarg);
+			break;
+			case 'r':
+				rate = atoi(optarg);
+			break;
+			case 'R':
+				repeat = atoi(optarg);
+			break;
+			case 'd':
+				root = optarg;
+			break;
+			case 'o':
+				output = optarg;
+			break;
+			case 'h':
+				print_usage(stdout, argv[0]);
+				exit(0);
+			default:
+				print_usage(stderr, argv[0]);
+				exit(1);
+		}
+	}
+
+	if (ptests < 1 || spawns < 1 || rate < 1 || repeat < 1 || output_mb < 0) {
+		print_usage(stderr, argv[0]);
+		exit(1);
+	}
+	if (spawns > ptests)
+		spawns = ptests;
+
+	/* An existing tree given with -d is reused and kept. */
+	if (root == NULL) {
+		root = mkdtemp(tmpdir);
+		if (root == NULL || generate_tree(root, ptests, output_mb, rate) == -1) {
+			fprintf(stderr, "Failed to generate ptest tree. %s.\n",
+					strerror(errno));
+			exit(1);
+		}
+	}
+
+	start_us = bench_clock_us();
+	for (i = 0; i < repeat; i++) {
+		ptest_list_free_all(head);
+		head = get_available_ptests(root);
+		if (head == NULL)
+			exit(1);
+	}
+	discovery_us = (bench_clock_us() - start_us) / repeat;
+	found = ptest_list_length(head);
+
+	fp = output ? fopen(output, "w") : stdout;
+	if (fp == NULL) {
+		fprintf(stderr, "Output file '%s' could not be created. %s.\n",
+				output, strerror(errno));
+		exit(1);
+	}
+
+	fprintf(fp, "{\"bench_version\":%d,\"api_version\":%d,\"ptests\":%d"
+			",\"discovery_ms\":%.3f,\"discovery_us_per_ptest\":%.3f",
+			BENCH_VERSION, PTEST_RUNNER_API_VERSION, found,
+			discovery_us / 1000.0, (double) discovery_us / found);
+
+	names = calloc((size_t) spawns, sizeof(char *));
+	CHECK_ALLOCATION(names, (size_t) spawns, 1);
+	for (i = 0; i < spawns; i++) {
+		if (asprintf(&name, "instant-%05d", i) == -1)
+			exit(1);
+		names[i] = name;
+	}
+	bench_run(head, names, spawns, BENCH_TIMEOUT, &b);
+	fprintf(fp, ",\"spawns\":%d,\"spawn_gap_us\":%.1f,\"ptest_us\":%.1f",
+			b.spawns, (double) b.spawn_gap_us / b.spawns,
+			(double) (b.last_end_us - b.run_start_us) / b.spawns);
+	for (i = 0; i < spawns; i++)
+		free(names[i]);
+	free(names);
+
+	name = "output";
+	bench_run(head, &name, 1, BENCH_TIMEOUT, &b);
+	fprintf(fp, ",\"output_bytes\":%" PRIu64 ",\"output_ms\":%.3f"
+			",\"output_mb_s\":%.1f", b.output_bytes, b.relay_us / 1000.0,
+			b.relay_us ? b.output_bytes / (1024.0 * 1024.0) /
+			(b.relay_us / 1000000.0) : 0);
+
+	name = "trickle";
+	bench_run(head, &name, 1, BENCH_TIMEOUT, &b);
+	fprintf(fp, ",\"trickle_rate\":%d,\"trickle_ms\":%.3f", rate,
+			b.relay_us / 1000.0);
+
+	name = "hang";
+	bench_run(head, &name, 1, BENCH_HANG_TIMEOUT, &b);
+	fprintf(fp, ",\"timeout_overshoot_ms\":%.3f",
+			(b.relay_us - BENCH_HANG_TIMEOUT * 1000000) / 1000.0);
+
+	getrusage(RUSAGE_SELF, &ru);
+	fprintf(fp, ",\"runner_utime_ms\":%jd,\"runner_stime_ms\":%jd"
+			",\"runner_maxrss_kb\":%ld}\n",
+			(intmax_t) ru.ru_utime.tv_sec * 1000 + ru.ru_utime.tv_usec / 1000,
+			(intmax_t) ru.ru_stime.tv_sec * 1000 + ru.ru_stime.tv_usec / 1000,
+			ru.ru_maxrss);
+	if (output)
+		fclose(fp);
+
+	ptest_list_free_all(head);
+	if (root == tmpdir)
+		nftw(root, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+	return 0;
+}
@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/stat.h>
+
+#include "budget.h"
+#include "history.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+struct budget_item {
+	struct ptest_list *p;
+	int64_t cost_ms;
+	double value;
+	double priority;
+	int changed;
+	int selected;
+};
+
+static int
+cmp_priority(const void *a, const void *b)
+{
+	const struct budget_item *x = a, *y = b;
+
+	if (x->priority != y->priority)
+		return (x->priority < y->priority) - (x->priority > y->priority);
+
+	return strcmp(x->p->ptest, y->p->ptest);
+}
+
+static void
+budget_estimate(struct budget_item *it, const struct ptest_history *h)
+{
+	const struct ptest_history_entry *e = ptest_history_find(h, it->p->ptest);
+	double weight = 1, weights = 0, failures = 0;
+	int64_t total = 0;
+	struct stat st;
+	int i;
+
+	/* Cached passes are reported without running. */
+	if (it->p->status == PTEST_STATUS_CACHED) {
+		it->cost_ms = 0;
+		it->value = 1;
+		return;
+	}
+
+	it->cost_ms = BUDGET_UNKNOWN_COST_MS;
+	if (e == NULL || e->samples_no == 0) {
+		it->changed = 1;
+		it->value = 3;
+		return;
+	}
+
+	for (i = e->samples_no - 1; i >= 0; i--) {
+		if (e->samples[i].status != PTEST_STATUS_PASS)
+			failures += weight;
+		weights += weight;
+		weight *= BUDGET_DECAY;
+		total += e->samples[i].duration_ms;
+	}
+	it->cost_ms = ptest_history_percentile(e, 50);
+	if (it->cost_ms < 0)
+		it->cost_ms = total / e->samples_no;
+
+	/* Anything installed after the last run is worth checking. */
+	it->changed = stat(it->p->run_ptest, &st) == 0 &&
+		st.st_mtime > e->samples[e->samples_no - 1].timestamp;
+
+	it->value = 1 + 4 * failures / weights + (it->changed ? 2 : 0);
+}
+
+int
+ptest_budget_select(struct ptest_list *head, const struct ptest_history *h,
+		unsigned int budget, FILE *fp)
+{
+	struct budget_item *items;
+	struct ptest_list *p, *last;
+	int64_t left = (int64_t) budget * 1000, used = 0;
+	int n = ptest_list_length(head), i, selected = 0;
+
+	if (n <= 0)
+		return 0;
+
+	items = calloc((size_t) n, sizeof(*items));
+	CHECK_ALLOCATION(items, (size_t) n * sizeof(*items), 0);
+	if (items == NULL)
+		return -1;
+
+	i = 0;
+	PTEST_LIST_ITERATE_START(head, p)
+		items[i].p = p;
+		budget_estimate(&items[i], h);
+		/* Under a second ptests are all as cheap. */
+		items[i].priority = items[i].value /
+			((double) (items[i].cost_ms > 1000 ? items[i].cost_ms : 1000) / 1000);
+		i++;
+	PTEST_LIST_ITERATE_END
+
+	qsort(items, (size_t) n, sizeof(*items), cmp_priority);
+	for (i = 0; i < n; i++) {
+		if (items[i].cost_ms > left)
+			continue;
+		items[i].selected = 1;
+		left -= items[i].cost_ms;
+		used += items[i].cost_ms;
+		selected++;
+	}
+
+	/*
+	 * Relink in priority order, what does not fit goes last and is
+	 * skipped by run_ptests() so the reports still list it.
+	 */
+	last = head;
+	head->next = NULL;
+	for (i = 0; i < n; i++) {
+		p = items[i].p;
+		fprintf(fp, "BUDGET: %s %s, estimated %.1f s, value %.1f%s\n",
+				items[i].selected ? "run" : "skip", p->ptest,
+				(double) items[i].cost_ms / 1000, items[i].value,
+				items[i].changed ? ", changed" : "");
+		if (!items[i].selected)
+			continue;
+		last->next = p;
+		p->prev = last;
+		p->next = NULL;
+		last = p;
+	}
+	for (i = 0; i < n; i++) {
+		if (items[i].selected)
+			continue;
+		p = items[i].p;
+		p->status = PTEST_STATUS_BUDGET;
+		last->next = p;
+		p->prev = last;
+		p->next = NULL;
+		last = p;
+	}
+	fprintf(fp, "BUDGET: %d of %d ptests selected, estimated %.1f of %u seconds\n",
+			selected, n, (double) used / 1000, budget);
+
+	free(items);
+
+	return selected;
+}
@@ -0,0 +1,48 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_BUDGET_H
+#define PTEST_RUNNER_BUDGET_H
+
+#include <stdio.h>
+
+#include "history.h"
+#include "ptest_list.h"
+
+/* Estimate for ptests without a recorded duration. */
+#define BUDGET_UNKNOWN_COST_MS 60000
+/* Weight of each older sample in the failure rate, newest counts 1. */
+#define BUDGET_DECAY 0.7
+
+/*
+ * Keeps the ptests that give the most value within a time budget in
+ * seconds and reorders them most valuable first, the rest are moved
+ * to the end with status PTEST_STATUS_BUDGET. Cost is the median recorded duration, value grows with
+ * the recent failure rate and for ptests changed since their last run
+ * or never run, ptests are taken greedily by value per second. The
+ * selection is printed to fp, returns the number of ptests kept.
+ */
+extern int ptest_budget_select(struct ptest_list *, const struct ptest_history *,
+		unsigned int, FILE *);
+
+#endif // PTEST_RUNNER_BUDGET_H
@@ -0,0 +1,432 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/utsname.h>
+
+#include "cache.h"
+#include "utils.h"
+
+#define CACHE_HEADER "# ptest-runner cache v1\n"
+#define CACHE_READ_BUF_SIZE 65536
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t
+fnv1a(uint64_t h, const void *data, size_t len)
+{
+	const unsigned char *c = data;
+
+	while (len--) {
+		h ^= *c++;
+		h *= FNV_PRIME;
+	}
+
+	return h;
+}
+
+static int
+hash_file_content(const char *path, uint64_t *h)
+{
+	char buf[CACHE_READ_BUF_SIZE];
+	ssize_t n;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return -1;
+
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+		*h = fnv1a(*h, buf, (size_t) n);
+
+	close(fd);
+
+	return n < 0 ? -1 : 0;
+}
+
+/*
+ * Walk a ptest directory without following symlinks. Every file contributes
+ * its own hash, summed so the result does not depend on readdir() order.
+ * The meta hash only uses stat() data, the content hash reads every file
+ * and is only computed when asked for.
+ */
+static int
+hash_dir(const char *path, const char *rel, uint64_t *meta, uint64_t *content)
+{
+	DIR *d;
+	struct dirent *de;
+	int rc = 0;
+
+	d = opendir(path);
+	if (d == NULL)
+		return -1;
+
+	while ((de = readdir(d)) != NULL) {
+		char *child, *child_rel;
+		struct stat st;
+		uint64_t h;
+
+		if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+			continue;
+
+		if (asprintf(&child, "%s/%s", path, de->d_name) == -1) {
+			rc = -1;
+			break;
+		}
+		if (asprintf(&child_rel, "%s/%s", rel, de->d_name) == -1) {
+			free(child);
+			rc = -1;
+			break;
+		}
+
+		if (lstat(child, &st) == -1) {
+			free(child_rel);
+			free(child);
+			continue;
+		}
+
+		h = fnv1a(FNV_OFFSET_BASIS, child_rel, strlen(child_rel));
+		h = fnv1a(h, &st.st_mode, sizeof(st.st_mode));
+		h = fnv1a(h, &st.st_size, sizeof(st.st_size));
+		h = fnv1a(h, &st.st_ino, sizeof(st.st_ino));
+		h = fnv1a(h, &st.st_mtim, sizeof(st.st_mtim));
+		*meta += h;
+
+		if (content != NULL) {
+			h = fnv1a(FNV_OFFSET_BASIS, child_rel, strlen(child_rel));
+			h = fnv1a(h, &st.st_mode, sizeof(st.st_mode));
+			if (S_ISREG(st.st_mode)) {
+				if (hash_file_content(child, &h) == -1)
+					rc = -1;
+			} else if (S_ISLNK(st.st_mode)) {
+				char target[PATH_MAX];
+				ssize_t n = readlink(child, target, sizeof(target));
+				if (n > 0)
+					h = fnv1a(h, target, (size_t) n);
+			}
+			*content += h;
+		}
+
+		if (S_ISDIR(st.st_mode) &&
+		    hash_dir(child, child_rel, meta, content) == -1)
+			rc = -1;
+
+		free(child_rel);
+		free(child);
+
+		if (rc == -1)
+			break;
+	}
+
+	closedir(d);
+
+	return rc;
+}
+
+int
+ptest_cache_hash_dir(const char *dir, uint64_t known_meta, uint64_t *meta,
+		uint64_t *content)
+{
+	*meta = 0;
+	if (hash_dir(dir, ".", meta, NULL) == -1)
+		return -1;
+
+	/* Unchanged mtime/size/inode of every file, skip reading them. */
+	if (known_meta != 0 && *meta == known_meta)
+		return 0;
+
+	*content = 0;
+	*meta = 0;
+	return hash_dir(dir, ".", meta, content);
+}
+
+uint64_t
+ptest_cache_hash_env(char **files, int files_no)
+{
+	struct utsname uts;
+	uint64_t h = FNV_OFFSET_BASIS;
+	int i;
+
+	if (uname(&uts) == 0) {
+		h = fnv1a(h, uts.sysname, strlen(uts.sysname));
+		h = fnv1a(h, uts.release, strlen(uts.release));
+		h = fnv1a(h, uts.version, strlen(uts.version));
+		h = fnv1a(h, uts.machine, strlen(uts.machine));
+	}
+
+	for (i = 0; i < files_no; i++) {
+		h = fnv1a(h, files[i], strlen(files[i]));
+		if (hash_file_content(files[i], &h) == -1)
+			h = fnv1a(h, "missing", 7);
+	}
+
+	return h;
+}
+
+static struct ptest_cache_entry *
+cache_search(struct ptest_cache_entry *entries, int entries_no, const char *ptest)
+{
+	int i;
+
+	for (i = 0; i < entries_no; i++)
+		if (strcmp(entries[i].ptest, ptest) == 0)
+			return &entries[i];
+
+	return NULL;
+}
+
+static struct ptest_cache_entry *
+cache_append(struct ptest_cache_entry **entries, int *entries_no,
+		int *entries_size, const char *ptest)
+{
+	struct ptest_cache_entry *e;
+
+	if (*entries_no == *entries_size) {
+		int size = *entries_size ? *entries_size * 2 : 64;
+		e = realloc(*entries, sizeof(struct ptest_cache_entry) * (size_t) size);
+		CHECK_ALLOCATION(e, sizeof(struct ptest_cache_entry) * (size_t) size, 0);
+		if (e == NULL)
+			return NULL;
+		*entries = e;
+		*entries_size = size;
+	}
+
+	e = &(*entries)[*entries_no];
+	memset(e, 0, sizeof(*e));
+	e->ptest = strdup(ptest);
+	CHECK_ALLOCATION(e->ptest, strlen(ptest), 0);
+	if (e->ptest == NULL)
+		return NULL;
+	(*entries_no)++;
+
+	return e;
+}
+
+struct ptest_cache *
+ptest_cache_load(const char *filename, uint64_t env_hash, time_t max_age)
+{
+	struct ptest_cache *cache;
+	FILE *fp;
+	char *line = NULL;
+	size_t line_size = 0;
+
+	cache = calloc(1, sizeof(struct ptest_cache));
+	CHECK_ALLOCATION(cache, sizeof(struct ptest_cache), 0);
+	if (cache == NULL)
+		return NULL;
+
+	cache->filename = strdup(filename);
+	CHECK_ALLOCATION(cache->filename, strlen(filename), 0);
+	if (cache->filename == NULL) {
+		free(cache);
+		return NULL;
+	}
+	cache->env_hash = env_hash;
+	cache->max_age = max_age;
+
+	/* A missing cache file is the same as an empty one. */
+	fp = fopen(filename, "r");
+	if (fp == NULL)
+		return cache;
+
+	while (getline(&line, &line_size, fp) != -1) {
+		char name[NAME_MAX + 1];
+		struct ptest_cache_entry e, *n;
+		intmax_t timestamp;
+
+		if (line[0] == '#')
+			continue;
+
+		if (sscanf(line, "%255s %" SCNx64 " %" SCNx64 " %" SCNx64 " %jd",
+		    name, &e.meta_hash, &e.content_hash, &e.env_hash,
+		    &timestamp) != 5)
+			continue;
+
+		n = cache_append(&cache->entries, &cache->entries_no,
+				&cache->entries_size, name);
+		if (n == NULL)
+			break;
+		n->meta_hash = e.meta_hash;
+		n->content_hash = e.content_hash;
+		n->env_hash = e.env_hash;
+		n->timestamp = (time_t) timestamp;
+	}
+
+	free(line);
+	fclose(fp);
+
+	return cache;
+}
+
+int
+ptest_cache_mark(struct ptest_cache *cache, struct ptest_list *head)
+{
+	struct ptest_list *p;
+	time_t now = time(NULL);
+	int hits = 0;
+
+	PTEST_LIST_ITERATE_START(head, p)
+		struct ptest_cache_entry *e;
+		uint64_t meta, content = 0;
+		char *ptest_dir;
+
+		ptest_dir = strdup(p->run_ptest);
+		CHECK_ALLOCATION(ptest_dir, strlen(p->run_ptest), 0);
+		if (ptest_dir == NULL)
+			continue;
+
+		e = cache_search(cache->entries, cache->entries_no, p->ptest);
+		if (ptest_cache_hash_dir(dirname(ptest_dir), e ? e->meta_hash : 0,
+		    &meta, &content) == -1) {
+			free(ptest_dir);
+			continue;
+		}
+		free(ptest_dir);
+
+		if (e != NULL && e->meta_hash == meta)
+			content = e->content_hash;
+
+		if (e != NULL && e->content_hash == content &&
+		    e->env_hash == cache->env_hash &&
+		    (cache->max_age <= 0 || now - e->timestamp <= cache->max_age)) {
+			/* Touched but not modified, remember the new mtimes. */
+			e->meta_hash = meta;
+			p->status = PTEST_STATUS_CACHED;
+			hits++;
+			continue;
+		}
+
+		/* Candidate entry, only written back if the ptest passes. */
+		p->meta_hash = meta;
+		p->content_hash = content;
+	PTEST_LIST_ITERATE_END
+
+	return hits;
+}
+
+void
+ptest_cache_update(struct ptest_cache *cache, struct ptest_list *head)
+{
+	struct ptest_list *p;
+	time_t now = time(NULL);
+
+	PTEST_LIST_ITERATE_START(head, p)
+		struct ptest_cache_entry *e;
+
+		e = cache_search(cache->entries, cache->entries_no, p->ptest);
+
+		if (p->status == PTEST_STATUS_FAIL) {
+			/* Invalidate, a failure is never served from the cache. */
+			if (e != NULL)
+				e->timestamp = 0;
+			continue;
+		}
+
+		if (p->status != PTEST_STATUS_PASS)
+			continue;
+
+		if (e == NULL)
+			e = cache_append(&cache->entries, &cache->entries_no,
+					&cache->entries_size, p->ptest);
+		if (e == NULL)
+			continue;
+
+		e->meta_hash = p->meta_hash;
+		e->content_hash = p->content_hash;
+		e->env_hash = cache->env_hash;
+		e->timestamp = now;
+	PTEST_LIST_ITERATE_END
+}
+
+int
+ptest_cache_save(struct ptest_cache *cache)
+{
+	char *tmp;
+	FILE *fp;
+	int i;
+
+	if (asprintf(&tmp, "%s.tmp", cache->filename) == -1)
+		return -1;
+
+	fp = fopen(tmp, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "Cache file '%s' could not be created. %s.\n",
+				tmp, strerror(errno));
+		free(tmp);
+		return -1;
+	}
+
+	fprintf(fp, CACHE_HEADER);
+	for (i = 0; i < cache->entries_no; i++) {
+		struct ptest_cache_entry *e = &cache->entries[i];
+
+		if (e->timestamp == 0)
+			continue;
+
+		fprintf(fp, "%s %016" PRIx64 " %016" PRIx64 " %016" PRIx64 " %jd\n",
+				e->ptest, e->meta_hash, e->content_hash,
+				e->env_hash, (intmax_t) e->timestamp);
+	}
+
+	if (fclose(fp) != 0 || rename(tmp, cache->filename) == -1) {
+		fprintf(stderr, "Cache file '%s' could not be written. %s.\n",
+				cache->filename, strerror(errno));
+		unlink(tmp);
+		free(tmp);
+		return -1;
+	}
+
+	free(tmp);
+
+	return 0;
+}
+
+void
+ptest_cache_free(struct ptest_cache *cache)
+{
+	int i;
+
+	if (cache == NULL)
+		return;
+
+	for (i = 0; i < cache->entries_no; i++)
+		free(cache->entries[i].ptest);
+	free(cache->entries);
+	free(cache->filename);
+	free(cache);
+}
@@ -0,0 +1,61 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_CACHE_H
+#define PTEST_RUNNER_CACHE_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "ptest_list.h"
+
+#define PTEST_CACHE_DEFAULT_MAX_AGE (7 * 24 * 60 * 60)
+
+struct ptest_cache_entry {
+	char *ptest;
+	uint64_t meta_hash;
+	uint64_t content_hash;
+	uint64_t env_hash;
+	time_t timestamp;
+};
+
+struct ptest_cache {
+	char *filename;
+	uint64_t env_hash;
+	time_t max_age;
+
+	struct ptest_cache_entry *entries;
+	int entries_no;
+	int entries_size;
+};
+
+extern uint64_t ptest_cache_hash_env(char **, int);
+extern int ptest_cache_hash_dir(const char *, uint64_t, uint64_t *, uint64_t *);
+
+extern struct ptest_cache *ptest_cache_load(const char *, uint64_t, time_t);
+extern int ptest_cache_mark(struct ptest_cache *, struct ptest_list *);
+extern void ptest_cache_update(struct ptest_cache *, struct ptest_list *);
+extern int ptest_cache_save(struct ptest_cache *);
+extern void ptest_cache_free(struct ptest_cache *);
+
+#endif // PTEST_RUNNER_CACHE_H
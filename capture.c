@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+static const char *capture_streams[2] = {"out", "err"};
+
+static void
+capture_flush_line(struct ptest_capture *c, int stream)
+{
+	int64_t us = c->line_us[stream] - c->start_us;
+
+	fprintf(c->fp, "%" PRId64 ".%06" PRId64 " %s ", us / 1000000,
+			us % 1000000, capture_streams[stream]);
+	fwrite(c->line[stream], c->len[stream], 1, c->fp);
+	fputc('\n', c->fp);
+	c->len[stream] = 0;
+}
+
+static void
+capture_start(void *data, const struct ptest_list *p, pid_t pid)
+{
+	struct ptest_capture *c = data;
+
+	c->start_us = ptest_backend_clock_us(c->backend);
+	c->len[0] = c->len[1] = 0;
+	c->running = 1;
+	fprintf(c->fp, "# BEGIN %s\n", p->ptest);
+}
+
+static void
+capture_output(void *data, const struct ptest_list *p, int stream,
+		const char *buf, size_t len)
+{
+	struct ptest_capture *c = data;
+	int64_t now = ptest_backend_clock_us(c->backend);
+	size_t i;
+
+	if (stream < 0 || stream > 1)
+		return;
+
+	for (i = 0; i < len; i++) {
+		if (c->len[stream] == 0)
+			c->line_us[stream] = now;
+		if (buf[i] == '\n') {
+			capture_flush_line(c, stream);
+			continue;
+		}
+		c->line[stream][c->len[stream]++] = buf[i];
+		if (c->len[stream] == CAPTURE_LINE_MAX)
+			capture_flush_line(c, stream);
+	}
+}
+
+static void
+capture_end(void *data, const struct ptest_list *p)
+{
+	struct ptest_capture *c = data;
+	int i;
+
+	/* Unterminated last lines still belong to this ptest. */
+	for (i = 0; i < 2; i++)
+		if (c->len[i] > 0)
+			capture_flush_line(c, i);
+
+	fprintf(c->fp, "# END %s %s\n", p->ptest,
+			p->status == PTEST_STATUS_PASS ? "pass" :
+			p->status == PTEST_STATUS_BUDGET ? "skipped" : "fail");
+	fflush(c->fp);
+	c->running = 0;
+}
+
+/* Only a ptest cut short by the time budget was started. */
+static void
+capture_skipped(void *data, const struct ptest_list *p, const char *reason)
+{
+	struct ptest_capture *c = data;
+
+	if (c->running)
+		capture_end(data, p);
+}
+
+struct ptest_capture *
+ptest_capture_open(const char *file)
+{
+	struct ptest_capture *c;
+
+	c = calloc(1, sizeof(struct ptest_capture));
+	CHECK_ALLOCATION(c, sizeof(struct ptest_capture), 0);
+	if (c == NULL)
+		return NULL;
+
+	c->fp = fopen(file, "we");
+	if (c->fp == NULL) {
+		fprintf(stderr, "Capture file '%s' could not be opened. %s.\n",
+				file, strerror(errno));
+		free(c);
+		return NULL;
+	}
+
+	c->callbacks.start = capture_start;
+	c->callbacks.output = capture_output;
+	c->callbacks.end = capture_end;
+	c->callbacks.skipped = capture_skipped;
+	c->callbacks.data = c;
+
+	return c;
+}
+
+void
+ptest_capture_close(struct ptest_capture *c)
+{
+	if (c == NULL)
+		return;
+
+	fclose(c->fp);
+	free(c);
+}
@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_CAPTURE_H
+#define PTEST_RUNNER_CAPTURE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "utils.h"
+
+#define CAPTURE_LINE_MAX 4096
+
+/*
+ * Output of every ptest with stdout and stderr kept apart, one line per
+ * output line in the order it was read:
+ *
+ *   # BEGIN gcc
+ *   0.001234 out PASS: test1
+ *   0.250781 err warning: something
+ *   # END gcc pass
+ *
+ * The first field is the monotonic time in seconds since the ptest was
+ * started, taken when the first byte of the line was read, the second
+ * the stream. Lines longer than CAPTURE_LINE_MAX are split. A ptest
+ * stopped by the time budget ends with "skipped". The clock is the one
+ * of backend, the system when NULL. Not for coordinated runs, their
+ * output only arrives at the end of each ptest.
+ */
+struct ptest_capture {
+	FILE *fp;
+	const struct ptest_backend *backend;
+	int running;
+	int padding1;
+	int64_t start_us;
+	int64_t line_us[2];
+	size_t len[2];
+	char line[2][CAPTURE_LINE_MAX];
+
+	struct ptest_callbacks callbacks;
+};
+
+extern struct ptest_capture *ptest_capture_open(const char *);
+extern void ptest_capture_close(struct ptest_capture *);
+
+#endif // PTEST_RUNNER_CAPTURE_H
@@ -0,0 +1,196 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "cgroup.h"
+#include "utils.h"
+
+#define CGROUP_CONTROLLERS "+memory +pids +cpu +io"
+#define CGROUP_RMDIR_RETRIES 100
+#define CGROUP_RMDIR_WAIT_NS 10000000L
+/* The cgroup directory plus a control file name. */
+#define CGROUP_FILE_MAX (PATH_MAX + NAME_MAX)
+
+const char *ptest_cgroup_limits[] = {
+	"memory.max",
+	"pids.max",
+	"cpu.weight",
+	"io.weight",
+	NULL,
+};
+
+/* Plain write(2), cgroup files take a single write per value. */
+static int
+cgroup_write(const char *dir, const char *file, const char *value)
+{
+	char path[CGROUP_FILE_MAX];
+	ssize_t n;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, file);
+	fd = open(path, O_WRONLY | O_CLOEXEC);
+	if (fd == -1)
+		return -1;
+	n = write(fd, value, strlen(value));
+	close(fd);
+
+	return n == (ssize_t) strlen(value) ? 0 : -1;
+}
+
+/*
+ * Enable the controllers for the children of the parent cgroup, one at
+ * a time so a missing one (io without a block device) doesn't stop the
+ * others.
+ */
+int
+ptest_cgroup_setup(const char *parent)
+{
+	char controllers[] = CGROUP_CONTROLLERS;
+	char *tok, *saveptr;
+	struct stat st;
+
+	if (stat(parent, &st) == -1 || !S_ISDIR(st.st_mode)) {
+		fprintf(stderr, "Cgroup '%s' is not a directory. %s.\n", parent,
+				strerror(errno ? errno : ENOTDIR));
+		return -1;
+	}
+
+	for (tok = strtok_r(controllers, " ", &saveptr); tok != NULL;
+	     tok = strtok_r(NULL, " ", &saveptr))
+		cgroup_write(parent, "cgroup.subtree_control", tok);
+
+	return 0;
+}
+
+int
+ptest_cgroup_create(struct ptest_cgroup *cg, const char *parent,
+		const char *ptest, const struct ptest_config *config)
+{
+	int i;
+
+	if (snprintf(cg->path, sizeof(cg->path), "%s/%s.%d", parent, ptest,
+	    (int) getpid()) >= (int) sizeof(cg->path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	if (mkdir(cg->path, 0755) == -1 && errno != EEXIST)
+		return -1;
+
+	for (i = 0; ptest_cgroup_limits[i] != NULL; i++) {
+		const char *value = ptest_config_get(config, ptest,
+				ptest_cgroup_limits[i]);
+
+		if (value != NULL && cgroup_write(cg->path, ptest_cgroup_limits[i],
+		    value) == -1) {
+			int saved_errno = errno;
+
+			fprintf(stderr, "Unable to set %s=%s for %s. %s.\n",
+					ptest_cgroup_limits[i], value, ptest,
+					strerror(saved_errno));
+			rmdir(cg->path);
+			errno = saved_errno;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Called from the child before exec, moves the calling process. */
+int
+ptest_cgroup_enter(const struct ptest_cgroup *cg)
+{
+	return cgroup_write(cg->path, "cgroup.procs", "0");
+}
+
+/* Kills every process in the cgroup, even the ones that left the group. */
+int
+ptest_cgroup_kill(const struct ptest_cgroup *cg)
+{
+	return cgroup_write(cg->path, "cgroup.kill", "1");
+}
+
+/* OOM kills from memory.events and peak usage in KiB from memory.peak. */
+void
+ptest_cgroup_stats(const struct ptest_cgroup *cg, int *oom_kills, long *peak_kb)
+{
+	char path[CGROUP_FILE_MAX], key[64];
+	long long value;
+	FILE *fp;
+
+	*oom_kills = 0;
+	*peak_kb = 0;
+
+	snprintf(path, sizeof(path), "%s/memory.events", cg->path);
+	fp = fopen(path, "re");
+	if (fp != NULL) {
+		while (fscanf(fp, "%63s %lld", key, &value) == 2)
+			if (strcmp(key, "oom_kill") == 0)
+				*oom_kills = (int) value;
+		fclose(fp);
+	}
+
+	snprintf(path, sizeof(path), "%s/memory.peak", cg->path);
+	fp = fopen(path, "re");
+	if (fp != NULL) {
+		if (fscanf(fp, "%lld", &value) == 1)
+			*peak_kb = (long) (value / 1024);
+		fclose(fp);
+	}
+}
+
+/*
+ * A cgroup can only be removed once its last process is gone, which
+ * happens asynchronously after cgroup.kill.
+ */
+int
+ptest_cgroup_destroy(const struct ptest_cgroup *cg)
+{
+	struct timespec ts = {0, CGROUP_RMDIR_WAIT_NS};
+	int i;
+
+	ptest_cgroup_kill(cg);
+	for (i = 0; i < CGROUP_RMDIR_RETRIES; i++) {
+		if (rmdir(cg->path) == 0 || errno == ENOENT)
+			return 0;
+		if (errno != EBUSY)
+			break;
+		nanosleep(&ts, NULL);
+	}
+
+	return -1;
+}
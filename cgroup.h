@@ -0,0 +1,50 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_CGROUP_H
+#define PTEST_RUNNER_CGROUP_H
+
+#include <limits.h>
+
+#include "config.h"
+
+/*
+ * One cgroup v2 per ptest, created under a parent the runner may write
+ * to. Limits are the memory.max, pids.max, cpu.weight and io.weight
+ * keys of the ptest config, the * entry giving the defaults.
+ */
+struct ptest_cgroup {
+	char path[PATH_MAX];
+};
+
+extern const char *ptest_cgroup_limits[];
+
+extern int ptest_cgroup_setup(const char *);
+extern int ptest_cgroup_create(struct ptest_cgroup *, const char *,
+		const char *, const struct ptest_config *);
+extern int ptest_cgroup_enter(const struct ptest_cgroup *);
+extern int ptest_cgroup_kill(const struct ptest_cgroup *);
+extern void ptest_cgroup_stats(const struct ptest_cgroup *, int *, long *);
+extern int ptest_cgroup_destroy(const struct ptest_cgroup *);
+
+#endif // PTEST_RUNNER_CGROUP_H
@@ -0,0 +1,158 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "compare.h"
+#include "history.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+/* MAD times this estimates the standard deviation of normal noise. */
+#define COMPARE_MAD_SCALE 1.4826
+
+static int
+cmp_int64(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+static int64_t
+median(int64_t *v, int n)
+{
+	qsort(v, (size_t) n, sizeof(v[0]), cmp_int64);
+
+	return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+static int
+cmp_score(const void *a, const void *b)
+{
+	const struct ptest_regression *x = a, *y = b;
+
+	return (x->score < y->score) - (x->score > y->score);
+}
+
+static int
+check_metric(const struct ptest_history_entry *e, int cpu, int64_t current,
+		double sigma, struct ptest_regression *r)
+{
+	int64_t values[PTEST_HISTORY_MAX_SAMPLES];
+	int64_t med, noise, growth, floor;
+	int i, n = 0;
+
+	for (i = 0; i < e->samples_no; i++)
+		if (e->samples[i].status == PTEST_STATUS_PASS)
+			values[n++] = cpu ? e->samples[i].cpu_ms :
+				e->samples[i].duration_ms;
+	/* Too few runs say nothing about the noise, as for adaptive deadlines. */
+	if (n < PTEST_HISTORY_MIN_SAMPLES)
+		return 0;
+
+	med = median(values, n);
+	for (i = 0; i < n; i++)
+		values[i] = llabs(values[i] - med);
+	noise = (int64_t) (COMPARE_MAD_SCALE * (double) median(values, n));
+
+	growth = current - med;
+	floor = med * COMPARE_MIN_PCT / 100;
+	if (floor < COMPARE_MIN_MS)
+		floor = COMPARE_MIN_MS;
+	if (growth <= floor || (double) growth <= sigma * (double) noise)
+		return 0;
+
+	r->metric = cpu ? "cpu" : "duration";
+	r->current = current;
+	r->median = med;
+	r->noise = noise;
+	r->samples = n;
+	r->score = (double) growth / (double) (noise > 0 ? noise : 1);
+
+	return 1;
+}
+
+int
+ptest_compare(const struct ptest_history *baseline, struct ptest_list *head,
+		double sigma, struct ptest_regression **regressions)
+{
+	struct ptest_regression *r = NULL;
+	struct ptest_list *p;
+	int n = 0, size = 0, cpu;
+
+	PTEST_LIST_ITERATE_START(head, p)
+		const struct ptest_history_entry *e;
+		int64_t current;
+
+		/* Failures are reported as such, only passing runs are timed. */
+		if (p->status != PTEST_STATUS_PASS)
+			continue;
+		e = ptest_history_find(baseline, p->ptest);
+		if (e == NULL)
+			continue;
+
+		for (cpu = 0; cpu < 2; cpu++) {
+			if (n == size) {
+				struct ptest_regression *tmp;
+
+				size = size ? size * 2 : 8;
+				tmp = realloc(r, (size_t) size * sizeof(*r));
+				CHECK_ALLOCATION(tmp, (size_t) size * sizeof(*r), 0);
+				if (tmp == NULL) {
+					free(r);
+					return -1;
+				}
+				r = tmp;
+			}
+			current = cpu ? p->utime_ms + p->stime_ms : p->duration_ms;
+			if (check_metric(e, cpu, current, sigma, &r[n])) {
+				r[n].p = p;
+				n++;
+			}
+		}
+	PTEST_LIST_ITERATE_END
+
+	if (n > 0)
+		qsort(r, (size_t) n, sizeof(*r), cmp_score);
+	*regressions = r;
+
+	return n;
+}
+
+void
+ptest_compare_print(FILE *fp, const struct ptest_regression *r, int n)
+{
+	int i;
+
+	fprintf(fp, "REGRESSIONS: %d\n", n);
+	for (i = 0; i < n; i++)
+		fprintf(fp, "REGRESSION: %s %s %" PRId64 " ms, baseline median %"
+				PRId64 " ms +/- %" PRId64 " ms over %d runs, +%.1f%%,"
+				" score %.1f\n", r[i].p->ptest, r[i].metric, r[i].current,
+				r[i].median, r[i].noise, r[i].samples,
+				r[i].median > 0 ? 100.0 * (double) (r[i].current -
+				r[i].median) / (double) r[i].median : 100.0, r[i].score);
+}
@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_COMPARE_H
+#define PTEST_RUNNER_COMPARE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "history.h"
+#include "ptest_list.h"
+
+#define COMPARE_DEFAULT_SIGMA 3.0
+/* Growth below either of these is never a regression, whatever the noise. */
+#define COMPARE_MIN_PCT 10
+#define COMPARE_MIN_MS 50
+
+struct ptest_regression {
+	const struct ptest_list *p;
+	const char *metric;
+	int64_t current;
+	int64_t median;
+	int64_t noise;
+	int samples;
+	int padding1;
+	double score;
+};
+
+/*
+ * Checks the passing ptests of a run against the passing samples of a
+ * baseline history, ptests with less than PTEST_HISTORY_MIN_SAMPLES of
+ * them are not judged. A duration or CPU time is flagged when it is past
+ * the baseline median by more than sigma times the noise, the median
+ * absolute deviation scaled to a standard deviation, and by at least
+ * COMPARE_MIN_PCT percent and COMPARE_MIN_MS. Results are ranked by
+ * score, the growth in units of noise.
+ */
+extern int ptest_compare(const struct ptest_history *, struct ptest_list *,
+		double, struct ptest_regression **);
+extern void ptest_compare_print(FILE *, const struct ptest_regression *, int);
+
+#endif // PTEST_RUNNER_COMPARE_H
@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "utils.h"
+
+#define CONFIG_DELIM " \t\r\n"
+
+int
+ptest_config_add(struct ptest_config *cfg, const char *ptest, const char *key,
+		const char *value)
+{
+	struct ptest_config_entry *e;
+
+	if (cfg->entries_no == cfg->entries_size) {
+		int size = cfg->entries_size ? cfg->entries_size * 2 : 16;
+		e = realloc(cfg->entries, sizeof(struct ptest_config_entry) * (size_t) size);
+		CHECK_ALLOCATION(e, sizeof(struct ptest_config_entry) * (size_t) size, 0);
+		if (e == NULL)
+			return -1;
+		cfg->entries = e;
+		cfg->entries_size = size;
+	}
+
+	e = &cfg->entries[cfg->entries_no];
+	e->ptest = strdup(ptest);
+	e->key = strdup(key);
+	e->value = strdup(value);
+	if (e->ptest == NULL || e->key == NULL || e->value == NULL) {
+		free(e->ptest);
+		free(e->key);
+		free(e->value);
+		return -1;
+	}
+	cfg->entries_no++;
+
+	return 0;
+}
+
+struct ptest_config *
+ptest_config_load(const char *filename)
+{
+	struct ptest_config *cfg;
+	FILE *fp;
+	char *line = NULL;
+	size_t line_size = 0;
+	int lineno = 0, rc = 0;
+
+	fp = fopen(filename, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "Config file '%s' could not be opened. %s.\n",
+				filename, strerror(errno));
+		return NULL;
+	}
+
+	cfg = calloc(1, sizeof(struct ptest_config));
+	CHECK_ALLOCATION(cfg, sizeof(struct ptest_config), 0);
+	if (cfg == NULL) {
+		fclose(fp);
+		return NULL;
+	}
+
+	while (rc == 0 && getline(&line, &line_size, fp) != -1) {
+		char *saveptr, *ptest, *tok;
+
+		lineno++;
+		ptest = strtok_r(line, CONFIG_DELIM, &saveptr);
+		if (ptest == NULL || ptest[0] == '#')
+			continue;
+
+		while ((tok = strtok_r(NULL, CONFIG_DELIM, &saveptr)) != NULL) {
+			char *value = strchr(tok, '=');
+
+			if (value != NULL)
+				*value++ = '\0';
+			if (tok[0] == '\0') {
+				fprintf(stderr, "Config file '%s' line %d, missing key.\n",
+						filename, lineno);
+				rc = -1;
+				break;
+			}
+			if (ptest_config_add(cfg, ptest, tok, value ? value : "1") == -1) {
+				rc = -1;
+				break;
+			}
+		}
+	}
+
+	free(line);
+	fclose(fp);
+
+	if (rc == -1) {
+		ptest_config_free(cfg);
+		return NULL;
+	}
+
+	return cfg;
+}
+
+const char *
+ptest_config_get(const struct ptest_config *cfg, const char *ptest,
+		const char *key)
+{
+	const char *any = NULL;
+	int i;
+
+	if (cfg == NULL)
+		return NULL;
+
+	/* Later lines override earlier ones. */
+	for (i = cfg->entries_no - 1; i >= 0; i--) {
+		struct ptest_config_entry *e = &cfg->entries[i];
+
+		if (strcmp(e->key, key) != 0)
+			continue;
+		if (strcmp(e->ptest, ptest) == 0)
+			return e->value;
+		if (any == NULL && strcmp(e->ptest, PTEST_CONFIG_ANY) == 0)
+			any = e->value;
+	}
+
+	return any;
+}
+
+int
+ptest_config_get_int(const struct ptest_config *cfg, const char *ptest,
+		const char *key, int def)
+{
+	const char *value = ptest_config_get(cfg, ptest, key);
+	char *end;
+	long n;
+
+	if (value == NULL)
+		return def;
+
+	errno = 0;
+	n = strtol(value, &end, 10);
+	if (errno != 0 || end == value || *end != '\0' || n < 0 || n > INT32_MAX)
+		return def;
+
+	return (int) n;
+}
+
+void
+ptest_config_free(struct ptest_config *cfg)
+{
+	int i;
+
+	if (cfg == NULL)
+		return;
+
+	for (i = 0; i < cfg->entries_no; i++) {
+		free(cfg->entries[i].ptest);
+		free(cfg->entries[i].key);
+		free(cfg->entries[i].value);
+	}
+	free(cfg->entries);
+	free(cfg);
+}
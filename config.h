@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_CONFIG_H
+#define PTEST_RUNNER_CONFIG_H
+
+#define PTEST_CONFIG_ANY "*"
+
+/*
+ * Per ptest settings, one line per ptest with its name (or * for all of
+ * them) followed by key=value pairs, a bare key means key=1:
+ *
+ *   # comment
+ *   *     deadline=3600
+ *   glibc timeout=900 deadline=14400
+ *
+ * A value given for the ptest wins over the * one.
+ */
+struct ptest_config_entry {
+	char *ptest;
+	char *key;
+	char *value;
+};
+
+struct ptest_config {
+	struct ptest_config_entry *entries;
+	int entries_no;
+	int entries_size;
+};
+
+extern struct ptest_config *ptest_config_load(const char *);
+extern int ptest_config_add(struct ptest_config *, const char *, const char *,
+		const char *);
+extern const char *ptest_config_get(const struct ptest_config *, const char *,
+		const char *);
+extern int ptest_config_get_int(const struct ptest_config *, const char *,
+		const char *, int);
+extern void ptest_config_free(struct ptest_config *);
+
+#endif // PTEST_RUNNER_CONFIG_H
@@ -0,0 +1,822 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "coordinator.h"
+#include "fixture.h"
+#include "ptest_list.h"
+#include "report.h"
+#include "utils.h"
+
+#define COORDINATOR_LINE_MAX 4096
+
+/* ptest a worker is running, killed with it when it is cancelled. */
+static volatile pid_t worker_ptest_pid;
+
+struct coordinator_worker {
+	const char *cmd;
+	pid_t pid;
+	int fd;
+
+	/* ptest handed out and, once its result line arrived, log bytes due. */
+	struct ptest_list *p;
+	int in_log;
+	int quit;
+	/* Ready, but every queued ptest waits for a running dependency. */
+	int idle;
+	int padding1;
+	size_t log_len;
+
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+struct coordinator {
+	const struct ptest_options *opts;
+	const char *progname;
+	FILE *fp;
+
+	struct coordinator_worker workers[COORDINATOR_MAX_WORKERS];
+	int workers_no;
+
+	/* ptests not handed out yet, in list order. */
+	struct ptest_list *head;
+	struct ptest_list **queue;
+	int queue_no;
+	int ptests_no;
+	int failures;
+	int padding1;
+
+	/* Set up here once for every worker, not by each of them. */
+	struct ptest_fixtures fixtures;
+};
+
+static int
+write_all(int fd, const char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n == -1) {
+			/* Not a socket when a worker is driven over plain pipes. */
+			if (errno == ENOTSOCK)
+				n = write(fd, buf, len);
+			if (n == -1)
+				return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int
+send_line(int fd, const char *fmt, ...)
+{
+	char line[COORDINATOR_LINE_MAX];
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
+	if (len < 0 || (size_t) len >= sizeof(line)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	return write_all(fd, line, len);
+}
+
+static void
+ptest_dir_of(const struct ptest_list *p, char *dir)
+{
+	strcpy(dir, p->run_ptest);
+	dirname(dir);
+}
+
+static int
+coordinator_spawn(struct coordinator *co, const char *cmd)
+{
+	struct coordinator_worker *w = &co->workers[co->workers_no];
+	int sv[2];
+	pid_t pid;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1)
+		return -1;
+
+	fflush(co->fp);
+	fflush(stdout);
+	fflush(stderr);
+	pid = fork();
+	if (pid == -1) {
+		close(sv[0]);
+		close(sv[1]);
+		return -1;
+	} else if (pid == 0) {
+		int i;
+
+		for (i = 0; i < co->workers_no; i++)
+			close(co->workers[i].fd);
+		close(sv[0]);
+		dup2(sv[1], 0);
+		dup2(sv[1], 1);
+		close(sv[1]);
+
+		if (strcmp(cmd, COORDINATOR_LOCAL_WORKER) == 0)
+			_exit(ptest_worker_run(co->opts, co->progname, 0, 1));
+
+		execl("/bin/sh", "sh", "-c", cmd, (char *) NULL);
+		_exit(127);
+	}
+
+	close(sv[1]);
+	memset(w, 0, sizeof(*w));
+	w->cmd = cmd;
+	w->pid = pid;
+	w->fd = sv[0];
+	co->workers_no++;
+
+	return 0;
+}
+
+static void
+coordinator_dequeue(struct coordinator *co, int i)
+{
+	memmove(&co->queue[i], &co->queue[i + 1],
+			sizeof(*co->queue) * (size_t) (co->queue_no - i - 1));
+	co->queue_no--;
+}
+
+/*
+ * Once --fail-fast is reached, the ptests still running are cancelled
+ * with their worker and reported as skipped.
+ */
+static void
+coordinator_cancel(struct coordinator *co)
+{
+	const struct ptest_options *opts = co->opts;
+	char ptest_dir[PATH_MAX];
+	int i;
+
+	if (opts->fail_fast <= 0 || co->failures < opts->fail_fast)
+		return;
+
+	for (i = 0; i < co->workers_no; i++) {
+		struct coordinator_worker *w = &co->workers[i];
+
+		if (w->p == NULL || w->fd == -1)
+			continue;
+		ptest_dir_of(w->p, ptest_dir);
+		fprintf(co->fp, "SKIPPED: %s\n", ptest_dir);
+		PTEST_CALLBACK(opts, skipped, w->p, "fail-fast");
+		w->p = NULL;
+		kill(w->pid, SIGTERM);
+		close(w->fd);
+		w->fd = -1;
+	}
+}
+
+/* Whether a dependency of queued ptest i is still queued or running. */
+static int
+coordinator_waiting(struct coordinator *co, int i)
+{
+	const struct ptest_config *cfg = co->opts->config;
+	struct ptest_list *p = co->queue[i];
+	int j;
+
+	/* Only what comes before it counts, as for a local run. */
+	for (j = 0; j < i; j++)
+		if (ptest_depends_on(p, co->queue[j], cfg))
+			return 1;
+	for (j = 0; j < co->workers_no; j++)
+		if (co->workers[j].p != NULL &&
+		    ptest_depends_on(p, co->workers[j].p, cfg))
+			return 1;
+
+	return 0;
+}
+
+/*
+ * Hands the first queued ptest whose dependencies are done to w, leaves
+ * w idle when they are all waiting for one, or tells it to quit.
+ */
+static void
+coordinator_dispatch(struct coordinator *co, struct coordinator_worker *w)
+{
+	const struct ptest_options *opts = co->opts;
+	char ptest_dir[PATH_MAX];
+	int i = 0;
+
+	w->idle = 0;
+	while (i < co->queue_no) {
+		struct ptest_list *p = co->queue[i];
+
+		ptest_dir_of(p, ptest_dir);
+
+		if (p->status == PTEST_STATUS_CACHED) {
+			coordinator_dequeue(co, i);
+			fprintf(co->fp, "CACHED: %s\n", ptest_dir);
+			PTEST_CALLBACK(opts, skipped, p, "cached-pass");
+			continue;
+		}
+
+		if (p->status == PTEST_STATUS_BUDGET) {
+			coordinator_dequeue(co, i);
+			fprintf(co->fp, "SKIPPED: %s\n", ptest_dir);
+			PTEST_CALLBACK(opts, skipped, p, "time-budget");
+			continue;
+		}
+
+		if (opts->fail_fast > 0 && co->failures >= opts->fail_fast) {
+			coordinator_dequeue(co, i);
+			fprintf(co->fp, "SKIPPED: %s\n", ptest_dir);
+			PTEST_CALLBACK(opts, skipped, p, "fail-fast");
+			continue;
+		}
+
+		if (coordinator_waiting(co, i)) {
+			i++;
+			continue;
+		}
+
+		if (ptest_depends_failed(co->head, p, opts->config) != NULL) {
+			coordinator_dequeue(co, i);
+			fprintf(co->fp, "SKIPPED: %s\n", ptest_dir);
+			PTEST_CALLBACK(opts, skipped, p, "dependency");
+			continue;
+		}
+
+		if (ptest_fixtures_acquire(&co->fixtures, p, co->fp) == -1) {
+			coordinator_dequeue(co, i);
+			fprintf(co->fp, "SKIPPED: %s\n", ptest_dir);
+			p->status = PTEST_STATUS_FAIL;
+			PTEST_CALLBACK(opts, skipped, p, "fixture");
+			co->failures++;
+			coordinator_cancel(co);
+			continue;
+		}
+
+		/* Left queued, the hangup is seen on the next poll. */
+		if (send_line(w->fd, "run %s\n", p->ptest) == -1)
+			return;
+		coordinator_dequeue(co, i);
+		w->p = p;
+		p->slot = (int) (w - co->workers);
+		PTEST_CALLBACK(opts, start, p, w->pid);
+		return;
+	}
+
+	if (co->queue_no > 0) {
+		w->idle = 1;
+		return;
+	}
+
+	send_line(w->fd, "quit\n");
+	w->quit = 1;
+}
+
+/*
+ * After a ptest is done: cancels the others past --fail-fast, tears
+ * down the fixtures no queued or running ptest needs and gives what it
+ * held back to the idle workers.
+ */
+static void
+coordinator_done(struct coordinator *co)
+{
+	struct ptest_list *q;
+	int i;
+
+	coordinator_cancel(co);
+
+	/* The first of them in list order, everything after it is kept. */
+	for (q = co->head->next; q != NULL; q = q->next) {
+		if (co->queue_no > 0 && q == co->queue[0])
+			break;
+		for (i = 0; i < co->workers_no; i++)
+			if (co->workers[i].p == q)
+				break;
+		if (i < co->workers_no)
+			break;
+	}
+	ptest_fixtures_release(&co->fixtures, q, co->fp);
+
+	for (i = 0; i < co->workers_no; i++) {
+		struct coordinator_worker *w = &co->workers[i];
+
+		if (w->idle && w->fd != -1)
+			coordinator_dispatch(co, w);
+	}
+}
+
+static void
+coordinator_result(struct coordinator *co, struct coordinator_worker *w,
+		const char *log, size_t len)
+{
+	const struct ptest_options *opts = co->opts;
+	struct ptest_list *p = w->p;
+
+	fwrite(log, 1, len, co->fp);
+	fflush(co->fp);
+	if (len > 0)
+		PTEST_CALLBACK(opts, output, p, 0, log, len);
+	if (p->status == PTEST_STATUS_BUDGET) {
+		PTEST_CALLBACK(opts, skipped, p, "time-budget");
+	} else {
+		PTEST_CALLBACK(opts, end, p);
+		if (p->status != PTEST_STATUS_PASS)
+			co->failures++;
+	}
+
+	w->p = NULL;
+	w->in_log = 0;
+	coordinator_done(co);
+}
+
+static int
+coordinator_parse_result(struct coordinator_worker *w, const char *line)
+{
+	struct ptest_list *p = w->p;
+	int status, exit_code, sig, timedout, off = 0;
+	int64_t duration_ms, utime_ms, stime_ms;
+	long maxrss_kb;
+	size_t log_len;
+
+	if (p == NULL || sscanf(line, "result %d %d %d %d %" SCNd64 " %" SCNd64
+			" %" SCNd64 " %ld %zu %n", &status, &exit_code, &sig,
+			&timedout, &duration_ms, &utime_ms, &stime_ms, &maxrss_kb,
+			&log_len, &off) != 9 || off == 0 ||
+	    strcmp(line + off, p->ptest) != 0)
+		return -1;
+
+	p->status = status;
+	p->exit_code = exit_code;
+	p->signal = sig;
+	p->timedout = timedout;
+	p->duration_ms = duration_ms;
+	p->utime_ms = utime_ms;
+	p->stime_ms = stime_ms;
+	p->maxrss_kb = maxrss_kb;
+	w->log_len = log_len;
+	w->in_log = 1;
+
+	return 0;
+}
+
+/* Adds the overhead of the worker's last ptest to the run's. */
+static int
+coordinator_parse_stats(struct coordinator *co, const char *line)
+{
+	struct ptest_stats *st = co->opts->stats;
+	struct ptest_stats ws;
+
+	if (sscanf(line, "stats %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64
+			" %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64
+			" %ld", &ws.spawn_us, &ws.relay_us, &ws.report_us,
+			&ws.admission_us, &ws.bytes[0], &ws.bytes[1], &ws.reads,
+			&ws.writes, &ws.polls, &ws.maxrss_kb) != 10)
+		return -1;
+	if (st == NULL)
+		return 0;
+
+	st->spawn_us += ws.spawn_us;
+	st->relay_us += ws.relay_us;
+	st->report_us += ws.report_us;
+	st->admission_us += ws.admission_us;
+	st->bytes[0] += ws.bytes[0];
+	st->bytes[1] += ws.bytes[1];
+	st->reads += ws.reads;
+	st->writes += ws.writes;
+	st->polls += ws.polls;
+	if (ws.maxrss_kb > st->maxrss_kb)
+		st->maxrss_kb = ws.maxrss_kb;
+
+	return 0;
+}
+
+/* Consumes what w sent so far, -1 on a protocol error. */
+static int
+coordinator_process(struct coordinator *co, struct coordinator_worker *w)
+{
+	for (;;) {
+		char *nl;
+		size_t used;
+
+		if (w->in_log) {
+			if (w->len < w->log_len)
+				return 0;
+			coordinator_result(co, w, w->buf, w->log_len);
+			used = w->log_len;
+		} else {
+			nl = memchr(w->buf, '\n', w->len);
+			if (nl == NULL)
+				return w->len >= COORDINATOR_LINE_MAX ? -1 : 0;
+			*nl = '\0';
+			used = nl - w->buf + 1;
+
+			if (strcmp(w->buf, "ready") == 0) {
+				if (w->p != NULL)
+					return -1;
+				coordinator_dispatch(co, w);
+			} else if (strncmp(w->buf, "result ", 7) == 0) {
+				if (coordinator_parse_result(w, w->buf) == -1)
+					return -1;
+			} else if (strncmp(w->buf, "stats ", 6) == 0) {
+				if (coordinator_parse_stats(co, w->buf) == -1)
+					return -1;
+			} else {
+				return -1;
+			}
+		}
+
+		memmove(w->buf, w->buf + used, w->len - used);
+		w->len -= used;
+	}
+}
+
+static void
+coordinator_read(struct coordinator *co, struct coordinator_worker *w)
+{
+	const struct ptest_options *opts = co->opts;
+	ssize_t n;
+
+	if (w->size - w->len < COORDINATOR_LINE_MAX) {
+		w->size = w->size * 2 + COORDINATOR_LINE_MAX;
+		w->buf = realloc(w->buf, w->size);
+		CHECK_ALLOCATION(w->buf, w->size, 1);
+	}
+
+	n = read(w->fd, w->buf + w->len, w->size - w->len);
+	if (n == -1 && errno == EINTR)
+		return;
+
+	if (n > 0) {
+		w->len += n;
+		if (coordinator_process(co, w) == 0)
+			return;
+		fprintf(co->fp, "ERROR: Worker %d (%s) protocol error\n",
+				(int) w->pid, w->cmd);
+		kill(w->pid, SIGKILL);
+	}
+
+	if (w->p != NULL) {
+		fprintf(co->fp, "ERROR: Worker %d (%s) exited while running %s\n",
+				(int) w->pid, w->cmd, w->p->ptest);
+		w->p->status = PTEST_STATUS_FAIL;
+		PTEST_CALLBACK(opts, end, w->p);
+		co->failures++;
+		w->p = NULL;
+	}
+
+	close(w->fd);
+	w->fd = -1;
+	coordinator_done(co);
+}
+
+int
+ptest_coordinator_run(struct ptest_list *head,
+		const struct ptest_options *opts, char **cmds, int cmds_no,
+		const char *progname, FILE *fp)
+{
+	struct ptest_reporter *xml = NULL;
+	struct ptest_options xml_opts;
+	struct coordinator co;
+	struct ptest_list *p;
+	char ptest_dir[PATH_MAX];
+	int i;
+
+	if (opts->xml_filename) {
+		xml = ptest_reporter_open_format(PTEST_REPORT_JUNIT, opts->xml_filename);
+		if (!xml)
+			return -1;
+
+		xml_opts = *opts;
+		xml->callbacks.next = opts->callbacks;
+		xml_opts.callbacks = &xml->callbacks;
+		opts = &xml_opts;
+	}
+
+	memset(&co, 0, sizeof(co));
+	co.opts = opts;
+	co.progname = progname;
+	co.fp = fp;
+	co.head = head;
+	co.ptests_no = ptest_list_length(head);
+	co.queue = calloc((size_t) co.ptests_no + 1, sizeof(*co.queue));
+	CHECK_ALLOCATION(co.queue, sizeof(*co.queue), 0);
+	if (co.queue == NULL) {
+		ptest_reporter_close(xml);
+		return -1;
+	}
+	for (p = head->next; p != NULL; p = p->next)
+		co.queue[co.queue_no++] = p;
+	ptest_fixtures_init(&co.fixtures, opts->fixtures, opts->config,
+			opts->timeout, ptest_backend_get(opts->backend));
+
+	fprintf(fp, "START: %s\n", progname);
+	PTEST_CALLBACK(opts, run_start, co.ptests_no);
+
+	for (i = 0; i < cmds_no && i < COORDINATOR_MAX_WORKERS; i++)
+		if (coordinator_spawn(&co, cmds[i]) == -1)
+			fprintf(fp, "ERROR: Unable to start worker '%s', %s\n",
+					cmds[i], strerror(errno));
+
+	for (;;) {
+		struct pollfd pfds[COORDINATOR_MAX_WORKERS];
+		int map[COORDINATOR_MAX_WORKERS];
+		int n = 0;
+
+		for (i = 0; i < co.workers_no; i++) {
+			if (co.workers[i].fd == -1)
+				continue;
+			pfds[n].fd = co.workers[i].fd;
+			pfds[n].events = POLLIN;
+			map[n++] = i;
+		}
+		if (n == 0)
+			break;
+
+		if (poll(pfds, n, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			fprintf(fp, "ERROR: Poll %s\n", strerror(errno));
+			break;
+		}
+
+		/* A worker may be cancelled by what an earlier one sent. */
+		for (i = 0; i < n; i++)
+			if (pfds[i].revents != 0 && co.workers[map[i]].fd != -1)
+				coordinator_read(&co, &co.workers[map[i]]);
+	}
+
+	/* Every worker is gone, nobody is left to run the rest. */
+	for (i = 0; i < co.queue_no; i++) {
+		ptest_dir_of(co.queue[i], ptest_dir);
+		fprintf(fp, "SKIPPED: %s\n", ptest_dir);
+		PTEST_CALLBACK(opts, skipped, co.queue[i], "no-worker");
+		co.failures++;
+	}
+	ptest_fixtures_release(&co.fixtures, NULL, fp);
+	ptest_fixtures_free(&co.fixtures);
+	free(co.queue);
+
+	for (i = 0; i < co.workers_no; i++) {
+		struct coordinator_worker *w = &co.workers[i];
+
+		if (w->fd != -1)
+			close(w->fd);
+		while (waitpid(w->pid, NULL, 0) == -1 && errno == EINTR)
+			;
+		free(w->buf);
+	}
+
+	/* The largest of the coordinator and its workers. */
+	if (opts->stats) {
+		struct rusage ru;
+
+		getrusage(RUSAGE_SELF, &ru);
+		if (ru.ru_maxrss > opts->stats->maxrss_kb)
+			opts->stats->maxrss_kb = ru.ru_maxrss;
+		PTEST_CALLBACK(opts, stats, opts->stats);
+	}
+
+	fprintf(fp, "STOP: %s\n", progname);
+	PTEST_CALLBACK(opts, run_end, co.ptests_no, co.failures);
+	ptest_reporter_close(xml);
+	fflush(fp);
+
+	return co.failures;
+}
+
+/* Drops the START/STOP lines, the coordinator prints its own pair. */
+static void
+worker_trim_log(char **log, size_t *len)
+{
+	char *end;
+
+	if (*len > 7 && strncmp(*log, "START: ", 7) == 0 &&
+	    (end = memchr(*log, '\n', *len)) != NULL) {
+		*len -= end + 1 - *log;
+		*log = end + 1;
+	}
+
+	if (*len > 0 && (*log)[*len - 1] == '\n') {
+		end = memrchr(*log, '\n', *len - 1);
+		end = end == NULL ? *log : end + 1;
+		if (strncmp(end, "STOP: ", 6) == 0)
+			*len = end - *log;
+	}
+}
+
+static void
+worker_started(void *data, const struct ptest_list *p, pid_t pid)
+{
+	worker_ptest_pid = pid;
+}
+
+/* The ptest runs in its own session, its whole group goes with the worker. */
+static void
+worker_term(int sig)
+{
+	pid_t pid = worker_ptest_pid;
+
+	if (pid > 0) {
+		kill(-pid, SIGKILL);
+		kill(pid, SIGKILL);
+	}
+	_exit(1);
+}
+
+/*
+ * The coordinator orders the ptests and sets their fixtures up, the
+ * worker runs them with what is left of the config. Entries are shared
+ * with cfg, only the array is allocated.
+ */
+static int
+worker_config(const struct ptest_config *cfg, struct ptest_config *view)
+{
+	int i;
+
+	memset(view, 0, sizeof(*view));
+	if (cfg == NULL || cfg->entries_no == 0)
+		return 0;
+
+	view->entries = calloc((size_t) cfg->entries_no, sizeof(*view->entries));
+	CHECK_ALLOCATION(view->entries, sizeof(*view->entries), 0);
+	if (view->entries == NULL)
+		return -1;
+	for (i = 0; i < cfg->entries_no; i++)
+		if (strcmp(cfg->entries[i].key, "depends") != 0 &&
+		    strcmp(cfg->entries[i].key, "fixtures") != 0)
+			view->entries[view->entries_no++] = cfg->entries[i];
+	view->entries_size = cfg->entries_no;
+
+	return 0;
+}
+
+int
+ptest_worker_run(const struct ptest_options *opts, const char *progname,
+		int fd_in, int fd_out)
+{
+	struct ptest_options wopts = *opts;
+	struct ptest_callbacks callbacks;
+	struct ptest_stats stats;
+	struct ptest_config config;
+	struct ptest_list *head;
+	char *line = NULL;
+	size_t line_size = 0;
+	ssize_t n;
+	FILE *in;
+
+	/*
+	 * The coordinator writes the only report and feeds every client of
+	 * the chain (events, archive, metrics, prefetch ...) from the results,
+	 * a forked local worker would otherwise run them all a second time
+	 * into the same files. The history is only read here, for adaptive
+	 * deadlines, the cache and history files are saved by the coordinator.
+	 * The stats of each ptest are sent back to be added up there.
+	 */
+	wopts.xml_filename = NULL;
+	wopts.stats = &stats;
+	memset(&callbacks, 0, sizeof(callbacks));
+	callbacks.start = worker_started;
+	wopts.callbacks = &callbacks;
+	if (worker_config(opts->config, &config) == -1)
+		return 1;
+	wopts.config = &config;
+	wopts.fixtures = NULL;
+
+	head = get_available_ptests_dirs(opts->dirs, opts->dirs_no, NULL,
+			stderr);
+
+	in = fdopen(fd_in, "r");
+	if (in == NULL) {
+		free(config.entries);
+		if (head != NULL)
+			ptest_list_free_all(head);
+		return 1;
+	}
+
+	/* The coordinator cancels a ptest by terminating its worker. */
+	signal(SIGTERM, worker_term);
+	signal(SIGINT, worker_term);
+	signal(SIGHUP, worker_term);
+
+	if (send_line(fd_out, "ready\n") == -1)
+		goto out;
+
+	while ((n = getline(&line, &line_size, in)) != -1) {
+		struct ptest_list *run = NULL, *p;
+		char *name, *log = NULL, *out;
+		size_t log_size = 0, len;
+		FILE *log_fp;
+
+		if (n > 0 && line[n - 1] == '\n')
+			line[n - 1] = '\0';
+		if (strcmp(line, "quit") == 0)
+			break;
+		if (strncmp(line, "run ", 4) != 0)
+			continue;
+		name = line + 4;
+
+		log_fp = open_memstream(&log, &log_size);
+		CHECK_ALLOCATION(log_fp, 1, 1);
+		memset(&stats, 0, sizeof(stats));
+
+		if (head != NULL)
+			run = filter_ptests(head, &name, 1);
+		if (run != NULL && run->next != NULL) {
+			run_ptests(run, &wopts, progname, log_fp, log_fp);
+			worker_ptest_pid = 0;
+			p = run->next;
+		} else {
+			fprintf(log_fp, "ERROR: ptest %s not found by the worker\n",
+					name);
+			p = NULL;
+		}
+		fclose(log_fp);
+
+		out = log;
+		len = log_size;
+		worker_trim_log(&out, &len);
+
+		if (p != NULL)
+			n = send_line(fd_out, "result %d %d %d %d %" PRId64 " %" PRId64
+					" %" PRId64 " %ld %zu %s\n", p->status,
+					p->exit_code, p->signal, p->timedout,
+					p->duration_ms, p->utime_ms, p->stime_ms,
+					p->maxrss_kb, len, name);
+		else
+			n = send_line(fd_out, "result %d 0 0 0 0 0 0 0 %zu %s\n",
+					PTEST_STATUS_NOTRUN, len, name);
+
+		if (n != -1)
+			n = write_all(fd_out, out, len);
+		if (n != -1)
+			n = send_line(fd_out, "stats %" PRId64 " %" PRId64 " %" PRId64
+					" %" PRId64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+					" %" PRIu64 " %" PRIu64 " %ld\n", stats.spawn_us,
+					stats.relay_us, stats.report_us, stats.admission_us,
+					stats.bytes[0], stats.bytes[1], stats.reads,
+					stats.writes, stats.polls, stats.maxrss_kb);
+		if (n != -1)
+			n = send_line(fd_out, "ready\n");
+
+		free(log);
+		if (run != NULL)
+			ptest_list_free_all(run);
+		if (n == -1)
+			break;
+	}
+
+out:
+	free(line);
+	free(config.entries);
+	fclose(in);
+	if (head != NULL)
+		ptest_list_free_all(head);
+
+	return 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_COORDINATOR_H
+#define PTEST_RUNNER_COORDINATOR_H
+
+#include <stdio.h>
+
+#include "ptest_list.h"
+#include "utils.h"
+
+#define COORDINATOR_MAX_WORKERS PTEST_MAX_SLOTS
+/* Worker command forked from the coordinator itself, with its options. */
+#define COORDINATOR_LOCAL_WORKER "local"
+
+/*
+ * Fans a run out to worker instances of ptest-runner, each started with
+ * /bin/sh -c from a command, e.g. "chroot /srv/image1 ptest-runner
+ * --worker -t 300", and talking over a Unix socket on its stdin and
+ * stdout. Workers pull ptests from the coordinator's queue one at a
+ * time, so the fast ones take more of the work:
+ *
+ *   worker:      ready
+ *   coordinator: run NAME | quit
+ *   worker:      result STATUS EXIT SIGNAL TIMEDOUT DURATION_MS UTIME_MS
+ *                       STIME_MS MAXRSS_KB LOG_BYTES NAME
+ *                LOG_BYTES bytes of the run_ptests() log
+ *                stats SPAWN_US RELAY_US REPORT_US ADMISSION_US
+ *                      STDOUT_BYTES STDERR_BYTES READS WRITES POLLS
+ *                      MAXRSS_KB
+ *   worker:      ready
+ *
+ * A ptest is only handed out once the ptests it depends on are done, a
+ * worker with nothing runnable meanwhile waits. Fixtures are set up and
+ * torn down by the coordinator, once for all the workers, which run
+ * without the depends= and fixtures= of the config.
+ *
+ * Once --fail-fast is reached the ptests still running are cancelled,
+ * their worker is sent SIGTERM, on which it kills the ptest and exits,
+ * and they are reported as skipped.
+ *
+ * The stats of the workers are added to opts->stats, maxrss is the
+ * largest of them and the coordinator.
+ *
+ * Results are merged into head and go through the callbacks as if the
+ * run was local, except that the output hook gets the whole log of a
+ * ptest once it is done, as stream 0. ptests left when every worker is
+ * gone are skipped and counted as failures. Returns the number of
+ * failures.
+ */
+extern int ptest_coordinator_run(struct ptest_list *,
+		const struct ptest_options *, char **, int, const char *, FILE *);
+
+/*
+ * Worker side, serves the protocol on fd_in/fd_out running each ptest
+ * with run_ptests() out of its own discovery of opts->dirs.
+ */
+extern int ptest_worker_run(const struct ptest_options *, const char *, int,
+		int);
+
+#endif // PTEST_RUNNER_COORDINATOR_H
@@ -0,0 +1,240 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "events.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+static const char *
+status_str(int status)
+{
+	switch (status) {
+		case PTEST_STATUS_PASS:
+			return "pass";
+		case PTEST_STATUS_FAIL:
+			return "fail";
+		case PTEST_STATUS_CACHED:
+			return "cached";
+		case PTEST_STATUS_BUDGET:
+			return "budget";
+		default:
+			return "notrun";
+	}
+}
+
+static void
+event_begin(struct ptest_events *ev, const char *event)
+{
+	int64_t now = ptest_backend_wall_ms(ev->backend);
+
+	fprintf(ev->fp, "{\"event\":\"%s\",\"time\":%jd.%03d", event,
+			(intmax_t) (now / 1000), (int) (now % 1000));
+}
+
+static void
+event_ptest(struct ptest_events *ev, const struct ptest_list *p)
+{
+	fprintf(ev->fp, ",\"ptest\":");
+	json_print_string(ev->fp, p->ptest, strlen(p->ptest));
+}
+
+/* One line per event and flushed, a crash loses at most the last one. */
+static void
+event_end(struct ptest_events *ev)
+{
+	fputs("}\n", ev->fp);
+	fflush(ev->fp);
+}
+
+static void
+events_run_start(void *data, int ptests)
+{
+	struct ptest_events *ev = data;
+
+	ev->run_start_ms = ptest_backend_clock_ms(ev->backend);
+	event_begin(ev, "run_start");
+	fprintf(ev->fp, ",\"ptests\":%d,\"pid\":%d", ptests, (int) getpid());
+	event_end(ev);
+}
+
+static void
+events_start(void *data, const struct ptest_list *p, pid_t pid)
+{
+	struct ptest_events *ev = data;
+
+	ev->output_bytes[p->slot] = 0;
+	event_begin(ev, "ptest_start");
+	event_ptest(ev, p);
+	fprintf(ev->fp, ",\"path\":");
+	json_print_string(ev->fp, p->run_ptest, strlen(p->run_ptest));
+	fprintf(ev->fp, ",\"slot\":%d,\"pid\":%d", p->slot, (int) pid);
+	event_end(ev);
+}
+
+static void
+events_output(void *data, const struct ptest_list *p, int stream,
+		const char *buf, size_t len)
+{
+	struct ptest_events *ev = data;
+
+	ev->output_bytes[p->slot] += len;
+}
+
+static void
+events_heartbeat(void *data, const struct ptest_list *p, int64_t elapsed_ms)
+{
+	struct ptest_events *ev = data;
+
+	event_begin(ev, "heartbeat");
+	event_ptest(ev, p);
+	fprintf(ev->fp, ",\"slot\":%d,\"elapsed_ms\":%" PRId64
+			",\"output_bytes\":%" PRIu64, p->slot, elapsed_ms,
+			ev->output_bytes[p->slot]);
+	event_end(ev);
+}
+
+static void
+events_end(void *data, const struct ptest_list *p)
+{
+	struct ptest_events *ev = data;
+
+	event_begin(ev, "ptest_end");
+	event_ptest(ev, p);
+	fprintf(ev->fp, ",\"slot\":%d,\"status\":\"%s\",\"exit_code\":%d"
+			",\"signal\":%d,\"timeout\":%s,\"duration_ms\":%" PRId64
+			",\"utime_ms\":%" PRId64 ",\"stime_ms\":%" PRId64
+			",\"maxrss_kb\":%ld,\"oom_killed\":%s,\"memory_peak_kb\":%ld"
+			",\"output_bytes\":%" PRIu64,
+			p->slot, status_str(p->status), p->exit_code, p->signal,
+			p->timedout ? "true" : "false", p->duration_ms,
+			p->utime_ms, p->stime_ms, p->maxrss_kb,
+			p->oom_killed ? "true" : "false", p->memory_peak_kb,
+			ev->output_bytes[p->slot]);
+	event_end(ev);
+}
+
+static void
+events_skipped(void *data, const struct ptest_list *p, const char *reason)
+{
+	struct ptest_events *ev = data;
+
+	event_begin(ev, "ptest_skipped");
+	event_ptest(ev, p);
+	fprintf(ev->fp, ",\"reason\":");
+	json_print_string(ev->fp, reason, strlen(reason));
+	event_end(ev);
+}
+
+static void
+events_stats(void *data, const struct ptest_stats *st)
+{
+	struct ptest_events *ev = data;
+
+	event_begin(ev, "stats");
+	fprintf(ev->fp, ",\"discovery_us\":%" PRId64 ",\"filter_us\":%" PRId64
+			",\"spawn_us\":%" PRId64 ",\"relay_us\":%" PRId64
+			",\"report_us\":%" PRId64 ",\"admission_us\":%" PRId64
+			",\"stdout_bytes\":%" PRIu64
+			",\"stderr_bytes\":%" PRIu64 ",\"reads\":%" PRIu64
+			",\"writes\":%" PRIu64 ",\"polls\":%" PRIu64
+			",\"maxrss_kb\":%ld", st->discovery_us, st->filter_us,
+			st->spawn_us, st->relay_us, st->report_us, st->admission_us,
+			st->bytes[0],
+			st->bytes[1], st->reads, st->writes, st->polls, st->maxrss_kb);
+	event_end(ev);
+}
+
+static void
+events_run_end(void *data, int ptests, int failures)
+{
+	struct ptest_events *ev = data;
+
+	event_begin(ev, "run_end");
+	fprintf(ev->fp, ",\"ptests\":%d,\"failures\":%d,\"duration_ms\":%" PRId64,
+			ptests, failures,
+			ptest_backend_clock_ms(ev->backend) - ev->run_start_ms);
+	event_end(ev);
+}
+
+struct ptest_events *
+ptest_events_open(const char *spec)
+{
+	struct ptest_events *ev;
+	const char *c;
+
+	ev = calloc(1, sizeof(struct ptest_events));
+	CHECK_ALLOCATION(ev, sizeof(struct ptest_events), 0);
+	if (ev == NULL)
+		return NULL;
+
+	/* A plain number is an already open file descriptor. */
+	for (c = spec; isdigit(*c); c++)
+		;
+	if (*spec != '\0' && *c == '\0') {
+		int fd = fcntl(atoi(spec), F_DUPFD_CLOEXEC, 0);
+		ev->fp = fd == -1 ? NULL : fdopen(fd, "w");
+	} else {
+		ev->fp = fopen(spec, "we");
+	}
+
+	if (ev->fp == NULL) {
+		fprintf(stderr, "Events file '%s' could not be opened. %s.\n",
+				spec, strerror(errno));
+		free(ev);
+		return NULL;
+	}
+
+	ev->callbacks.run_start = events_run_start;
+	ev->callbacks.start = events_start;
+	ev->callbacks.output = events_output;
+	ev->callbacks.heartbeat = events_heartbeat;
+	ev->callbacks.end = events_end;
+	ev->callbacks.skipped = events_skipped;
+	ev->callbacks.stats = events_stats;
+	ev->callbacks.run_end = events_run_end;
+	ev->callbacks.data = ev;
+
+	return ev;
+}
+
+void
+ptest_events_close(struct ptest_events *ev)
+{
+	if (ev == NULL)
+		return;
+
+	fclose(ev->fp);
+	free(ev);
+}
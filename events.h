@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_EVENTS_H
+#define PTEST_RUNNER_EVENTS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ptest_list.h"
+#include "utils.h"
+
+#define EVENTS_DEFAULT_HEARTBEAT 10
+
+/*
+ * Newline delimited JSON stream of run_start, ptest_start, heartbeat,
+ * ptest_end, ptest_skipped and run_end events, flushed after every line.
+ * ptests running side by side are told apart by their slot, the output
+ * is counted per slot.
+ * Times come from backend, set it to the backend of the run, NULL for
+ * the system clocks.
+ */
+struct ptest_events {
+	FILE *fp;
+	const struct ptest_backend *backend;
+	int64_t run_start_ms;
+	uint64_t output_bytes[PTEST_MAX_SLOTS];
+
+	struct ptest_callbacks callbacks;
+};
+
+extern struct ptest_events *ptest_events_open(const char *);
+extern void ptest_events_close(struct ptest_events *);
+
+#endif // PTEST_RUNNER_EVENTS_H
@@ -0,0 +1,374 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "config.h"
+#include "fixture.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+/* Whether name is one of the comma separated names in list. */
+static int
+list_has(const char *list, const char *name, size_t name_len)
+{
+	while (list != NULL && *list != '\0') {
+		size_t len = strcspn(list, ",");
+
+		if (len == name_len && strncmp(list, name, len) == 0)
+			return 1;
+		list += len;
+		if (*list == ',')
+			list++;
+	}
+
+	return 0;
+}
+
+static int
+depends_placed(struct ptest_list **nodes, const char *placed, int n, int i,
+		const struct ptest_config *cfg)
+{
+	const char *deps = ptest_config_get(cfg, nodes[i]->ptest, "depends");
+	int j;
+
+	if (deps == NULL)
+		return 1;
+	for (j = 0; j < n; j++)
+		if (!placed[j] && list_has(deps, nodes[j]->ptest,
+		    strlen(nodes[j]->ptest)))
+			return 0;
+
+	return 1;
+}
+
+int
+ptest_depends_order(struct ptest_list *head, const struct ptest_config *cfg,
+		FILE *fp)
+{
+	struct ptest_list **nodes, **order, *p, *last;
+	int n = ptest_list_length(head), i, k, rc = 0;
+	char *placed;
+
+	if (n <= 0 || cfg == NULL)
+		return 0;
+
+	nodes = calloc((size_t) n, sizeof(*nodes));
+	order = calloc((size_t) n, sizeof(*order));
+	placed = calloc((size_t) n, 1);
+	CHECK_ALLOCATION(nodes, (size_t) n * sizeof(*nodes), 0);
+	CHECK_ALLOCATION(order, (size_t) n * sizeof(*order), 0);
+	CHECK_ALLOCATION(placed, (size_t) n, 0);
+	if (nodes == NULL || order == NULL || placed == NULL) {
+		free(placed);
+		free(order);
+		free(nodes);
+		return -1;
+	}
+
+	i = 0;
+	PTEST_LIST_ITERATE_START(head, p)
+		nodes[i++] = p;
+	PTEST_LIST_ITERATE_END
+
+	/* Earliest ptest whose dependencies are all placed goes next. */
+	for (k = 0; k < n; k++) {
+		for (i = 0; i < n; i++)
+			if (!placed[i] && depends_placed(nodes, placed, n, i, cfg))
+				break;
+		if (i == n) {
+			fprintf(fp, "ERROR: Dependency cycle between");
+			for (i = 0; i < n; i++)
+				if (!placed[i])
+					fprintf(fp, " %s", nodes[i]->ptest);
+			fprintf(fp, "\n");
+			rc = -1;
+			break;
+		}
+		placed[i] = 1;
+		order[k] = nodes[i];
+	}
+
+	if (rc == 0) {
+		last = head;
+		head->next = NULL;
+		for (k = 0; k < n; k++) {
+			p = order[k];
+			last->next = p;
+			p->prev = last;
+			p->next = NULL;
+			last = p;
+		}
+	}
+
+	free(placed);
+	free(order);
+	free(nodes);
+
+	return rc;
+}
+
+int
+ptest_depends_on(const struct ptest_list *p, const struct ptest_list *q,
+		const struct ptest_config *cfg)
+{
+	return list_has(ptest_config_get(cfg, p->ptest, "depends"), q->ptest,
+			strlen(q->ptest));
+}
+
+const char *
+ptest_depends_failed(const struct ptest_list *head, const struct ptest_list *p,
+		const struct ptest_config *cfg)
+{
+	const char *deps = ptest_config_get(cfg, p->ptest, "depends");
+	const struct ptest_list *q;
+
+	if (deps == NULL)
+		return NULL;
+
+	for (q = head->next; q != NULL && q != p; q = q->next)
+		if (q->status != PTEST_STATUS_PASS &&
+		    q->status != PTEST_STATUS_CACHED &&
+		    list_has(deps, q->ptest, strlen(q->ptest)))
+			return q->ptest;
+
+	return NULL;
+}
+
+void
+ptest_fixtures_init(struct ptest_fixtures *fx, const char *dir,
+		const struct ptest_config *cfg, unsigned int timeout,
+		const struct ptest_backend *be)
+{
+	memset(fx, 0, sizeof(*fx));
+	fx->dir = dir;
+	fx->config = cfg;
+	fx->backend = be;
+	fx->timeout = timeout;
+}
+
+/* NULL when out of memory. */
+static struct ptest_fixture *
+fixture_get(struct ptest_fixtures *fx, const char *name, size_t len)
+{
+	struct ptest_fixture *f;
+	char *f_name;
+	int i;
+
+	for (i = 0; i < fx->fixtures_no; i++)
+		if (strlen(fx->fixtures[i].name) == len &&
+		    strncmp(fx->fixtures[i].name, name, len) == 0)
+			return &fx->fixtures[i];
+
+	f_name = strndup(name, len);
+	CHECK_ALLOCATION(f_name, len, 0);
+	if (f_name == NULL)
+		return NULL;
+	f = realloc(fx->fixtures,
+			sizeof(*fx->fixtures) * (size_t) (fx->fixtures_no + 1));
+	CHECK_ALLOCATION(f, sizeof(*fx->fixtures), 0);
+	if (f == NULL) {
+		free(f_name);
+		return NULL;
+	}
+	fx->fixtures = f;
+	f = &fx->fixtures[fx->fixtures_no++];
+	memset(f, 0, sizeof(*f));
+	f->name = f_name;
+
+	return f;
+}
+
+/* Runs script of fixture f to completion, returns 0 when it exits 0. */
+static int
+fixture_run(struct ptest_fixtures *fx, struct ptest_fixture *f,
+		const char *script, FILE *fp)
+{
+	const struct ptest_backend *be = fx->backend;
+	char dir[PATH_MAX], path[PATH_MAX];
+	struct ptest_list script_p;
+	int64_t deadline_at;
+	int status, out;
+	pid_t pid, ret;
+
+	if (fx->dir == NULL) {
+		fprintf(fp, "ERROR: Fixture %s needs a fixtures directory\n", f->name);
+		return -1;
+	}
+
+	if (snprintf(dir, sizeof(dir), "%s/%s", fx->dir, f->name) >=
+	    (int) sizeof(dir) || snprintf(path, sizeof(path), "%s/%s/%s",
+	    fx->dir, f->name, script) >= (int) sizeof(path)) {
+		fprintf(fp, "ERROR: Fixture %s path is too long\n", f->name);
+		return -1;
+	}
+	if (access(path, X_OK) == -1) {
+		/* Nothing to stop is fine, nothing to start is not. */
+		if (strcmp(script, FIXTURE_TEARDOWN) == 0)
+			return 0;
+		fprintf(fp, "ERROR: Fixture %s has no %s, %s\n", f->name, path,
+				strerror(errno));
+		return -1;
+	}
+
+	fprintf(fp, "FIXTURE: %s %s\n", script, f->name);
+	fflush(fp);
+
+	/*
+	 * The output goes straight to the log instead of through a pipe, a
+	 * service left running by setup would otherwise hold it open.
+	 */
+	out = fileno(fp);
+	if (out == -1)
+		out = open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+	/* The backend sees the script as what it spawns. */
+	memset(&script_p, 0, sizeof(script_p));
+	script_p.ptest = f->name;
+	script_p.run_ptest = path;
+
+	pid = be->spawn(be->data, &script_p, out, out);
+	if (pid == -1) {
+		fprintf(fp, "ERROR: Fork %s\n", strerror(errno));
+		if (out != fileno(fp))
+			close(out);
+		return -1;
+	} else if (pid == 0) {
+		setsid();
+		dup2(out, STDOUT_FILENO);
+		dup2(out, STDERR_FILENO);
+		/* path may be relative to where the runner was started. */
+		snprintf(path, sizeof(path), "./%s", script);
+		if (chdir(dir) == 0)
+			execl(path, path, (char *) NULL);
+		_exit(127);
+	}
+	if (out != fileno(fp))
+		close(out);
+
+	deadline_at = be->clock_ms(be->data) + (int64_t) fx->timeout * 1000;
+	while ((ret = be->wait(be->data, pid, &status, WNOHANG, NULL)) == 0) {
+		if (fx->timeout > 0 && be->clock_ms(be->data) >= deadline_at) {
+			be->kill(be->data, -pid, SIGKILL);
+			be->wait(be->data, pid, &status, 0, NULL);
+			fprintf(fp, "ERROR: Fixture %s %s timed out after %u seconds\n",
+					f->name, script, fx->timeout);
+			return -1;
+		}
+		/* Nothing to poll, this only waits. */
+		be->poll(be->data, NULL, 0, FIXTURE_POLL_MS);
+	}
+
+	if (ret == -1) {
+		fprintf(fp, "ERROR: Fixture %s %s wait failed, %s\n", f->name,
+				script, strerror(errno));
+		return -1;
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(fp, "ERROR: Fixture %s %s failed with status %d\n",
+				f->name, script, WIFEXITED(status) ?
+				WEXITSTATUS(status) : -1);
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+ptest_fixtures_acquire(struct ptest_fixtures *fx, const struct ptest_list *p,
+		FILE *fp)
+{
+	const char *list = ptest_config_get(fx->config, p->ptest, "fixtures");
+	int rc = 0;
+
+	while (list != NULL && *list != '\0') {
+		size_t len = strcspn(list, ",");
+
+		if (len > 0) {
+			struct ptest_fixture *f = fixture_get(fx, list, len);
+
+			if (f == NULL) {
+				rc = -1;
+				break;
+			}
+			if (f->state == PTEST_FIXTURE_DOWN)
+				f->state = fixture_run(fx, f, FIXTURE_SETUP, fp) == 0 ?
+					PTEST_FIXTURE_UP : PTEST_FIXTURE_FAILED;
+			if (f->state == PTEST_FIXTURE_FAILED)
+				rc = -1;
+		}
+		list += len;
+		if (*list == ',')
+			list++;
+	}
+
+	return rc;
+}
+
+void
+ptest_fixtures_release(struct ptest_fixtures *fx, const struct ptest_list *p,
+		FILE *fp)
+{
+	int i;
+
+	/* Last set up, first torn down. */
+	for (i = fx->fixtures_no - 1; i >= 0; i--) {
+		struct ptest_fixture *f = &fx->fixtures[i];
+		const struct ptest_list *q;
+
+		if (f->state != PTEST_FIXTURE_UP)
+			continue;
+		for (q = p; q != NULL; q = q->next)
+			if (list_has(ptest_config_get(fx->config, q->ptest, "fixtures"),
+			    f->name, strlen(f->name)))
+				break;
+		if (q != NULL)
+			continue;
+
+		fixture_run(fx, f, FIXTURE_TEARDOWN, fp);
+		f->state = PTEST_FIXTURE_DOWN;
+	}
+}
+
+void
+ptest_fixtures_free(struct ptest_fixtures *fx)
+{
+	int i;
+
+	for (i = 0; i < fx->fixtures_no; i++)
+		free(fx->fixtures[i].name);
+	free(fx->fixtures);
+	fx->fixtures = NULL;
+	fx->fixtures_no = 0;
+}
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_FIXTURE_H
+#define PTEST_RUNNER_FIXTURE_H
+
+#include <stdio.h>
+
+#include "config.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+#define FIXTURE_SETUP "setup"
+#define FIXTURE_TEARDOWN "teardown"
+#define FIXTURE_POLL_MS 50
+
+/*
+ * Dependencies and shared fixtures are declared in the ptest config as
+ * comma separated names:
+ *
+ *   python3  depends=openssl,sqlite3
+ *   dbus     fixtures=session-bus
+ *   pygobject fixtures=session-bus depends=dbus
+ *
+ * ptest_depends_order() reorders the list so every ptest comes after
+ * what it depends on, otherwise keeping the current order. Dependencies
+ * that are not in the list are ignored, a cycle is printed to fp and
+ * leaves the list untouched. Returns 0 or -1 on a cycle or when out of
+ * memory.
+ */
+extern int ptest_depends_order(struct ptest_list *, const struct ptest_config *,
+		FILE *);
+
+/* Whether p declares q in its depends=. */
+extern int ptest_depends_on(const struct ptest_list *, const struct ptest_list *,
+		const struct ptest_config *);
+
+/*
+ * Name of a dependency of p earlier in the list that did not pass, so
+ * p is skipped instead of failing on its account, or NULL.
+ */
+extern const char *ptest_depends_failed(const struct ptest_list *,
+		const struct ptest_list *, const struct ptest_config *);
+
+/*
+ * A fixture NAME is the DIR/NAME/setup and DIR/NAME/teardown pair of
+ * executables, DIR given by --fixtures. setup is run once before the
+ * first ptest that needs NAME and teardown after the last one, both
+ * from DIR/NAME with the output going to the log and at most timeout
+ * seconds each, spawned and waited for through the backend of the run.
+ * A fixture whose setup failed is not retried.
+ */
+struct ptest_fixture {
+	char *name;
+	int state;
+	int padding1;
+};
+
+struct ptest_fixtures {
+	const char *dir;
+	const struct ptest_config *config;
+	const struct ptest_backend *backend;
+	unsigned int timeout;
+	int fixtures_no;
+	struct ptest_fixture *fixtures;
+};
+
+enum ptest_fixture_state {
+	PTEST_FIXTURE_DOWN = 0,
+	PTEST_FIXTURE_UP,
+	PTEST_FIXTURE_FAILED,
+};
+
+extern void ptest_fixtures_init(struct ptest_fixtures *, const char *,
+		const struct ptest_config *, unsigned int,
+		const struct ptest_backend *);
+/* Sets up what p needs, returns -1 when one of them is not available. */
+extern int ptest_fixtures_acquire(struct ptest_fixtures *,
+		const struct ptest_list *, FILE *);
+/* Tears down what p and the ptests after it don't need, all with NULL. */
+extern void ptest_fixtures_release(struct ptest_fixtures *,
+		const struct ptest_list *, FILE *);
+extern void ptest_fixtures_free(struct ptest_fixtures *);
+
+#endif // PTEST_RUNNER_FIXTURE_H
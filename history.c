@@ -0,0 +1,261 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "history.h"
+#include "utils.h"
+
+#define HISTORY_HEADER "# ptest-runner history v1\n"
+
+static struct ptest_history_entry *
+history_append(struct ptest_history *h, const char *ptest)
+{
+	struct ptest_history_entry *e;
+
+	if (h->entries_no == h->entries_size) {
+		int size = h->entries_size ? h->entries_size * 2 : 64;
+		e = realloc(h->entries, sizeof(struct ptest_history_entry) * (size_t) size);
+		CHECK_ALLOCATION(e, sizeof(struct ptest_history_entry) * (size_t) size, 0);
+		if (e == NULL)
+			return NULL;
+		h->entries = e;
+		h->entries_size = size;
+	}
+
+	e = &h->entries[h->entries_no];
+	memset(e, 0, sizeof(*e));
+	e->ptest = strdup(ptest);
+	CHECK_ALLOCATION(e->ptest, strlen(ptest), 0);
+	if (e->ptest == NULL)
+		return NULL;
+	h->entries_no++;
+
+	return e;
+}
+
+static void
+history_add_sample(struct ptest_history_entry *e,
+		const struct ptest_history_sample *s)
+{
+	if (e->samples_no == PTEST_HISTORY_MAX_SAMPLES) {
+		memmove(&e->samples[0], &e->samples[1],
+				sizeof(e->samples[0]) * (PTEST_HISTORY_MAX_SAMPLES - 1));
+		e->samples_no--;
+	}
+	e->samples[e->samples_no++] = *s;
+}
+
+struct ptest_history_entry *
+ptest_history_find(const struct ptest_history *h, const char *ptest)
+{
+	int i;
+
+	for (i = 0; i < h->entries_no; i++)
+		if (strcmp(h->entries[i].ptest, ptest) == 0)
+			return &h->entries[i];
+
+	return NULL;
+}
+
+struct ptest_history *
+ptest_history_load(const char *filename)
+{
+	struct ptest_history *h;
+	FILE *fp;
+	char *line = NULL;
+	size_t line_size = 0;
+
+	h = calloc(1, sizeof(struct ptest_history));
+	CHECK_ALLOCATION(h, sizeof(struct ptest_history), 0);
+	if (h == NULL)
+		return NULL;
+
+	h->filename = strdup(filename);
+	CHECK_ALLOCATION(h->filename, strlen(filename), 0);
+	if (h->filename == NULL) {
+		free(h);
+		return NULL;
+	}
+
+	/* A missing history file is the same as an empty one. */
+	fp = fopen(filename, "r");
+	if (fp == NULL)
+		return h;
+
+	while (getline(&line, &line_size, fp) != -1) {
+		char name[NAME_MAX + 1];
+		struct ptest_history_sample s;
+		struct ptest_history_entry *e;
+		intmax_t timestamp;
+
+		if (line[0] == '#')
+			continue;
+
+		if (sscanf(line, "%255s %jd %d %d %" SCNd64 " %" SCNd64,
+		    name, &timestamp, &s.status, &s.timedout, &s.duration_ms,
+		    &s.cpu_ms) != 6)
+			continue;
+		s.timestamp = (time_t) timestamp;
+
+		e = ptest_history_find(h, name);
+		if (e == NULL)
+			e = history_append(h, name);
+		if (e == NULL)
+			break;
+		history_add_sample(e, &s);
+	}
+
+	free(line);
+	fclose(fp);
+
+	return h;
+}
+
+static int
+cmp_int64(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * Nearest rank percentile of the passing durations, -1 when there are
+ * less than PTEST_HISTORY_MIN_SAMPLES of them.
+ */
+int64_t
+ptest_history_percentile(const struct ptest_history_entry *e, int pct)
+{
+	int64_t durations[PTEST_HISTORY_MAX_SAMPLES];
+	int i, n = 0, rank;
+
+	for (i = 0; i < e->samples_no; i++)
+		if (e->samples[i].status == PTEST_STATUS_PASS)
+			durations[n++] = e->samples[i].duration_ms;
+
+	if (n < PTEST_HISTORY_MIN_SAMPLES)
+		return -1;
+
+	qsort(durations, (size_t) n, sizeof(durations[0]), cmp_int64);
+	rank = (pct * n + 99) / 100;
+	if (rank < 1)
+		rank = 1;
+
+	return durations[rank - 1];
+}
+
+void
+ptest_history_update(struct ptest_history *h, struct ptest_list *head)
+{
+	struct ptest_list *p;
+	time_t now = time(NULL);
+
+	PTEST_LIST_ITERATE_START(head, p)
+		struct ptest_history_sample s;
+		struct ptest_history_entry *e;
+
+		if (p->status != PTEST_STATUS_PASS && p->status != PTEST_STATUS_FAIL)
+			continue;
+
+		e = ptest_history_find(h, p->ptest);
+		if (e == NULL)
+			e = history_append(h, p->ptest);
+		if (e == NULL)
+			continue;
+
+		s.timestamp = now;
+		s.status = p->status;
+		s.timedout = p->timedout;
+		s.duration_ms = p->duration_ms;
+		s.cpu_ms = p->utime_ms + p->stime_ms;
+		history_add_sample(e, &s);
+	PTEST_LIST_ITERATE_END
+}
+
+int
+ptest_history_save(struct ptest_history *h)
+{
+	char *tmp;
+	FILE *fp;
+	int i, j;
+
+	if (asprintf(&tmp, "%s.tmp", h->filename) == -1)
+		return -1;
+
+	fp = fopen(tmp, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "History file '%s' could not be created. %s.\n",
+				tmp, strerror(errno));
+		free(tmp);
+		return -1;
+	}
+
+	fprintf(fp, HISTORY_HEADER);
+	for (i = 0; i < h->entries_no; i++) {
+		struct ptest_history_entry *e = &h->entries[i];
+
+		for (j = 0; j < e->samples_no; j++) {
+			struct ptest_history_sample *s = &e->samples[j];
+
+			fprintf(fp, "%s %jd %d %d %" PRId64 " %" PRId64 "\n",
+					e->ptest, (intmax_t) s->timestamp, s->status,
+					s->timedout, s->duration_ms, s->cpu_ms);
+		}
+	}
+
+	if (fclose(fp) != 0 || rename(tmp, h->filename) == -1) {
+		fprintf(stderr, "History file '%s' could not be written. %s.\n",
+				h->filename, strerror(errno));
+		unlink(tmp);
+		free(tmp);
+		return -1;
+	}
+
+	free(tmp);
+
+	return 0;
+}
+
+void
+ptest_history_free(struct ptest_history *h)
+{
+	int i;
+
+	if (h == NULL)
+		return;
+
+	for (i = 0; i < h->entries_no; i++)
+		free(h->entries[i].ptest);
+	free(h->entries);
+	free(h->filename);
+	free(h);
+}
@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_HISTORY_H
+#define PTEST_RUNNER_HISTORY_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "ptest_list.h"
+
+#define PTEST_HISTORY_MAX_SAMPLES 20
+#define PTEST_HISTORY_MIN_SAMPLES 3
+
+struct ptest_history_sample {
+	time_t timestamp;
+	int status;
+	int timedout;
+	int64_t duration_ms;
+	int64_t cpu_ms;
+};
+
+/* Samples are kept oldest first, at most PTEST_HISTORY_MAX_SAMPLES. */
+struct ptest_history_entry {
+	char *ptest;
+	struct ptest_history_sample samples[PTEST_HISTORY_MAX_SAMPLES];
+	int samples_no;
+	int padding1;
+};
+
+struct ptest_history {
+	char *filename;
+	struct ptest_history_entry *entries;
+	int entries_no;
+	int entries_size;
+};
+
+extern struct ptest_history *ptest_history_load(const char *);
+extern struct ptest_history_entry *ptest_history_find(
+		const struct ptest_history *, const char *);
+extern int64_t ptest_history_percentile(const struct ptest_history_entry *, int);
+extern void ptest_history_update(struct ptest_history *, struct ptest_list *);
+extern int ptest_history_save(struct ptest_history *);
+extern void ptest_history_free(struct ptest_history *);
+
+#endif // PTEST_RUNNER_HISTORY_H
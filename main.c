@@ -22,6 +22,7 @@
  */
 
 #include <ctype.h>
+#include <getopt.h>
 #include <limits.h>
 #include <unistd.h>
 #include <string.h>
@@ -29,6 +30,8 @@
 #include <stdio.h>
 #include <errno.h>
 
+#include <sys/resource.h>
+
 #ifdef MEMCHECK
 #ifdef RELEASE
 #error "You can't use MEMCHECK when RELEASE is active."
@@ -37,18 +40,148 @@
 #include <mcheck.h>
 #endif
 
-#include "utils.h"
+#include "ptest_runner.h"
+#include "coordinator.h"
+#include "server.h"
+#include "probes.h"
 
 #ifndef DEFAULT_DIRECTORY
 #define DEFAULT_DIRECTORY "/usr/lib"
 #endif
 #define DEFAULT_TIMEOUT 300
+#define PTEST_MAX_REPORTERS 8
+#define LOWMEM_MIN_BUDGET 16
+#define ADAPTIVE_DEFAULT_FLOOR 30
+#define PTEST_MAX_CGROUP_LIMITS 8
+#define LOWMEM_STDIO_BUF_SIZE 1024
+
+/* stdout buffer in low memory mode, counted in the budget. */
+static char lowmem_stdout_buf[LOWMEM_STDIO_BUF_SIZE];
+
+enum {
+	OPT_CACHE = 256,
+	OPT_CACHE_ENV,
+	OPT_CACHE_MAX_AGE,
+	OPT_FAIL_FAST,
+	OPT_DAEMON,
+	OPT_DAEMON_JOBS,
+	OPT_EVENTS,
+	OPT_HEARTBEAT,
+	OPT_REPORT,
+	OPT_STATS,
+	OPT_MAX_MEMORY,
+	OPT_DEADLINE,
+	OPT_PTEST_CONFIG,
+	OPT_HISTORY,
+	OPT_ADAPTIVE_DEADLINE,
+	OPT_ADAPTIVE_FLOOR,
+	OPT_ADMISSION,
+	OPT_CGROUP,
+	OPT_CGROUP_LIMIT,
+	OPT_SANDBOX,
+	OPT_NETNS,
+	OPT_CAPTURE,
+	OPT_ARCHIVE,
+	OPT_SHOW_LOG,
+	OPT_OUTPUT_HEAD,
+	OPT_OUTPUT_TAIL,
+	OPT_OUTPUT_FAIL,
+	OPT_PROMETHEUS,
+	OPT_COMPARE,
+	OPT_COMPARE_SIGMA,
+	OPT_COMPARE_FAIL,
+	OPT_TIME_BUDGET,
+	OPT_COORDINATE,
+	OPT_WORKER,
+	OPT_PREFETCH,
+	OPT_FIXTURES,
+};
+
+static const struct option long_options[] = {
+	{"directory", required_argument, NULL, 'd'},
+	{"exclude", required_argument, NULL, 'e'},
+	{"list", no_argument, NULL, 'l'},
+	{"timeout", required_argument, NULL, 't'},
+	{"xml", required_argument, NULL, 'x'},
+	{"help", no_argument, NULL, 'h'},
+	{"cache", required_argument, NULL, OPT_CACHE},
+	{"cache-env", required_argument, NULL, OPT_CACHE_ENV},
+	{"cache-max-age", required_argument, NULL, OPT_CACHE_MAX_AGE},
+	{"fail-fast", optional_argument, NULL, OPT_FAIL_FAST},
+	{"daemon", required_argument, NULL, OPT_DAEMON},
+	{"daemon-jobs", required_argument, NULL, OPT_DAEMON_JOBS},
+	{"events", required_argument, NULL, OPT_EVENTS},
+	{"heartbeat", required_argument, NULL, OPT_HEARTBEAT},
+	{"report", required_argument, NULL, OPT_REPORT},
+	{"stats", no_argument, NULL, OPT_STATS},
+	{"max-memory", required_argument, NULL, OPT_MAX_MEMORY},
+	{"deadline", required_argument, NULL, OPT_DEADLINE},
+	{"ptest-config", required_argument, NULL, OPT_PTEST_CONFIG},
+	{"history", required_argument, NULL, OPT_HISTORY},
+	{"adaptive-deadline", required_argument, NULL, OPT_ADAPTIVE_DEADLINE},
+	{"adaptive-floor", required_argument, NULL, OPT_ADAPTIVE_FLOOR},
+	{"admission", required_argument, NULL, OPT_ADMISSION},
+	{"cgroup", required_argument, NULL, OPT_CGROUP},
+	{"cgroup-limit", required_argument, NULL, OPT_CGROUP_LIMIT},
+	{"sandbox", no_argument, NULL, OPT_SANDBOX},
+	{"netns", no_argument, NULL, OPT_NETNS},
+	{"capture", required_argument, NULL, OPT_CAPTURE},
+	{"archive", required_argument, NULL, OPT_ARCHIVE},
+	{"show-log", required_argument, NULL, OPT_SHOW_LOG},
+	{"output-head", required_argument, NULL, OPT_OUTPUT_HEAD},
+	{"output-tail", required_argument, NULL, OPT_OUTPUT_TAIL},
+	{"output-fail", no_argument, NULL, OPT_OUTPUT_FAIL},
+	{"prometheus", required_argument, NULL, OPT_PROMETHEUS},
+	{"compare", required_argument, NULL, OPT_COMPARE},
+	{"compare-sigma", required_argument, NULL, OPT_COMPARE_SIGMA},
+	{"compare-fail", no_argument, NULL, OPT_COMPARE_FAIL},
+	{"time-budget", required_argument, NULL, OPT_TIME_BUDGET},
+	{"coordinate", required_argument, NULL, OPT_COORDINATE},
+	{"worker", no_argument, NULL, OPT_WORKER},
+	{"prefetch", required_argument, NULL, OPT_PREFETCH},
+	{"fixtures", required_argument, NULL, OPT_FIXTURES},
+	{NULL, 0, NULL, 0},
+};
 
 static inline void
 print_usage(FILE *stream, char *progname)
 {
 	fprintf(stream, "Usage: %s [-d directory directory2 ...] [-e exclude] [-l list] [-t timeout]"
-			" [-x xml-filename] [-h] [ptest1 ptest2 ...]\n", progname);
+			" [-x xml-filename] [-h] [--cache file [--cache-env file ...]"
+			" [--cache-max-age seconds]] [--fail-fast[=failures]]"
+			" [--daemon socket [--daemon-jobs jobs]]"
+			" [--events file|fd [--heartbeat seconds]]"
+			" [--report junit|tap|subunit:file ...] [--stats]"
+			" [--max-memory KiB] [--deadline seconds] [--ptest-config file]"
+			" [--history file [--adaptive-deadline factor"
+			" [--adaptive-floor seconds]]]"
+			" [--admission cpu=pct,memory=pct,io=pct,mem_available=KiB,max_wait=seconds]"
+			" [--cgroup dir [--cgroup-limit key=value ...]] [--sandbox] [--netns]"
+			" [--capture file] [--archive file]"
+			" [--output-head bytes] [--output-tail bytes] [--output-fail]"
+			" [--prometheus file.prom]"
+			" [--compare history [--compare-sigma k] [--compare-fail]]"
+			" [--time-budget seconds]"
+			" [--coordinate command ...] [--worker] [--prefetch ptests]"
+			" [--fixtures dir]"
+			" [ptest1 ptest2 ...]\n", progname);
+	fprintf(stream, "       %s --show-log ptest archive\n", progname);
+}
+
+static void
+keep_ptests(struct ptest_list *head, char **ptests, int ptest_num)
+{
+	struct ptest_list *p, *next;
+	int i;
+
+	for (p = head->next; p != NULL; p = next) {
+		next = p->next;
+		for (i = 0; i < ptest_num; i++)
+			if (strcmp(p->ptest, ptests[i]) == 0)
+				break;
+		if (i == ptest_num)
+			ptest_list_remove(head, p->ptest, 1);
+	}
 }
 
 static char **
@@ -102,6 +235,19 @@ cleanup_ptest_opts(struct ptest_options *opts)
 		free(opts->xml_filename);
 		opts->xml_filename = NULL;
 	}
+
+	free(opts->cache_filename);
+	opts->cache_filename = NULL;
+
+	for (int i=0; i < opts->cache_env_no; i++)
+		free(opts->cache_env[i]);
+	free(opts->cache_env);
+	opts->cache_env = NULL;
+
+	ptest_config_free(opts->config);
+	opts->config = NULL;
+	ptest_history_free(opts->history);
+	opts->history = NULL;
 }
 
 int
@@ -111,13 +257,43 @@ main(int argc, char *argv[])
 	int ptest_num = 0;
 	int i;
 	int rc;
-	int ptest_exclude_num = 0;
 
 #ifdef MEMCHECK
 	mtrace();
 #endif
 
 	struct ptest_list *head, *run;
+	struct ptest_cache *cache = NULL;
+	char *daemon_socket = NULL;
+	int daemon_jobs = SERVER_DEFAULT_JOBS;
+	char *events_spec = NULL;
+	struct ptest_events *events = NULL;
+	char *capture_file = NULL;
+	struct ptest_capture *capture = NULL;
+	char *archive_file = NULL;
+	char *show_log = NULL;
+	struct ptest_archive *archive = NULL;
+	char *metrics_file = NULL;
+	struct ptest_metrics *metrics = NULL;
+	unsigned int prefetch_ahead = 0;
+	struct ptest_prefetch *prefetch = NULL;
+	char *compare_file = NULL;
+	double compare_sigma = COMPARE_DEFAULT_SIGMA;
+	int compare_fail = 0;
+	struct ptest_history *baseline = NULL;
+	struct ptest_reporter *reporters[PTEST_MAX_REPORTERS];
+	int reporters_no = 0;
+	struct ptest_stats stats;
+	struct ptest_pool *pool = NULL;
+	int max_memory = 0;
+	char *history_filename = NULL;
+	struct ptest_admission admission;
+	char *cgroup_limits[PTEST_MAX_CGROUP_LIMITS];
+	int cgroup_limits_no = 0;
+	char *coordinate_cmds[COORDINATOR_MAX_WORKERS];
+	int coordinate_no = 0;
+	int worker = 0;
+	int64_t stats_start;
 	__attribute__ ((__cleanup__(cleanup_ptest_opts))) struct ptest_options opts;
 
 	opts.dirs = malloc(sizeof(char **) * 1);
@@ -126,12 +302,39 @@ main(int argc, char *argv[])
 	CHECK_ALLOCATION(opts.dirs[0], 1, 1);
 	opts.dirs_no = 1;
 	opts.exclude = NULL;
+	opts.exclude_no = 0;
 	opts.list = 0;
 	opts.timeout = DEFAULT_TIMEOUT;
+	opts.fail_fast = 0;
+	opts.heartbeat = 0;
 	opts.ptests = NULL;
 	opts.xml_filename = NULL;
-
-	while ((opt = getopt(argc, argv, "d:e:lt:x:h")) != -1) {
+	opts.cache_filename = NULL;
+	opts.cache_env = NULL;
+	opts.cache_env_no = 0;
+	opts.cache_max_age = PTEST_CACHE_DEFAULT_MAX_AGE;
+	opts.callbacks = NULL;
+	opts.stats = NULL;
+	opts.config = NULL;
+	opts.history = NULL;
+	opts.admission = NULL;
+	opts.cgroup = NULL;
+	opts.sandbox = 0;
+	opts.netns = 0;
+	opts.separate_stderr = 0;
+	opts.output_head = 0;
+	opts.output_tail = 0;
+	opts.output_fail = 0;
+	opts.time_budget = 0;
+	opts.backend = NULL;
+	opts.fixtures = NULL;
+	ptest_admission_init(&admission);
+	opts.adaptive_factor = 0;
+	opts.deadline = 0;
+	opts.adaptive_floor = ADAPTIVE_DEFAULT_FLOOR;
+	memset(&stats, 0, sizeof(stats));
+
+	while ((opt = getopt_long(argc, argv, "d:e:lt:x:h", long_options, NULL)) != -1) {
 		switch (opt) {
 			case 'd':
 				free(opts.dirs[0]);
@@ -139,7 +342,7 @@ main(int argc, char *argv[])
 				opts.dirs = str2array(optarg, " ", &(opts.dirs_no)); 
 			break;
 			case 'e':
-				opts.exclude = str2array(optarg, " ", &ptest_exclude_num);
+				opts.exclude = str2array(optarg, " ", &(opts.exclude_no));
 			break;
 			case 'l':
 				opts.list = 1;
@@ -156,12 +359,223 @@ main(int argc, char *argv[])
 				opts.xml_filename = strdup(optarg);
 				CHECK_ALLOCATION(opts.xml_filename, 1, 1);
 			break;
+			case OPT_CACHE:
+				free(opts.cache_filename);
+				opts.cache_filename = strdup(optarg);
+				CHECK_ALLOCATION(opts.cache_filename, 1, 1);
+			break;
+			case OPT_CACHE_ENV:
+				opts.cache_env = realloc(opts.cache_env,
+						sizeof(char *) * (size_t) (opts.cache_env_no + 1));
+				CHECK_ALLOCATION(opts.cache_env, 1, 1);
+				opts.cache_env[opts.cache_env_no] = strdup(optarg);
+				CHECK_ALLOCATION(opts.cache_env[opts.cache_env_no], 1, 1);
+				opts.cache_env_no++;
+			break;
+			case OPT_CACHE_MAX_AGE:
+				opts.cache_max_age = atoi(optarg);
+			break;
+			case OPT_FAIL_FAST:
+				/* Only --fail-fast=N, a ptest named with digits is not N. */
+				opts.fail_fast = optarg ? atoi(optarg) : 1;
+				if (opts.fail_fast <= 0) {
+					print_usage(stdout, argv[0]);
+					exit(1);
+				}
+			break;
+			case OPT_DAEMON:
+				daemon_socket = optarg;
+			break;
+			case OPT_DAEMON_JOBS:
+				daemon_jobs = atoi(optarg);
+			break;
+			case OPT_EVENTS:
+				events_spec = optarg;
+			break;
+			case OPT_HEARTBEAT:
+				opts.heartbeat = (unsigned int) atoi(optarg);
+			break;
+			case OPT_MAX_MEMORY:
+				max_memory = atoi(optarg);
+				if (max_memory < LOWMEM_MIN_BUDGET) {
+					fprintf(stderr, "Memory budget must be at least %d KiB.\n",
+							LOWMEM_MIN_BUDGET);
+					exit(1);
+				}
+			break;
+			case OPT_DEADLINE:
+				opts.deadline = (unsigned int) atoi(optarg);
+			break;
+			case OPT_PTEST_CONFIG:
+				opts.config = ptest_config_load(optarg);
+				if (opts.config == NULL)
+					exit(1);
+			break;
+			case OPT_HISTORY:
+				history_filename = optarg;
+			break;
+			case OPT_ADAPTIVE_DEADLINE:
+				opts.adaptive_factor = atof(optarg);
+			break;
+			case OPT_ADAPTIVE_FLOOR:
+				opts.adaptive_floor = (unsigned int) atoi(optarg);
+			break;
+			case OPT_ADMISSION:
+				if (ptest_admission_parse(&admission, optarg) == -1)
+					exit(1);
+				opts.admission = &admission;
+			break;
+			case OPT_CGROUP:
+				opts.cgroup = optarg;
+			break;
+			case OPT_CGROUP_LIMIT:
+				if (cgroup_limits_no == PTEST_MAX_CGROUP_LIMITS) {
+					fprintf(stderr, "Too many cgroup limits, at most %d.\n",
+							PTEST_MAX_CGROUP_LIMITS);
+					exit(1);
+				}
+				cgroup_limits[cgroup_limits_no++] = optarg;
+			break;
+			case OPT_SANDBOX:
+				opts.sandbox = 1;
+			break;
+			case OPT_NETNS:
+				opts.netns = 1;
+			break;
+			case OPT_CAPTURE:
+				capture_file = optarg;
+				opts.separate_stderr = 1;
+			break;
+			case OPT_ARCHIVE:
+				archive_file = optarg;
+			break;
+			case OPT_SHOW_LOG:
+				show_log = optarg;
+			break;
+			case OPT_OUTPUT_HEAD:
+				opts.output_head = (unsigned int) atoi(optarg);
+			break;
+			case OPT_OUTPUT_TAIL:
+				opts.output_tail = (unsigned int) atoi(optarg);
+			break;
+			case OPT_OUTPUT_FAIL:
+				opts.output_fail = 1;
+			break;
+			case OPT_PROMETHEUS:
+				metrics_file = optarg;
+			break;
+			case OPT_COMPARE:
+				compare_file = optarg;
+			break;
+			case OPT_COMPARE_SIGMA:
+				compare_sigma = atof(optarg);
+			break;
+			case OPT_COMPARE_FAIL:
+				compare_fail = 1;
+			break;
+			case OPT_TIME_BUDGET:
+				opts.time_budget = (unsigned int) atoi(optarg);
+			break;
+			case OPT_COORDINATE:
+				if (coordinate_no == COORDINATOR_MAX_WORKERS) {
+					fprintf(stderr, "Too many workers, at most %d.\n",
+							COORDINATOR_MAX_WORKERS);
+					exit(1);
+				}
+				coordinate_cmds[coordinate_no++] = optarg;
+			break;
+			case OPT_WORKER:
+				worker = 1;
+			break;
+			case OPT_PREFETCH:
+				prefetch_ahead = (unsigned int) atoi(optarg);
+			break;
+			case OPT_FIXTURES:
+				opts.fixtures = optarg;
+			break;
+			case OPT_STATS:
+				opts.stats = &stats;
+			break;
+			case OPT_REPORT:
+				if (reporters_no == PTEST_MAX_REPORTERS) {
+					fprintf(stderr, "Too many reports, at most %d.\n",
+							PTEST_MAX_REPORTERS);
+					exit(1);
+				}
+				reporters[reporters_no] = ptest_reporter_open(optarg);
+				if (reporters[reporters_no] == NULL)
+					exit(1);
+				reporters[reporters_no]->callbacks.next = opts.callbacks;
+				opts.callbacks = &reporters[reporters_no]->callbacks;
+				reporters_no++;
+			break;
 			default:
 				print_usage(stdout, argv[0]);
 				exit(1);
 		}
 	}
 
+	if (show_log) {
+		if (argc - optind != 1) {
+			print_usage(stderr, argv[0]);
+			return 1;
+		}
+		return ptest_archive_show(argv[optind], show_log, stdout) == 0 ? 0 : 1;
+	}
+
+	/* Command line limits are defaults for every ptest, after the config. */
+	for (i = 0; i < cgroup_limits_no; i++) {
+		char *value = strchr(cgroup_limits[i], '=');
+		int j;
+
+		if (value != NULL) {
+			*value++ = '\0';
+			for (j = 0; ptest_cgroup_limits[j] != NULL; j++)
+				if (strcmp(cgroup_limits[i], ptest_cgroup_limits[j]) == 0)
+					break;
+		}
+		if (value == NULL || ptest_cgroup_limits[j] == NULL) {
+			fprintf(stderr, "Invalid cgroup limit '%s', expected memory.max,"
+					" pids.max, cpu.weight or io.weight.\n", cgroup_limits[i]);
+			return 1;
+		}
+		if (opts.config == NULL) {
+			opts.config = calloc(1, sizeof(struct ptest_config));
+			CHECK_ALLOCATION(opts.config, sizeof(struct ptest_config), 1);
+		}
+		if (ptest_config_add(opts.config, PTEST_CONFIG_ANY, cgroup_limits[i],
+		    value) == -1)
+			return 1;
+	}
+	if (opts.cgroup && ptest_cgroup_setup(opts.cgroup) == -1)
+		return 1;
+
+	if (opts.adaptive_factor > 0 && history_filename == NULL) {
+		fprintf(stderr, "--adaptive-deadline needs --history.\n");
+		return 1;
+	}
+	if (opts.time_budget > 0 && history_filename == NULL) {
+		fprintf(stderr, "--time-budget needs --history.\n");
+		return 1;
+	}
+	/* Workers send the log of a ptest at its end, not its output as read. */
+	if (capture_file && coordinate_no > 0) {
+		fprintf(stderr, "--capture can not be used with --coordinate.\n");
+		return 1;
+	}
+	/* A budget picks from a whole run, the daemon runs what it is asked. */
+	if (opts.time_budget > 0 && daemon_socket) {
+		fprintf(stderr, "--time-budget can not be used with --daemon.\n");
+		return 1;
+	}
+	if (history_filename) {
+		opts.history = ptest_history_load(history_filename);
+		CHECK_ALLOCATION(opts.history, sizeof(struct ptest_history), 1);
+	}
+
+	if (daemon_socket)
+		return ptest_server_run(&opts, daemon_socket, daemon_jobs, argv[0]);
+
 	ptest_num = argc - optind;
 	if (ptest_num > 0) {
 		size_t size = sizeof(char *) * (unsigned int) ptest_num;
@@ -174,22 +588,55 @@ main(int argc, char *argv[])
 		}
 	}
 
-	head = NULL;
-	for (i = 0; i < opts.dirs_no; i ++) {
-		struct ptest_list *tmp;
-
-		tmp = get_available_ptests(opts.dirs[i]);
-		if (tmp == NULL) {
-			fprintf(stderr, PRINT_PTESTS_NOT_FOUND_DIR, opts.dirs[i]);
-			continue;
+	/* The history of this run is only updated after the comparison. */
+	if (compare_file && history_filename &&
+	    strcmp(compare_file, history_filename) == 0) {
+		baseline = opts.history;
+	} else if (compare_file) {
+		if (access(compare_file, R_OK) == -1) {
+			fprintf(stderr, "Baseline file '%s' could not be opened. %s.\n",
+					compare_file, strerror(errno));
+			return 1;
 		}
+		baseline = ptest_history_load(compare_file);
+		CHECK_ALLOCATION(baseline, sizeof(struct ptest_history), 1);
+	}
 
+	/*
+	 * Worker mode, ptests come from a coordinator on stdin and results go
+	 * back on stdout, anything else printed there goes to stderr instead.
+	 */
+	if (worker) {
+		int out_fd = dup(1);
 
-		if (head == NULL)
-			head = tmp;
-		else
-			head = ptest_list_extend(head, tmp);
+		if (out_fd == -1 || dup2(2, 1) == -1) {
+			fprintf(stderr, "Unable to set up worker stdout. %s.\n",
+					strerror(errno));
+			return 1;
+		}
+		return ptest_worker_run(&opts, argv[0], 0, out_fd);
 	}
+
+	/*
+	 * Low memory mode, discovery goes into a pool sized from the budget
+	 * and stdout uses a static buffer, nothing else grows with the
+	 * number of ptests or their output.
+	 */
+	if (max_memory) {
+		pool = ptest_pool_create((size_t) max_memory * 1024 -
+				sizeof(lowmem_stdout_buf));
+		CHECK_ALLOCATION(pool, (size_t) max_memory * 1024, 1);
+		setvbuf(stdout, lowmem_stdout_buf, _IOFBF, sizeof(lowmem_stdout_buf));
+	}
+
+	stats_start = ptest_clock_us();
+	PTEST_PROBE1(discovery_start, opts.dirs_no);
+	head = get_available_ptests_dirs(opts.dirs, opts.dirs_no, pool, stderr);
+	stats.discovery_us = ptest_clock_us() - stats_start;
+	PTEST_PROBE1(discovery_end, ptest_list_length(head));
+	if (pool && pool->dropped)
+		fprintf(stderr, "Warning: memory budget of %d KiB reached, %d ptests"
+				" not loaded.\n", max_memory, pool->dropped);
 	if (head == NULL || ptest_list_length(head) == 0) {
 		fprintf(stderr, PRINT_PTESTS_NOT_FOUND);
 			return 1;
@@ -200,6 +647,7 @@ main(int argc, char *argv[])
 		return 0;
 	}
 
+	stats_start = ptest_clock_us();
 	run = head;
 	if (ptest_num > 0) {
 		for (i = 0; i < ptest_num; i++) {
@@ -210,20 +658,139 @@ main(int argc, char *argv[])
 			}
 		}
 
-		run = filter_ptests(head, opts.ptests, ptest_num);
-		CHECK_ALLOCATION(run, (size_t) ptest_num, 1);
-		ptest_list_free_all(head);
+		if (pool) {
+			/* No room for a copy, filter in place keeping discovery order. */
+			keep_ptests(head, opts.ptests, ptest_num);
+		} else {
+			run = filter_ptests(head, opts.ptests, ptest_num);
+			CHECK_ALLOCATION(run, (size_t) ptest_num, 1);
+			ptest_list_free_all(head);
+		}
 	}
 
-	for (i = 0; i < ptest_exclude_num; i++)
+	for (i = 0; i < opts.exclude_no; i++)
 		ptest_list_remove(run, opts.exclude[i], 1);
+	stats.filter_us = ptest_clock_us() - stats_start;
+
+	if (opts.cache_filename) {
+		uint64_t env_hash = ptest_cache_hash_env(opts.cache_env,
+				opts.cache_env_no);
 
-	rc = run_ptests(run, opts, argv[0], stdout, stderr);
+		cache = ptest_cache_load(opts.cache_filename, env_hash,
+				(time_t) opts.cache_max_age);
+		CHECK_ALLOCATION(cache, sizeof(struct ptest_cache), 1);
+		ptest_cache_mark(cache, run);
+	}
+
+	if (opts.time_budget > 0 &&
+	    ptest_budget_select(run, opts.history, opts.time_budget, stdout) == -1)
+		return 1;
+
+	/* After the budget, what it kept still runs in dependency order. */
+	if (ptest_depends_order(run, opts.config, stdout) == -1)
+		return 1;
+
+	if (events_spec) {
+		events = ptest_events_open(events_spec);
+		if (events == NULL)
+			return 1;
+		if (opts.heartbeat == 0)
+			opts.heartbeat = EVENTS_DEFAULT_HEARTBEAT;
+		events->callbacks.next = opts.callbacks;
+		opts.callbacks = &events->callbacks;
+	}
+
+	if (capture_file) {
+		capture = ptest_capture_open(capture_file);
+		if (capture == NULL)
+			return 1;
+		capture->callbacks.next = opts.callbacks;
+		opts.callbacks = &capture->callbacks;
+	}
+
+	if (archive_file) {
+		archive = ptest_archive_open(archive_file);
+		if (archive == NULL)
+			return 1;
+		archive->callbacks.next = opts.callbacks;
+		opts.callbacks = &archive->callbacks;
+	}
+
+	if (metrics_file) {
+		metrics = ptest_metrics_open(metrics_file);
+		CHECK_ALLOCATION(metrics, sizeof(struct ptest_metrics), 1);
+		/* Overhead so far is exported while the run goes on too. */
+		metrics->stats = opts.stats;
+		metrics->callbacks.next = opts.callbacks;
+		opts.callbacks = &metrics->callbacks;
+	}
+
+	if (prefetch_ahead > 0) {
+		prefetch = ptest_prefetch_open(prefetch_ahead);
+		CHECK_ALLOCATION(prefetch, sizeof(struct ptest_prefetch), 1);
+		prefetch->callbacks.next = opts.callbacks;
+		opts.callbacks = &prefetch->callbacks;
+	}
+
+	if (coordinate_no > 0)
+		rc = ptest_coordinator_run(run, &opts, coordinate_cmds,
+				coordinate_no, argv[0], stdout);
+	else
+		rc = run_ptests(run, &opts, argv[0], stdout, stderr);
 	fprintf(stdout, "TOTAL: %d FAIL: %d\n", ptest_list_length(run), rc);
+	if (opts.stats)
+		ptest_stats_print(stdout, opts.stats);
+	if (pool) {
+		struct rusage ru;
+
+		getrusage(RUSAGE_SELF, &ru);
+		fprintf(stdout, "MEMORY: budget %d KiB, pool %zu of %zu bytes,"
+				" maxrss %ld kB\n", max_memory, pool->used, pool->size,
+				ru.ru_maxrss);
+	}
+	if (baseline) {
+		struct ptest_regression *regressions;
+		int regressions_no;
+
+		regressions_no = ptest_compare(baseline, run, compare_sigma,
+				&regressions);
+		if (regressions_no >= 0) {
+			ptest_compare_print(stdout, regressions, regressions_no);
+			free(regressions);
+		}
+		if (compare_fail && regressions_no > 0)
+			rc = 1;
+		if (baseline != opts.history)
+			ptest_history_free(baseline);
+	}
 	if (rc > 0)
 		rc = 1;
 
+	ptest_events_close(events);
+	ptest_capture_close(capture);
+	ptest_metrics_close(metrics);
+	ptest_prefetch_close(prefetch);
+	if (ptest_archive_close(archive) == -1) {
+		fprintf(stderr, "Archive '%s' could not be written.\n", archive_file);
+		rc = 1;
+	}
+	PTEST_PROBE1(report_close, reporters_no);
+	for (i = 0; i < reporters_no; i++)
+		ptest_reporter_close(reporters[i]);
+
+	if (cache) {
+		ptest_cache_update(cache, run);
+		ptest_cache_save(cache);
+		ptest_cache_free(cache);
+	}
+
+	if (opts.history) {
+		ptest_history_update(opts.history, run);
+		ptest_history_save(opts.history);
+	}
+
 	ptest_list_free_all(run);
+	ptest_pool_destroy(pool);
 
 	return rc;
 }
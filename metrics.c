@@ -0,0 +1,322 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+#define METRICS_PREFIX "ptest_runner_"
+
+static void
+metrics_header(FILE *fp, const char *name, const char *type, const char *help)
+{
+	fprintf(fp, "# HELP " METRICS_PREFIX "%s %s\n", name, help);
+	fprintf(fp, "# TYPE " METRICS_PREFIX "%s %s\n", name, type);
+}
+
+static void
+metrics_label(FILE *fp, const char *name, const char *value)
+{
+	fprintf(fp, "{%s=\"", name);
+	for (; *value != '\0'; value++) {
+		if (*value == '\\' || *value == '"')
+			fputc('\\', fp);
+		if (*value == '\n')
+			fputs("\\n", fp);
+		else
+			fputc(*value, fp);
+	}
+	fputs("\"}", fp);
+}
+
+/* One gauge per ptest, value picked by field from each entry. */
+enum {
+	METRIC_DURATION,
+	METRIC_PASSED,
+	METRIC_EXIT_CODE,
+	METRIC_SIGNAL,
+	METRIC_TIMEOUT,
+	METRIC_CPU_USER,
+	METRIC_CPU_SYSTEM,
+	METRIC_MAXRSS,
+	METRIC_MEMORY_PEAK,
+	METRIC_OOM_KILLED,
+};
+
+static const struct {
+	const char *name;
+	const char *help;
+} ptest_metrics_info[] = {
+	{"ptest_duration_seconds", "Wall clock duration of the ptest."},
+	{"ptest_passed", "1 when the ptest passed, 0 when it failed."},
+	{"ptest_exit_code", "Exit code of run-ptest, -1 when it did not exit."},
+	{"ptest_signal", "Signal that terminated run-ptest, 0 for none."},
+	{"ptest_timeout", "1 when the ptest hit its timeout or deadline."},
+	{"ptest_cpu_user_seconds", "User CPU time of the ptest and its children."},
+	{"ptest_cpu_system_seconds", "System CPU time of the ptest and its children."},
+	{"ptest_maxrss_bytes", "Largest resident set size of the ptest processes."},
+	{"ptest_memory_peak_bytes", "Peak memory of the ptest cgroup, 0 without --cgroup."},
+	{"ptest_oom_killed", "Number of OOM kills in the ptest cgroup."},
+};
+
+static void
+metrics_ptest_value(FILE *fp, int metric, const struct ptest_list *p)
+{
+	switch (metric) {
+		case METRIC_DURATION:
+			fprintf(fp, " %.3f\n", (double) p->duration_ms / 1000);
+			break;
+		case METRIC_PASSED:
+			fprintf(fp, " %d\n", p->status == PTEST_STATUS_PASS);
+			break;
+		case METRIC_EXIT_CODE:
+			fprintf(fp, " %d\n", p->exit_code);
+			break;
+		case METRIC_SIGNAL:
+			fprintf(fp, " %d\n", p->signal);
+			break;
+		case METRIC_TIMEOUT:
+			fprintf(fp, " %d\n", p->timedout != 0);
+			break;
+		case METRIC_CPU_USER:
+			fprintf(fp, " %.3f\n", (double) p->utime_ms / 1000);
+			break;
+		case METRIC_CPU_SYSTEM:
+			fprintf(fp, " %.3f\n", (double) p->stime_ms / 1000);
+			break;
+		case METRIC_MAXRSS:
+			fprintf(fp, " %ld\n", p->maxrss_kb * 1024);
+			break;
+		case METRIC_MEMORY_PEAK:
+			fprintf(fp, " %ld\n", p->memory_peak_kb * 1024);
+			break;
+		default:
+			fprintf(fp, " %d\n", p->oom_killed);
+			break;
+	}
+}
+
+static void
+metrics_gauge(FILE *fp, const char *name, const char *help, double value)
+{
+	metrics_header(fp, name, "gauge", help);
+	fprintf(fp, METRICS_PREFIX "%s %.17g\n", name, value);
+}
+
+static void
+metrics_write_stats(FILE *fp, const struct ptest_stats *st)
+{
+	static const char *phases[] = {"discovery", "filter", "spawn", "relay",
+			"report", "admission"};
+	int64_t us[] = {st->discovery_us, st->filter_us, st->spawn_us,
+			st->relay_us, st->report_us, st->admission_us};
+	size_t i;
+
+	metrics_header(fp, "overhead_seconds", "gauge",
+			"Time the runner itself spent per phase.");
+	for (i = 0; i < sizeof(us) / sizeof(us[0]); i++) {
+		fputs(METRICS_PREFIX "overhead_seconds", fp);
+		metrics_label(fp, "phase", phases[i]);
+		fprintf(fp, " %.6f\n", (double) us[i] / 1000000);
+	}
+
+	metrics_header(fp, "relayed_bytes", "gauge",
+			"Bytes of ptest output relayed per stream.");
+	fputs(METRICS_PREFIX "relayed_bytes", fp);
+	metrics_label(fp, "stream", "stdout");
+	fprintf(fp, " %" PRIu64 "\n", st->bytes[0]);
+	fputs(METRICS_PREFIX "relayed_bytes", fp);
+	metrics_label(fp, "stream", "stderr");
+	fprintf(fp, " %" PRIu64 "\n", st->bytes[1]);
+
+	metrics_header(fp, "syscalls", "gauge",
+			"read(2), write and poll(2) calls made relaying output.");
+	fputs(METRICS_PREFIX "syscalls", fp);
+	metrics_label(fp, "call", "read");
+	fprintf(fp, " %" PRIu64 "\n", st->reads);
+	fputs(METRICS_PREFIX "syscalls", fp);
+	metrics_label(fp, "call", "write");
+	fprintf(fp, " %" PRIu64 "\n", st->writes);
+	fputs(METRICS_PREFIX "syscalls", fp);
+	metrics_label(fp, "call", "poll");
+	fprintf(fp, " %" PRIu64 "\n", st->polls);
+
+	metrics_gauge(fp, "maxrss_bytes", "Largest resident set size of the runner.",
+			(double) st->maxrss_kb * 1024);
+}
+
+int
+ptest_metrics_write(struct ptest_metrics *m)
+{
+	size_t i;
+	FILE *fp;
+	int j;
+
+	m->written_ms = ptest_backend_clock_ms(m->backend);
+	fp = fopen(m->tmp, "we");
+	if (fp == NULL) {
+		fprintf(stderr, "Metrics file '%s' could not be created. %s.\n",
+				m->tmp, strerror(errno));
+		return -1;
+	}
+
+	for (i = 0; m->ptests_no > 0 &&
+	    i < sizeof(ptest_metrics_info) / sizeof(ptest_metrics_info[0]); i++) {
+		metrics_header(fp, ptest_metrics_info[i].name, "gauge",
+				ptest_metrics_info[i].help);
+		for (j = 0; j < m->ptests_no; j++) {
+			fprintf(fp, METRICS_PREFIX "%s", ptest_metrics_info[i].name);
+			metrics_label(fp, "ptest", m->ptests[j]->ptest);
+			metrics_ptest_value(fp, (int) i, m->ptests[j]);
+		}
+	}
+
+	metrics_gauge(fp, "running", "1 while the run is in progress.", m->running);
+	metrics_gauge(fp, "ptests", "Ptests selected for the run.", m->total);
+	metrics_gauge(fp, "ptests_completed", "Ptests run so far.", m->ptests_no);
+	metrics_gauge(fp, "ptests_failed", "Ptests failed so far.", m->failed);
+	metrics_gauge(fp, "ptests_skipped", "Ptests skipped, cached or after --fail-fast.",
+			m->skipped);
+	metrics_gauge(fp, "progress_ratio", "Ptests run or skipped out of the selected ones.",
+			m->total > 0 ? (double) (m->ptests_no + m->skipped) / m->total : 0);
+	metrics_gauge(fp, "run_start_timestamp_seconds", "Unix time the run started.",
+			(double) m->start);
+	metrics_gauge(fp, "run_duration_seconds", "Time since the run started.",
+			(double) (ptest_backend_clock_ms(m->backend) - m->start_ms) / 1000);
+	if (m->stats)
+		metrics_write_stats(fp, m->stats);
+
+	if (fclose(fp) != 0 || rename(m->tmp, m->filename) == -1) {
+		fprintf(stderr, "Metrics file '%s' could not be written. %s.\n",
+				m->filename, strerror(errno));
+		unlink(m->tmp);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+metrics_run_start(void *data, int ptests)
+{
+	struct ptest_metrics *m = data;
+
+	m->total = ptests;
+	m->running = 1;
+	m->start = (time_t) (ptest_backend_wall_ms(m->backend) / 1000);
+	m->start_ms = ptest_backend_clock_ms(m->backend);
+	ptest_metrics_write(m);
+}
+
+static void
+metrics_end(void *data, const struct ptest_list *p)
+{
+	struct ptest_metrics *m = data;
+	const struct ptest_list **ptests;
+
+	ptests = realloc(m->ptests, (size_t) (m->ptests_no + 1) * sizeof(*ptests));
+	CHECK_ALLOCATION(ptests, (size_t) (m->ptests_no + 1) * sizeof(*ptests), 0);
+	if (ptests == NULL)
+		return;
+	m->ptests = ptests;
+	m->ptests[m->ptests_no++] = p;
+	if (p->status == PTEST_STATUS_FAIL)
+		m->failed++;
+	/* Every ptest adds to the file, rewriting it each time is quadratic. */
+	if (ptest_backend_clock_ms(m->backend) - m->written_ms >=
+	    METRICS_WRITE_INTERVAL_MS)
+		ptest_metrics_write(m);
+}
+
+static void
+metrics_skipped(void *data, const struct ptest_list *p, const char *reason)
+{
+	struct ptest_metrics *m = data;
+
+	m->skipped++;
+}
+
+static void
+metrics_stats(void *data, const struct ptest_stats *st)
+{
+	struct ptest_metrics *m = data;
+
+	m->stats = st;
+}
+
+static void
+metrics_run_end(void *data, int ptests, int failures)
+{
+	struct ptest_metrics *m = data;
+
+	m->running = 0;
+	ptest_metrics_write(m);
+}
+
+struct ptest_metrics *
+ptest_metrics_open(const char *filename)
+{
+	struct ptest_metrics *m;
+
+	m = calloc(1, sizeof(struct ptest_metrics));
+	CHECK_ALLOCATION(m, sizeof(struct ptest_metrics), 0);
+	if (m == NULL)
+		return NULL;
+
+	m->filename = strdup(filename);
+	if (m->filename == NULL || asprintf(&m->tmp, "%s.tmp", filename) == -1) {
+		free(m->filename);
+		free(m);
+		return NULL;
+	}
+
+	m->callbacks.run_start = metrics_run_start;
+	m->callbacks.end = metrics_end;
+	m->callbacks.skipped = metrics_skipped;
+	m->callbacks.stats = metrics_stats;
+	m->callbacks.run_end = metrics_run_end;
+	m->callbacks.data = m;
+
+	return m;
+}
+
+void
+ptest_metrics_close(struct ptest_metrics *m)
+{
+	if (m == NULL)
+		return;
+
+	free(m->ptests);
+	free(m->tmp);
+	free(m->filename);
+	free(m);
+}
@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_METRICS_H
+#define PTEST_RUNNER_METRICS_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "utils.h"
+
+#define METRICS_WRITE_INTERVAL_MS 5000
+
+/*
+ * Prometheus text exposition of the run for the node_exporter textfile
+ * collector. The file is rewritten through a temporary and rename(2)
+ * at the start and end of the run and after a ptest when the last write
+ * is METRICS_WRITE_INTERVAL_MS old, so the collector never reads half
+ * of it and long runs do not rewrite it for every ptest. Per ptest series are labelled ptest="name", the
+ * runner overhead is only there when stats are collected (--stats).
+ * Finished ptests are referenced, not copied, the list has to outlive
+ * the run. Times come from backend, the system clocks when NULL.
+ */
+struct ptest_metrics {
+	char *filename;
+	const struct ptest_backend *backend;
+	char *tmp;
+	const struct ptest_list **ptests;
+	int ptests_no;
+	int total;
+	int skipped;
+	int failed;
+	int running;
+	int padding1;
+	time_t start;
+	int64_t start_ms;
+	int64_t written_ms;
+	const struct ptest_stats *stats;
+
+	struct ptest_callbacks callbacks;
+};
+
+extern struct ptest_metrics *ptest_metrics_open(const char *);
+extern int ptest_metrics_write(struct ptest_metrics *);
+extern void ptest_metrics_close(struct ptest_metrics *);
+
+#endif // PTEST_RUNNER_METRICS_H
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+#include "utils.h"
+
+struct ptest_pool *
+ptest_pool_create(size_t size)
+{
+	struct ptest_pool *pool;
+
+	pool = calloc(1, sizeof(struct ptest_pool));
+	CHECK_ALLOCATION(pool, sizeof(struct ptest_pool), 0);
+	if (pool == NULL)
+		return NULL;
+
+	/* Pages are only touched, and counted in RSS, as the pool fills. */
+	pool->base = malloc(size);
+	CHECK_ALLOCATION(pool->base, size, 0);
+	if (pool->base == NULL) {
+		free(pool);
+		return NULL;
+	}
+	pool->size = size;
+
+	return pool;
+}
+
+void *
+ptest_pool_alloc(struct ptest_pool *pool, size_t size)
+{
+	size_t start = (pool->used + PTEST_POOL_ALIGN - 1) & ~(PTEST_POOL_ALIGN - 1);
+
+	if (start > pool->size || size > pool->size - start) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	pool->used = start + size;
+
+	return pool->base + start;
+}
+
+char *
+ptest_pool_strdup(struct ptest_pool *pool, const char *s)
+{
+	size_t len = strlen(s) + 1;
+	char *d = ptest_pool_alloc(pool, len);
+
+	if (d != NULL)
+		memcpy(d, s, len);
+
+	return d;
+}
+
+int
+ptest_pool_owns(const struct ptest_pool *pool, const void *p)
+{
+	const char *c = p;
+
+	return pool != NULL && c >= pool->base && c < pool->base + pool->size;
+}
+
+void
+ptest_pool_destroy(struct ptest_pool *pool)
+{
+	if (pool == NULL)
+		return;
+
+	free(pool->base);
+	free(pool);
+}
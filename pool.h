@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_POOL_H
+#define PTEST_RUNNER_POOL_H
+
+#include <stddef.h>
+
+#define PTEST_POOL_ALIGN (sizeof(void *) * 2)
+
+/*
+ * Fixed size arena for low memory mode, allocated once and never grown.
+ * Allocations are never freed individually, only with the whole pool.
+ */
+struct ptest_pool {
+	char *base;
+	size_t size;
+	size_t used;
+	int dropped;
+	int padding1;
+};
+
+extern struct ptest_pool *ptest_pool_create(size_t);
+extern void *ptest_pool_alloc(struct ptest_pool *, size_t);
+extern char *ptest_pool_strdup(struct ptest_pool *, const char *);
+extern int ptest_pool_owns(const struct ptest_pool *, const void *);
+extern void ptest_pool_destroy(struct ptest_pool *);
+
+#endif // PTEST_RUNNER_POOL_H
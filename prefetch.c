@@ -0,0 +1,247 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "admission.h"
+#include "prefetch.h"
+#include "utils.h"
+
+/* From linux/ioprio.h, not exported through the libc headers. */
+#define PREFETCH_IOPRIO_WHO_PROCESS 1
+#define PREFETCH_IOPRIO_CLASS_IDLE 3
+#define PREFETCH_IOPRIO_CLASS_SHIFT 13
+
+struct prefetch_walk {
+	const char *proc;
+	size_t left;
+	int64_t bytes;
+	unsigned int files;
+	int cancelled;
+};
+
+static int
+memory_short(const char *proc, size_t need)
+{
+	struct ptest_pressure pr;
+
+	ptest_pressure_read(proc, &pr);
+	if (pr.memory > PREFETCH_MAX_MEMORY_PRESSURE)
+		return 1;
+	/* Unknown MemAvailable is -1, don't hold prefetching back on it. */
+	return pr.mem_available_kb >= 0 &&
+		(size_t) pr.mem_available_kb < need / 1024 * 2;
+}
+
+static void
+prefetch_walk(struct prefetch_walk *w, int dir_fd, int depth)
+{
+	struct dirent *d;
+	DIR *dir;
+
+	dir = fdopendir(dir_fd);
+	if (dir == NULL) {
+		close(dir_fd);
+		return;
+	}
+
+	while (w->left > 0 && !w->cancelled && (d = readdir(dir)) != NULL) {
+		struct stat st;
+		int fd;
+
+		if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+			continue;
+
+		if (w->files++ % PREFETCH_CHECK_FILES == 0 &&
+		    memory_short(w->proc, 0)) {
+			w->cancelled = 1;
+			break;
+		}
+
+		fd = openat(dirfd(dir), d->d_name,
+				O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_NONBLOCK);
+		if (fd == -1)
+			continue;
+		if (fstat(fd, &st) == -1) {
+			close(fd);
+			continue;
+		}
+
+		if (S_ISDIR(st.st_mode)) {
+			if (depth < PREFETCH_MAX_DEPTH)
+				prefetch_walk(w, fd, depth + 1);
+			else
+				close(fd);
+			continue;
+		}
+
+		if (S_ISREG(st.st_mode) && st.st_size > 0) {
+			size_t len = (size_t) st.st_size < w->left ?
+				(size_t) st.st_size : w->left;
+
+			if (posix_fadvise(fd, 0, (off_t) len, POSIX_FADV_WILLNEED) == 0) {
+				w->left -= len;
+				w->bytes += len;
+			}
+		}
+		close(fd);
+	}
+
+	closedir(dir);
+}
+
+/*
+ * Asks for the files under dir, at most max_bytes of them, returns the
+ * bytes asked for or -1 when memory pressure cut the walk short.
+ */
+int64_t
+ptest_prefetch_dir(const char *dir, size_t max_bytes, const char *proc)
+{
+	struct prefetch_walk w;
+	int fd;
+
+	memset(&w, 0, sizeof(w));
+	w.proc = proc;
+	w.left = max_bytes;
+
+	fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd == -1)
+		return 0;
+	prefetch_walk(&w, fd, 0);
+
+	return w.cancelled ? -1 : w.bytes;
+}
+
+static void
+prefetch_reap(struct ptest_prefetch *pf, int block)
+{
+	if (pf->pid <= 0)
+		return;
+
+	if (block)
+		kill(pf->pid, SIGKILL);
+	if (waitpid(pf->pid, NULL, block ? 0 : WNOHANG) != 0)
+		pf->pid = 0;
+}
+
+static void
+prefetch_start(void *data, const struct ptest_list *p, pid_t pid)
+{
+	struct ptest_prefetch *pf = data;
+	const struct ptest_list *q;
+	unsigned int i, skip = 0;
+
+	/* One batch at a time, the previous one is still being read. */
+	prefetch_reap(pf, 0);
+	if (pf->pid > 0)
+		return;
+
+	/* Directories up to the last one handed out are warm already. */
+	for (q = p->next, i = 0; q != NULL && i < pf->ahead; q = q->next, i++)
+		if (q == pf->last)
+			skip = i + 1;
+	if (skip >= i || memory_short(pf->proc, pf->max_bytes))
+		return;
+
+	pf->pid = fork();
+	if (pf->pid == -1) {
+		pf->pid = 0;
+		return;
+	} else if (pf->pid == 0) {
+		char dir[PATH_MAX];
+
+		setpriority(PRIO_PROCESS, 0, 19);
+		syscall(SYS_ioprio_set, PREFETCH_IOPRIO_WHO_PROCESS, 0,
+				PREFETCH_IOPRIO_CLASS_IDLE << PREFETCH_IOPRIO_CLASS_SHIFT);
+
+		for (q = p->next, i = 0; q != NULL && i < pf->ahead; q = q->next, i++) {
+			if (i < skip || q->status == PTEST_STATUS_CACHED ||
+			    q->status == PTEST_STATUS_BUDGET)
+				continue;
+
+			strcpy(dir, q->run_ptest);
+			dirname(dir);
+			if (ptest_prefetch_dir(dir, pf->max_bytes, pf->proc) == -1)
+				break;
+		}
+		_exit(0);
+	}
+
+	for (q = p->next, i = 0; q != NULL && i < pf->ahead; q = q->next, i++)
+		pf->last = q;
+}
+
+static void
+prefetch_run_end(void *data, int ptests, int failures)
+{
+	struct ptest_prefetch *pf = data;
+
+	prefetch_reap(pf, 1);
+	pf->last = NULL;
+}
+
+struct ptest_prefetch *
+ptest_prefetch_open(unsigned int ahead)
+{
+	struct ptest_prefetch *pf;
+
+	pf = calloc(1, sizeof(struct ptest_prefetch));
+	CHECK_ALLOCATION(pf, sizeof(struct ptest_prefetch), 0);
+	if (pf == NULL)
+		return NULL;
+
+	pf->ahead = ahead;
+	pf->max_bytes = PREFETCH_DEFAULT_MAX_BYTES;
+	pf->proc = PREFETCH_DEFAULT_PROC;
+
+	pf->callbacks.start = prefetch_start;
+	pf->callbacks.run_end = prefetch_run_end;
+	pf->callbacks.data = pf;
+
+	return pf;
+}
+
+void
+ptest_prefetch_close(struct ptest_prefetch *pf)
+{
+	if (pf == NULL)
+		return;
+
+	prefetch_reap(pf, 1);
+	free(pf);
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_PREFETCH_H
+#define PTEST_RUNNER_PREFETCH_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "ptest_list.h"
+#include "utils.h"
+
+#define PREFETCH_DEFAULT_PROC "/proc"
+#define PREFETCH_DEFAULT_MAX_BYTES (64 * 1024 * 1024)
+/* Memory "some" avg10 percentage above which prefetching stops. */
+#define PREFETCH_MAX_MEMORY_PRESSURE 10.0
+#define PREFETCH_CHECK_FILES 64
+#define PREFETCH_MAX_DEPTH 16
+
+/*
+ * Read-ahead of the directories of the next ptests in the list while
+ * one runs. When a ptest starts a helper process at idle CPU and I/O
+ * priority walks the directories of up to ahead following ptests not
+ * prefetched yet and asks for their files with POSIX_FADV_WILLNEED, at
+ * most max_bytes per directory. A new batch waits for the previous
+ * helper to finish, and none is started while memory is short, the
+ * helper itself stops as soon as it sees memory pressure.
+ */
+struct ptest_prefetch {
+	unsigned int ahead;
+	int padding1;
+	size_t max_bytes;
+	const char *proc;
+	pid_t pid;
+	int padding2;
+	const struct ptest_list *last;
+
+	struct ptest_callbacks callbacks;
+};
+
+extern struct ptest_prefetch *ptest_prefetch_open(unsigned int);
+extern int64_t ptest_prefetch_dir(const char *, size_t, const char *);
+extern void ptest_prefetch_close(struct ptest_prefetch *);
+
+#endif // PTEST_RUNNER_PREFETCH_H
@@ -0,0 +1,61 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_PROBES_H
+#define PTEST_RUNNER_PROBES_H
+
+/*
+ * USDT probes of provider ptest_runner, built in with `make USDT=1` which
+ * needs sys/sdt.h (systemtap-sdt-dev). Each one is a single nop until a
+ * tracer attaches, e.g.
+ *
+ *   bpftrace -e 'usdt:./ptest-runner:ptest_runner:read
+ *       { @[str(arg0)] = sum(arg3); }'
+ *
+ * Probes and arguments, names are strings:
+ *
+ *   discovery_start (dirs)           discovery_end (ptests)
+ *   discovery_entry (name, stat rc)
+ *   fork (name, pid)                 exec (run-ptest path, pid)
+ *   first_output (name, pid, ms)     read (name, pid, stream, bytes)
+ *   timeout (name, pid, kind)        kill (name, pid)
+ *   reap (name, pid, wait status)
+ *   report_start (name, pid)         report_end (name, pid)
+ *   report_close (reporters)
+ */
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define PTEST_PROBE1(name, a) DTRACE_PROBE1(ptest_runner, name, a)
+#define PTEST_PROBE2(name, a, b) DTRACE_PROBE2(ptest_runner, name, a, b)
+#define PTEST_PROBE3(name, a, b, c) DTRACE_PROBE3(ptest_runner, name, a, b, c)
+#define PTEST_PROBE4(name, a, b, c, d) \
+	DTRACE_PROBE4(ptest_runner, name, a, b, c, d)
+#else
+#define PTEST_PROBE1(name, a) do { } while (0)
+#define PTEST_PROBE2(name, a, b) do { } while (0)
+#define PTEST_PROBE3(name, a, b, c) do { } while (0)
+#define PTEST_PROBE4(name, a, b, c, d) do { } while (0)
+#endif
+
+#endif // PTEST_RUNNER_PROBES_H
@@ -27,6 +27,7 @@
 #include <errno.h>
 
 #include "utils.h"
+#include "pool.h"
 #include "ptest_list.h"
 
 #define VALIDATE_PTR_RINT(ptr) \
@@ -45,14 +46,62 @@
 		} \
 	} while (0)
 
+char *
+ptest_list_strdup(struct ptest_pool *pool, const char *s)
+{
+	char *d;
+
+	if (pool)
+		return ptest_pool_strdup(pool, s);
+
+	d = strdup(s);
+	CHECK_ALLOCATION(d, strlen(s) + 1, 0);
+
+	return d;
+}
+
+static void
+ptest_list_free_mem(struct ptest_pool *pool, void *p)
+{
+	if (!ptest_pool_owns(pool, p))
+		free(p);
+}
+
 struct ptest_list *
 ptest_list_alloc()
 {
-	struct ptest_list *p = malloc(sizeof(struct ptest_list));
-	CHECK_ALLOCATION(p, sizeof(struct ptest_list), 0);
+	return ptest_list_alloc_pool(NULL);
+}
+
+struct ptest_list *
+ptest_list_alloc_pool(struct ptest_pool *pool)
+{
+	struct ptest_list *p;
+
+	if (pool) {
+		p = ptest_pool_alloc(pool, sizeof(struct ptest_list));
+	} else {
+		p = malloc(sizeof(struct ptest_list));
+		CHECK_ALLOCATION(p, sizeof(struct ptest_list), 0);
+	}
 	if (p != NULL) {
 		p->ptest = NULL;
 		p->run_ptest = NULL;
+		p->pool = pool;
+
+		p->status = PTEST_STATUS_NOTRUN;
+		p->exit_code = 0;
+		p->signal = 0;
+		p->timedout = 0;
+		p->oom_killed = 0;
+		p->slot = 0;
+		p->duration_ms = 0;
+		p->utime_ms = 0;
+		p->stime_ms = 0;
+		p->maxrss_kb = 0;
+		p->memory_peak_kb = 0;
+		p->meta_hash = 0;
+		p->content_hash = 0;
 
 		p->next = NULL;
 		p->prev = NULL;
@@ -64,9 +113,11 @@ ptest_list_alloc()
 void
 ptest_list_free(struct ptest_list *p)
 {
-	free(p->ptest);
-	free(p->run_ptest);
-	free(p);
+	struct ptest_pool *pool = p->pool;
+
+	ptest_list_free_mem(pool, p->ptest);
+	ptest_list_free_mem(pool, p->run_ptest);
+	ptest_list_free_mem(pool, p);
 }
 
 int
@@ -173,7 +224,7 @@ ptest_list_add(struct ptest_list *head, char *ptest, char *run_ptest)
 	VALIDATE_PTR_RNULL(head);
 	VALIDATE_PTR_RNULL(ptest);
 
-	n = ptest_list_alloc();
+	n = ptest_list_alloc_pool(head->pool);
 	if (n == NULL)
 		return NULL;
 
@@ -231,8 +282,10 @@ ptest_list_extend(struct ptest_list *head, struct ptest_list *extend)
 	for (p = head; p->next != NULL; p = p->next);
 	q = extend->next;
 	p->next = q;
+	if (q != NULL)
+		q->prev = p;
 
-	free(extend);
+	ptest_list_free(extend);
 
 	return head;
 }
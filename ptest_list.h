@@ -45,17 +45,61 @@
 #define PTEST_LIST_ITERATE_START(head, p) for (p = head->next; p != NULL; p = p->next) {
 #define PTEST_LIST_ITERATE_END }
 
+#include <stdint.h>
 #include <sys/stat.h>
 
+enum ptest_status {
+	PTEST_STATUS_NOTRUN = 0,
+	PTEST_STATUS_PASS,
+	PTEST_STATUS_FAIL,
+	PTEST_STATUS_CACHED,
+	/* Left out or stopped by the time budget, reported as skipped. */
+	PTEST_STATUS_BUDGET,
+};
+
+/* Why a ptest was killed, stored in timedout. */
+enum ptest_timeout {
+	PTEST_TIMEOUT_NONE = 0,
+	PTEST_TIMEOUT_INACTIVITY,
+	PTEST_TIMEOUT_DEADLINE,
+};
+
+struct ptest_pool;
+
+/* Concurrent runners of one run, a ptest's slot is the one it ran on. */
+#define PTEST_MAX_SLOTS 64
+
+/*
+ * Nodes of a list made with ptest_list_alloc_pool() and the strings
+ * from ptest_list_strdup() come from pool, nodes added to it too.
+ */
 struct ptest_list {
 	char *ptest;
 	char *run_ptest;
+	struct ptest_pool *pool;
+
+	int status;
+	int exit_code;
+	int signal;
+	int timedout;
+	int oom_killed;
+	int slot;
+	int64_t duration_ms;
+	int64_t utime_ms;
+	int64_t stime_ms;
+	long maxrss_kb;
+	long memory_peak_kb;
+	uint64_t meta_hash;
+	uint64_t content_hash;
 
 	struct ptest_list *next;
 	struct ptest_list *prev;
 };
 
+extern char *ptest_list_strdup(struct ptest_pool *, const char *);
+
 extern struct ptest_list *ptest_list_alloc(void);
+extern struct ptest_list *ptest_list_alloc_pool(struct ptest_pool *);
 extern void ptest_list_free(struct ptest_list *);
 extern int ptest_list_free_all(struct ptest_list *);
 
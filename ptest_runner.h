@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_H
+#define PTEST_RUNNER_H
+
+/*
+ * Public interface of libptestrunner.
+ *
+ * A run plan is a struct ptest_list, built with get_available_ptests_dirs(),
+ * into a struct ptest_pool when memory is bounded, or
+ * get_available_ptests() and narrowed with filter_ptests() and
+ * ptest_list_remove(). It is executed with run_ptests(), which reports
+ * progress through the struct ptest_callbacks chained in the options and
+ * leaves every ptest's result in its list entry. The library keeps no
+ * global state and never exits the calling process.
+ *
+ * PTEST_RUNNER_API_VERSION changes whenever struct ptest_options, struct
+ * ptest_callbacks, struct ptest_backend or an exported signature changes,
+ * since callers build these structs themselves.
+ *
+ * 2: ptest_options grew the callback chain, stats, config, history,
+ *    scheduling, isolation, output and backend fields;
+ *    get_available_ptests_dirs() takes the pool and the backend gained
+ *    clock_us, wall_ms and the wait options.
+ */
+
+#define PTEST_RUNNER_API_VERSION 2
+
+#include "ptest_list.h"
+#include "utils.h"
+#include "cache.h"
+#include "events.h"
+#include "capture.h"
+#include "archive.h"
+#include "metrics.h"
+#include "pool.h"
+#include "config.h"
+#include "history.h"
+#include "compare.h"
+#include "budget.h"
+#include "prefetch.h"
+#include "fixture.h"
+#include "admission.h"
+#include "cgroup.h"
+#include "sandbox.h"
+#include "report.h"
+
+#endif // PTEST_RUNNER_H
@@ -0,0 +1,398 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ptest_list.h"
+#include "report.h"
+#include "utils.h"
+
+#define SUBUNIT_SIGNATURE 0xb3
+#define SUBUNIT_VERSION 0x2000
+#define SUBUNIT_FLAG_TEST_ID 0x0800
+#define SUBUNIT_FLAG_TIMESTAMP 0x0200
+#define SUBUNIT_FLAG_MIME_TYPE 0x0020
+#define SUBUNIT_FLAG_FILE_CONTENT 0x0040
+#define SUBUNIT_MIME_TYPE "text/plain;charset=utf8"
+
+enum {
+	SUBUNIT_STATUS_NONE = 0,
+	SUBUNIT_STATUS_INPROGRESS = 2,
+	SUBUNIT_STATUS_SUCCESS = 3,
+	SUBUNIT_STATUS_SKIP = 5,
+	SUBUNIT_STATUS_FAIL = 6,
+};
+
+static const char *
+ptest_dir(const struct ptest_list *p, char *buf)
+{
+	strncpy(buf, p->run_ptest, PATH_MAX - 1);
+	buf[PATH_MAX - 1] = '\0';
+
+	return dirname(buf);
+}
+
+static void
+junit_run_start(void *data, int ptests)
+{
+	struct ptest_reporter *r = data;
+
+	xml_start(r->fp, ptests);
+	r->started = 1;
+}
+
+static void
+junit_end(void *data, const struct ptest_list *p)
+{
+	struct ptest_reporter *r = data;
+	char buf[PATH_MAX];
+
+	xml_add_result(r->fp, p, ptest_dir(p, buf));
+}
+
+static void
+junit_skipped(void *data, const struct ptest_list *p, const char *reason)
+{
+	struct ptest_reporter *r = data;
+	char buf[PATH_MAX];
+
+	xml_add_skipped(r->fp, ptest_dir(p, buf), reason);
+}
+
+static void
+tap_run_start(void *data, int ptests)
+{
+	struct ptest_reporter *r = data;
+
+	fprintf(r->fp, "TAP version 13\n1..%d\n", ptests);
+	fflush(r->fp);
+	r->started = 1;
+}
+
+static void
+tap_end(void *data, const struct ptest_list *p)
+{
+	struct ptest_reporter *r = data;
+
+	r->count++;
+	if (p->status == PTEST_STATUS_PASS) {
+		fprintf(r->fp, "ok %d - %s\n", r->count, p->ptest);
+	} else {
+		fprintf(r->fp, "not ok %d - %s\n", r->count, p->ptest);
+		if (p->timedout == PTEST_TIMEOUT_DEADLINE)
+			fprintf(r->fp, "# deadline exceeded\n");
+		else if (p->timedout)
+			fprintf(r->fp, "# timeout\n");
+		if (p->oom_killed)
+			fprintf(r->fp, "# oom killed\n");
+		if (p->signal)
+			fprintf(r->fp, "# exited from signal %d\n", p->signal);
+		else
+			fprintf(r->fp, "# exit status %d\n", p->exit_code);
+	}
+	fprintf(r->fp, "# duration_ms %jd\n", (intmax_t) p->duration_ms);
+	fflush(r->fp);
+}
+
+static void
+tap_skipped(void *data, const struct ptest_list *p, const char *reason)
+{
+	struct ptest_reporter *r = data;
+
+	r->count++;
+	fprintf(r->fp, "ok %d - %s # SKIP %s\n", r->count, p->ptest, reason);
+	fflush(r->fp);
+}
+
+/* Variable length number from the Subunit v2 specification. */
+static size_t
+subunit_number(unsigned char *buf, uint32_t n)
+{
+	if (n < 0x40) {
+		buf[0] = (unsigned char) n;
+		return 1;
+	} else if (n < 0x4000) {
+		buf[0] = (unsigned char) (0x40 | (n >> 8));
+		buf[1] = (unsigned char) n;
+		return 2;
+	} else if (n < 0x400000) {
+		buf[0] = (unsigned char) (0x80 | (n >> 16));
+		buf[1] = (unsigned char) (n >> 8);
+		buf[2] = (unsigned char) n;
+		return 3;
+	}
+
+	buf[0] = (unsigned char) (0xc0 | (n >> 24));
+	buf[1] = (unsigned char) (n >> 16);
+	buf[2] = (unsigned char) (n >> 8);
+	buf[3] = (unsigned char) n;
+	return 4;
+}
+
+static size_t
+subunit_number_size(size_t n)
+{
+	return n < 0x40 ? 1 : n < 0x4000 ? 2 : n < 0x400000 ? 3 : 4;
+}
+
+static size_t
+subunit_string(unsigned char *buf, const char *s, size_t len)
+{
+	size_t n = subunit_number(buf, (uint32_t) len);
+
+	memcpy(buf + n, s, len);
+
+	return n + len;
+}
+
+static uint32_t
+crc32(const unsigned char *buf, size_t len)
+{
+	uint32_t crc = 0xffffffff;
+	int i;
+
+	while (len--) {
+		crc ^= *buf++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+	}
+
+	return ~crc;
+}
+
+/*
+ * Encode one packet into buf, returns its length. When it doesn't fit in
+ * size nothing is written, like snprintf() the needed length is returned.
+ */
+size_t
+subunit_packet(unsigned char *buf, size_t size, int status, uint32_t sec,
+		uint32_t nsec, const char *test_id, const char *file_name,
+		const char *content, size_t content_len)
+{
+	size_t len, len_size, n;
+	uint16_t flags = (uint16_t) (SUBUNIT_VERSION | SUBUNIT_FLAG_TIMESTAMP | status);
+	uint32_t crc;
+
+	/* Length of everything but the length field itself. */
+	len = 1 + 2 + 4 + 4;
+	len += subunit_number_size(nsec);
+	if (test_id) {
+		flags |= SUBUNIT_FLAG_TEST_ID;
+		len += subunit_number_size(strlen(test_id)) + strlen(test_id);
+	}
+	if (file_name) {
+		flags |= SUBUNIT_FLAG_MIME_TYPE | SUBUNIT_FLAG_FILE_CONTENT;
+		len += subunit_number_size(sizeof(SUBUNIT_MIME_TYPE) - 1) +
+			sizeof(SUBUNIT_MIME_TYPE) - 1;
+		len += subunit_number_size(strlen(file_name)) + strlen(file_name);
+		len += subunit_number_size(content_len) + content_len;
+	}
+
+	for (len_size = 1; len_size < 4; len_size++)
+		if (len + len_size < ((size_t) 1 << (6 + 8 * (len_size - 1))))
+			break;
+	len += len_size;
+
+	if (len > size)
+		return len;
+
+	n = 0;
+	buf[n++] = SUBUNIT_SIGNATURE;
+	buf[n++] = (unsigned char) (flags >> 8);
+	buf[n++] = (unsigned char) flags;
+	n += subunit_number(buf + n, (uint32_t) len);
+
+	buf[n++] = (unsigned char) (sec >> 24);
+	buf[n++] = (unsigned char) (sec >> 16);
+	buf[n++] = (unsigned char) (sec >> 8);
+	buf[n++] = (unsigned char) sec;
+	n += subunit_number(buf + n, nsec);
+	if (test_id)
+		n += subunit_string(buf + n, test_id, strlen(test_id));
+	if (file_name) {
+		n += subunit_string(buf + n, SUBUNIT_MIME_TYPE,
+				sizeof(SUBUNIT_MIME_TYPE) - 1);
+		n += subunit_string(buf + n, file_name, strlen(file_name));
+		n += subunit_string(buf + n, content, content_len);
+	}
+
+	crc = crc32(buf, n);
+	buf[n++] = (unsigned char) (crc >> 24);
+	buf[n++] = (unsigned char) (crc >> 16);
+	buf[n++] = (unsigned char) (crc >> 8);
+	buf[n++] = (unsigned char) crc;
+
+	return n;
+}
+
+static void
+subunit_write(struct ptest_reporter *r, int status, const char *test_id,
+		const char *file_name, const char *content, size_t content_len)
+{
+	struct timespec ts;
+	unsigned char *buf;
+	size_t len;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	len = subunit_packet(NULL, 0, status, (uint32_t) ts.tv_sec,
+			(uint32_t) ts.tv_nsec, test_id, file_name, content,
+			content_len);
+	buf = malloc(len);
+	CHECK_ALLOCATION(buf, len, 0);
+	if (buf == NULL)
+		return;
+
+	subunit_packet(buf, len, status, (uint32_t) ts.tv_sec,
+			(uint32_t) ts.tv_nsec, test_id, file_name, content,
+			content_len);
+	fwrite(buf, len, 1, r->fp);
+	fflush(r->fp);
+	free(buf);
+}
+
+static void
+subunit_start(void *data, const struct ptest_list *p, pid_t pid)
+{
+	subunit_write(data, SUBUNIT_STATUS_INPROGRESS, p->ptest, NULL, NULL, 0);
+}
+
+static void
+subunit_output(void *data, const struct ptest_list *p, int stream,
+		const char *buf, size_t len)
+{
+	subunit_write(data, SUBUNIT_STATUS_NONE, p->ptest,
+			stream ? "stderr" : "stdout", buf, len);
+}
+
+static void
+subunit_end(void *data, const struct ptest_list *p)
+{
+	subunit_write(data, p->status == PTEST_STATUS_PASS ?
+			SUBUNIT_STATUS_SUCCESS : SUBUNIT_STATUS_FAIL,
+			p->ptest, NULL, NULL, 0);
+}
+
+static void
+subunit_skipped(void *data, const struct ptest_list *p, const char *reason)
+{
+	subunit_write(data, SUBUNIT_STATUS_SKIP, p->ptest, "reason", reason,
+			strlen(reason));
+}
+
+struct ptest_reporter *
+ptest_reporter_open_format(int format, const char *filename)
+{
+	struct ptest_reporter *r;
+
+	r = calloc(1, sizeof(struct ptest_reporter));
+	CHECK_ALLOCATION(r, sizeof(struct ptest_reporter), 0);
+	if (r == NULL)
+		return NULL;
+
+	r->format = format;
+	r->fp = fopen(filename, "we");
+	if (r->fp == NULL) {
+		fprintf(stderr, "%s File '%s' could not be created. %s.\n",
+				format == PTEST_REPORT_JUNIT ? "XML" : "Report",
+				filename, strerror(errno));
+		free(r);
+		return NULL;
+	}
+
+	switch (format) {
+		case PTEST_REPORT_JUNIT:
+			r->callbacks.run_start = junit_run_start;
+			r->callbacks.end = junit_end;
+			r->callbacks.skipped = junit_skipped;
+		break;
+		case PTEST_REPORT_TAP:
+			r->callbacks.run_start = tap_run_start;
+			r->callbacks.end = tap_end;
+			r->callbacks.skipped = tap_skipped;
+		break;
+		case PTEST_REPORT_SUBUNIT:
+			r->callbacks.start = subunit_start;
+			r->callbacks.output = subunit_output;
+			r->callbacks.end = subunit_end;
+			r->callbacks.skipped = subunit_skipped;
+		break;
+	}
+	r->callbacks.data = r;
+
+	return r;
+}
+
+/* spec is format:filename, format one of junit, tap or subunit. */
+struct ptest_reporter *
+ptest_reporter_open(const char *spec)
+{
+	static const char *formats[] = {
+		[PTEST_REPORT_JUNIT] = "junit",
+		[PTEST_REPORT_TAP] = "tap",
+		[PTEST_REPORT_SUBUNIT] = "subunit",
+	};
+	const char *filename = strchr(spec, ':');
+	int i;
+
+	if (filename != NULL) {
+		for (i = 0; i < (int) (sizeof(formats) / sizeof(formats[0])); i++) {
+			if (strncmp(spec, formats[i], (size_t) (filename - spec)) == 0 &&
+			    formats[i][filename - spec] == '\0')
+				return ptest_reporter_open_format(i, filename + 1);
+		}
+	}
+
+	fprintf(stderr, "Invalid report '%s', expected junit:, tap: or subunit:"
+			" followed by a filename.\n", spec);
+	errno = EINVAL;
+
+	return NULL;
+}
+
+void
+ptest_reporter_close(struct ptest_reporter *r)
+{
+	if (r == NULL)
+		return;
+
+	if (r->format == PTEST_REPORT_JUNIT) {
+		if (!r->started)
+			xml_start(r->fp, 0);
+		xml_finish(r->fp);
+	} else {
+		if (r->format == PTEST_REPORT_TAP && !r->started)
+			fprintf(r->fp, "1..0\n");
+		fclose(r->fp);
+	}
+
+	free(r);
+}
@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_REPORT_H
+#define PTEST_RUNNER_REPORT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "utils.h"
+
+enum ptest_report_format {
+	PTEST_REPORT_JUNIT = 0,
+	PTEST_REPORT_TAP,
+	PTEST_REPORT_SUBUNIT,
+};
+
+/*
+ * Report writers fed from the run_ptests() callbacks, every result is
+ * flushed as soon as it is known so an interrupted run still leaves a
+ * usable report. Several reporters can be chained in one run.
+ */
+struct ptest_reporter {
+	int format;
+	int started;
+	int count;
+	int padding1;
+	FILE *fp;
+
+	struct ptest_callbacks callbacks;
+};
+
+extern struct ptest_reporter *ptest_reporter_open(const char *);
+extern struct ptest_reporter *ptest_reporter_open_format(int, const char *);
+extern void ptest_reporter_close(struct ptest_reporter *);
+
+extern size_t subunit_packet(unsigned char *, size_t, int, uint32_t, uint32_t,
+		const char *, const char *, const char *, size_t);
+
+#endif // PTEST_RUNNER_REPORT_H
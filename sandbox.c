@@ -0,0 +1,141 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "sandbox.h"
+
+#define SANDBOX_LOWER SANDBOX_TMP "/.ptest-sandbox/lower"
+#define SANDBOX_UPPER SANDBOX_TMP "/.ptest-sandbox/upper"
+#define SANDBOX_WORK SANDBOX_TMP "/.ptest-sandbox/work"
+#define SANDBOX_MERGED SANDBOX_TMP "/.ptest-sandbox/merged"
+
+#define SANDBOX_FAIL(fp, what, arg) \
+	do { \
+		fprintf(fp, "ERROR: Unable to sandbox, %s %s failed, %s\n", \
+				what, arg, strerror(errno)); \
+		return -1; \
+	} while (0)
+
+int
+ptest_sandbox_enter(const char *ptest_dir, FILE *fp)
+{
+	char dir[PATH_MAX];
+	int fd;
+
+	if (unshare(CLONE_NEWNS) == -1)
+		SANDBOX_FAIL(fp, "unshare", "");
+
+	/* Nothing mounted from here on may propagate back to the host. */
+	if (mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) == -1)
+		SANDBOX_FAIL(fp, "mount", "/");
+
+	/*
+	 * The ptest directory is reached through a descriptor from here
+	 * on, the tmpfs mounted on /tmp hides trees living under it.
+	 */
+	fd = open(ptest_dir, O_PATH | O_DIRECTORY | O_CLOEXEC);
+	if (fd == -1)
+		SANDBOX_FAIL(fp, "open", ptest_dir);
+	snprintf(dir, sizeof(dir), "/proc/self/fd/%d", fd);
+
+	/* Scratch tmpfs holding the overlay upper and work directories. */
+	if (mount("ptest-sandbox", SANDBOX_TMP, "tmpfs", MS_NOSUID | MS_NODEV,
+	    "mode=0700") == -1)
+		SANDBOX_FAIL(fp, "mount tmpfs", SANDBOX_TMP);
+	if (mkdir(SANDBOX_TMP "/.ptest-sandbox", 0700) == -1 ||
+	    mkdir(SANDBOX_LOWER, 0755) == -1 ||
+	    mkdir(SANDBOX_UPPER, 0755) == -1 || mkdir(SANDBOX_WORK, 0755) == -1 ||
+	    mkdir(SANDBOX_MERGED, 0755) == -1)
+		SANDBOX_FAIL(fp, "mkdir", SANDBOX_TMP "/.ptest-sandbox");
+	if (mount(dir, SANDBOX_LOWER, NULL, MS_BIND, NULL) == -1)
+		SANDBOX_FAIL(fp, "bind mount", ptest_dir);
+
+	if (mount("ptest-sandbox", SANDBOX_MERGED, "overlay", 0, "lowerdir="
+	    SANDBOX_LOWER ",upperdir=" SANDBOX_UPPER ",workdir=" SANDBOX_WORK) == -1)
+		SANDBOX_FAIL(fp, "mount overlay", ptest_dir);
+
+	/*
+	 * Absolute paths into the ptest directory see the overlay too, the
+	 * working directory is taken from the mount itself because a
+	 * descriptor walk does not cross mounts stacked on it.
+	 */
+	if (mount(SANDBOX_MERGED, dir, NULL, MS_BIND, NULL) == -1)
+		SANDBOX_FAIL(fp, "bind mount", ptest_dir);
+	close(fd);
+	if (chdir(SANDBOX_MERGED) == -1)
+		SANDBOX_FAIL(fp, "chdir", SANDBOX_MERGED);
+
+	/*
+	 * Hide the scratch tmpfs under the ptest's own empty /tmp, the
+	 * overlay keeps its upper layer referenced.
+	 */
+	if (mount("ptest-tmp", SANDBOX_TMP, "tmpfs", MS_NOSUID | MS_NODEV,
+	    "mode=1777") == -1)
+		SANDBOX_FAIL(fp, "mount tmpfs", SANDBOX_TMP);
+
+	return 0;
+}
+
+int
+ptest_netns_enter(FILE *fp)
+{
+	struct ifreq ifr;
+	int fd;
+
+	if (unshare(CLONE_NEWNET) == -1)
+		SANDBOX_FAIL(fp, "unshare", "network");
+
+	/* A new namespace only has loopback and it starts down. */
+	fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (fd == -1)
+		SANDBOX_FAIL(fp, "socket", "lo");
+	memset(&ifr, 0, sizeof(ifr));
+	strcpy(ifr.ifr_name, "lo");
+	if (ioctl(fd, SIOCGIFFLAGS, &ifr) == -1) {
+		close(fd);
+		SANDBOX_FAIL(fp, "get flags", "lo");
+	}
+	ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+	if (ioctl(fd, SIOCSIFFLAGS, &ifr) == -1) {
+		close(fd);
+		SANDBOX_FAIL(fp, "set flags", "lo");
+	}
+	close(fd);
+
+	return 0;
+}
@@ -0,0 +1,48 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_SANDBOX_H
+#define PTEST_RUNNER_SANDBOX_H
+
+#include <stdio.h>
+
+#define SANDBOX_TMP "/tmp"
+#define SANDBOX_RUN_PTEST "./run-ptest"
+
+/*
+ * Called in the forked child instead of chdir(), gives it a private mount
+ * namespace where the ptest directory is an overlayfs with its upper
+ * layer on tmpfs and /tmp is an empty tmpfs, and leaves it in the
+ * overlay. Everything written goes away with the namespace when the
+ * ptest exits. Needs CAP_SYS_ADMIN and overlayfs.
+ */
+extern int ptest_sandbox_enter(const char *, FILE *);
+
+/*
+ * Moves the forked child into a network namespace of its own with only
+ * the loopback interface up, fixed ports and sockets left in TIME_WAIT
+ * can't collide with other ptests or earlier runs. Needs CAP_SYS_ADMIN.
+ */
+extern int ptest_netns_enter(FILE *);
+
+#endif // PTEST_RUNNER_SANDBOX_H
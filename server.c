@@ -0,0 +1,1013 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "ptest_list.h"
+#include "server.h"
+#include "utils.h"
+
+#define SERVER_MAX_CLIENTS 64
+#define SERVER_LINE_MAX 4096
+#define SERVER_BACKLOG 16
+/* Output queued for a client that does not read, then it is dropped. */
+#define SERVER_OUTPUT_MAX (4 * 1024 * 1024)
+#define SERVER_WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | \
+		IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+struct server_client {
+	int fd;
+	unsigned int id;
+	int dropped;
+	int padding1;
+	size_t len;
+	char *out;
+	size_t out_len;
+	char buf[SERVER_LINE_MAX];
+};
+
+/*
+ * A running job writes its events to a pipe, the server forwards them
+ * to the client a line at a time so jobs never interleave inside one.
+ */
+struct server_job {
+	int id;
+	int fd;
+	pid_t pid;
+	unsigned int client;
+	char **ptests;
+	int ptests_no;
+	int padding1;
+	char *buf;
+	size_t len;
+	size_t size;
+
+	struct server_job *next;
+};
+
+struct server {
+	const struct ptest_options *opts;
+	const char *progname;
+
+	int listen_fd;
+	int signal_fd;
+	int inotify_fd;
+	int *dir_wds;
+
+	struct ptest_list *index;
+	int index_stale;
+
+	struct server_client clients[SERVER_MAX_CLIENTS];
+	int clients_no;
+	unsigned int next_client_id;
+
+	struct server_job *queue;
+	struct server_job *running;
+	int running_no;
+	int jobs;
+	int next_job_id;
+
+	int done;
+};
+
+/* The ptest a job worker is running, killed with it. */
+static volatile pid_t server_ptest_pid;
+
+static void
+write_all(int fd, const char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		buf += n;
+		len -= (size_t) n;
+	}
+}
+
+/*
+ * Never blocks the event loop, what the socket does not take is queued
+ * and sent when the client is writable again.
+ */
+static void
+server_send(struct server_client *c, const char *buf, size_t len)
+{
+	char *out;
+
+	if (c->dropped)
+		return;
+
+	while (c->out_len == 0 && len > 0) {
+		ssize_t n = send(c->fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				c->dropped = 1;
+			break;
+		}
+		buf += n;
+		len -= (size_t) n;
+	}
+	if (c->dropped || len == 0)
+		return;
+
+	if (c->out_len + len > SERVER_OUTPUT_MAX) {
+		fprintf(stderr, "Warning: dropping a client that does not read.\n");
+		c->dropped = 1;
+		return;
+	}
+	out = realloc(c->out, c->out_len + len);
+	CHECK_ALLOCATION(out, c->out_len + len, 0);
+	if (out == NULL) {
+		c->dropped = 1;
+		return;
+	}
+	memcpy(out + c->out_len, buf, len);
+	c->out = out;
+	c->out_len += len;
+}
+
+static void
+server_client_write(struct server_client *c)
+{
+	size_t sent = 0;
+
+	while (sent < c->out_len) {
+		ssize_t n = send(c->fd, c->out + sent, c->out_len - sent,
+				MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				c->dropped = 1;
+			break;
+		}
+		sent += (size_t) n;
+	}
+
+	c->out_len -= sent;
+	memmove(c->out, c->out + sent, c->out_len);
+	if (c->out_len == 0) {
+		free(c->out);
+		c->out = NULL;
+	}
+}
+
+/* Events are built in memory and sent whole. */
+static FILE *
+event_begin(char **buf, size_t *size, const char *event)
+{
+	FILE *fp = open_memstream(buf, size);
+	CHECK_ALLOCATION(fp, 1, 0);
+	if (fp != NULL)
+		fprintf(fp, "{\"event\":\"%s\"", event);
+
+	return fp;
+}
+
+static void
+event_str(FILE *fp, const char *key, const char *value, size_t len)
+{
+	fprintf(fp, ",\"%s\":", key);
+	json_print_string(fp, value, len);
+}
+
+static void
+event_end(FILE *fp, char **buf, size_t *size, struct server_client *c)
+{
+	fputs("}\n", fp);
+	fclose(fp);
+	server_send(c, *buf, *size);
+	free(*buf);
+}
+
+/* The job worker side, events go to the pipe read by the server. */
+static void
+job_event_end(FILE *fp, char **buf, size_t *size, int fd)
+{
+	fputs("}\n", fp);
+	fclose(fp);
+	write_all(fd, *buf, *size);
+	free(*buf);
+}
+
+static void
+send_error(struct server_client *c, const char *message)
+{
+	char *buf;
+	size_t size;
+	FILE *fp;
+
+	if ((fp = event_begin(&buf, &size, "error")) == NULL)
+		return;
+	event_str(fp, "message", message, strlen(message));
+	event_end(fp, &buf, &size, c);
+}
+
+static struct server_client *
+server_client_find(struct server *srv, unsigned int id)
+{
+	int i;
+
+	for (i = 0; i < srv->clients_no; i++)
+		if (srv->clients[i].id == id)
+			return &srv->clients[i];
+
+	return NULL;
+}
+
+static void
+server_scan(struct server *srv)
+{
+	const struct ptest_options *opts = srv->opts;
+	struct ptest_list *p;
+	int i;
+
+	if (srv->index != NULL)
+		PTEST_LIST_FREE_ALL_CLEAN(srv->index);
+
+	srv->index = get_available_ptests_dirs(opts->dirs, opts->dirs_no, NULL,
+			stderr);
+	if (srv->index == NULL) {
+		srv->index = ptest_list_alloc();
+		CHECK_ALLOCATION(srv->index, sizeof(struct ptest_list), 1);
+	}
+
+	for (i = 0; i < opts->exclude_no; i++)
+		ptest_list_remove(srv->index, opts->exclude[i], 1);
+
+	/*
+	 * A run-ptest that comes or goes inside a known package changes the
+	 * index too, watching an already watched dir is a no-op.
+	 */
+	if (srv->inotify_fd >= 0) {
+		PTEST_LIST_ITERATE_START(srv->index, p)
+			char dir[PATH_MAX];
+
+			strcpy(dir, p->run_ptest);
+			inotify_add_watch(srv->inotify_fd, dirname(dir),
+					SERVER_WATCH_MASK | IN_ATTRIB);
+		PTEST_LIST_ITERATE_END
+	}
+
+	srv->index_stale = 0;
+}
+
+static void
+server_watch(struct server *srv)
+{
+	int i;
+
+	srv->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (srv->inotify_fd == -1) {
+		fprintf(stderr, "Warning: inotify not available, %s.\n",
+				strerror(errno));
+		return;
+	}
+
+	srv->dir_wds = calloc((size_t) srv->opts->dirs_no + 1, sizeof(int));
+	CHECK_ALLOCATION(srv->dir_wds, (size_t) srv->opts->dirs_no + 1, 1);
+	for (i = 0; i < srv->opts->dirs_no; i++) {
+		srv->dir_wds[i] = inotify_add_watch(srv->inotify_fd,
+				srv->opts->dirs[i], SERVER_WATCH_MASK);
+		if (srv->dir_wds[i] == -1)
+			fprintf(stderr, "Warning: unable to watch %s, %s.\n",
+					srv->opts->dirs[i], strerror(errno));
+	}
+}
+
+/* Inside a ptest dir only run-ptest matters, ptests write there. */
+static void
+server_inotify(struct server *srv)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t n;
+
+	while ((n = read(srv->inotify_fd, buf, sizeof(buf))) > 0) {
+		char *ptr;
+
+		for (ptr = buf; ptr < buf + n;
+		     ptr += sizeof(struct inotify_event) + ((struct inotify_event *) ptr)->len) {
+			const struct inotify_event *ev = (const struct inotify_event *) ptr;
+			int i;
+
+			if (ev->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF) ||
+			    (ev->len > 0 && strcmp(ev->name, "run-ptest") == 0))
+				srv->index_stale = 1;
+			for (i = 0; i < srv->opts->dirs_no; i++)
+				if (ev->wd == srv->dir_wds[i])
+					srv->index_stale = 1;
+		}
+	}
+}
+
+static struct ptest_list *
+server_index(struct server *srv)
+{
+	/* Without inotify every request pays for a rescan. */
+	if (srv->index_stale || srv->inotify_fd == -1)
+		server_scan(srv);
+
+	return srv->index;
+}
+
+static void
+server_job_free(struct server_job *job)
+{
+	int i;
+
+	for (i = 0; i < job->ptests_no; i++)
+		free(job->ptests[i]);
+	free(job->ptests);
+	free(job->buf);
+	if (job->fd >= 0)
+		close(job->fd);
+	free(job);
+}
+
+/*
+ * Forwards the complete event lines the worker wrote so far, returns 1
+ * when something was read, 0 when the pipe is empty and -1 at its end.
+ */
+static int
+server_job_read(struct server *srv, struct server_job *job)
+{
+	struct server_client *c;
+	char *nl;
+	ssize_t n;
+
+	if (job->size - job->len < SERVER_LINE_MAX) {
+		char *buf = realloc(job->buf, job->size + SERVER_LINE_MAX);
+		CHECK_ALLOCATION(buf, job->size + SERVER_LINE_MAX, 0);
+		if (buf == NULL)
+			return -1;
+		job->buf = buf;
+		job->size += SERVER_LINE_MAX;
+	}
+
+	n = read(job->fd, job->buf + job->len, job->size - job->len);
+	if (n < 0)
+		return errno == EAGAIN || errno == EINTR ? 0 : -1;
+	if (n == 0)
+		return -1;
+	job->len += (size_t) n;
+
+	nl = memrchr(job->buf, '\n', job->len);
+	if (nl != NULL) {
+		size_t used = (size_t) (nl - job->buf) + 1;
+
+		c = server_client_find(srv, job->client);
+		if (c != NULL)
+			server_send(c, job->buf, used);
+		job->len -= used;
+		memmove(job->buf, job->buf + used, job->len);
+	}
+
+	return 1;
+}
+
+static void
+server_list(struct server *srv, struct server_client *c)
+{
+	struct ptest_list *p, *index = server_index(srv);
+	char *buf;
+	size_t size;
+	FILE *fp;
+
+	PTEST_LIST_ITERATE_START(index, p)
+		if ((fp = event_begin(&buf, &size, "ptest")) == NULL)
+			return;
+		event_str(fp, "name", p->ptest, strlen(p->ptest));
+		event_str(fp, "path", p->run_ptest, strlen(p->run_ptest));
+		event_end(fp, &buf, &size, c);
+	PTEST_LIST_ITERATE_END
+
+	if ((fp = event_begin(&buf, &size, "done")) == NULL)
+		return;
+	fprintf(fp, ",\"ptests\":%d", ptest_list_length(index));
+	event_end(fp, &buf, &size, c);
+}
+
+static void
+server_status(struct server *srv, struct server_client *c)
+{
+	struct server_job *job;
+	int queued = 0;
+	char *buf;
+	size_t size;
+	FILE *fp;
+
+	for (job = srv->queue; job != NULL; job = job->next)
+		queued++;
+
+	if ((fp = event_begin(&buf, &size, "status")) == NULL)
+		return;
+	fprintf(fp, ",\"ptests\":%d,\"queued\":%d,\"running\":%d,"
+			"\"jobs\":%d,\"clients\":%d",
+			ptest_list_length(server_index(srv)), queued,
+			srv->running_no, srv->jobs, srv->clients_no);
+	event_end(fp, &buf, &size, c);
+}
+
+static void
+server_enqueue(struct server *srv, struct server_client *c, char *args)
+{
+	struct ptest_list *p, *index = server_index(srv);
+	struct server_job *job, **tail;
+	char *tok, *save;
+	int position = 1;
+	char *buf;
+	size_t size;
+	FILE *fp;
+
+	job = calloc(1, sizeof(struct server_job));
+	CHECK_ALLOCATION(job, sizeof(struct server_job), 0);
+	if (job == NULL) {
+		send_error(c, "out of memory");
+		return;
+	}
+	job->fd = -1;
+
+	for (tok = strtok_r(args, " \t", &save); tok != NULL;
+	     tok = strtok_r(NULL, " \t", &save)) {
+		if (ptest_list_search(index, tok) == NULL) {
+			char *msg;
+			if (asprintf(&msg, "%s ptest isn't available.", tok) != -1) {
+				send_error(c, msg);
+				free(msg);
+			}
+			server_job_free(job);
+			return;
+		}
+
+		job->ptests = realloc(job->ptests,
+				sizeof(char *) * (size_t) (job->ptests_no + 1));
+		CHECK_ALLOCATION(job->ptests, 1, 1);
+		job->ptests[job->ptests_no] = strdup(tok);
+		CHECK_ALLOCATION(job->ptests[job->ptests_no], 1, 1);
+		job->ptests_no++;
+	}
+
+	/* No names given, run everything in the index. */
+	if (job->ptests_no == 0) {
+		PTEST_LIST_ITERATE_START(index, p)
+			job->ptests = realloc(job->ptests,
+					sizeof(char *) * (size_t) (job->ptests_no + 1));
+			CHECK_ALLOCATION(job->ptests, 1, 1);
+			job->ptests[job->ptests_no] = strdup(p->ptest);
+			CHECK_ALLOCATION(job->ptests[job->ptests_no], 1, 1);
+			job->ptests_no++;
+		PTEST_LIST_ITERATE_END
+	}
+
+	job->client = c->id;
+	job->id = ++srv->next_job_id;
+
+	for (tail = &srv->queue; *tail != NULL; tail = &(*tail)->next)
+		position++;
+	*tail = job;
+
+	if ((fp = event_begin(&buf, &size, "queued")) == NULL)
+		return;
+	fprintf(fp, ",\"job\":%d,\"position\":%d,\"ptests\":%d",
+			job->id, position, job->ptests_no);
+	event_end(fp, &buf, &size, c);
+}
+
+static void
+server_request(struct server *srv, struct server_client *c, char *line)
+{
+	char *args;
+
+	args = line + strcspn(line, " \t");
+	if (*args != '\0')
+		*args++ = '\0';
+
+	if (strcmp(line, "list") == 0)
+		server_list(srv, c);
+	else if (strcmp(line, "status") == 0)
+		server_status(srv, c);
+	else if (strcmp(line, "run") == 0)
+		server_enqueue(srv, c, args);
+	else if (line[0] != '\0')
+		send_error(c, "unknown request, expected list, status or run");
+}
+
+struct server_stream {
+	int fd;
+	int job;
+	const char *ptest;
+};
+
+/* The log of the running ptest, sent on as it is written. */
+static ssize_t
+server_stream_write(void *cookie, const char *data, size_t len)
+{
+	struct server_stream *st = cookie;
+	char *buf;
+	size_t size;
+	FILE *fp;
+
+	if ((fp = event_begin(&buf, &size, "output")) != NULL) {
+		fprintf(fp, ",\"job\":%d", st->job);
+		event_str(fp, "ptest", st->ptest, strlen(st->ptest));
+		event_str(fp, "data", data, len);
+		job_event_end(fp, &buf, &size, st->fd);
+	}
+
+	return (ssize_t) len;
+}
+
+static void
+server_job_started(void *data, const struct ptest_list *p, pid_t pid)
+{
+	server_ptest_pid = pid;
+}
+
+/* The ptest runs in its own session, its whole group goes with the job. */
+static void
+server_job_term(int sig)
+{
+	pid_t pid = server_ptest_pid;
+
+	if (pid > 0) {
+		kill(-pid, SIGKILL);
+		kill(pid, SIGKILL);
+	}
+	_exit(1);
+}
+
+/* Runs in the forked worker, one ptest at a time so results stream. */
+static void
+server_job_exec(struct server *srv, struct server_job *job, int fd)
+{
+	struct ptest_options opts = *srv->opts;
+	struct ptest_callbacks callbacks;
+	cookie_io_functions_t io;
+	int i, fail = 0;
+	char *buf;
+	size_t size;
+	FILE *fp;
+
+	/*
+	 * Jobs report to their client only, the reporters of the daemon's
+	 * own options would have every concurrent job writing into them.
+	 */
+	opts.xml_filename = NULL;
+	opts.stats = NULL;
+	memset(&callbacks, 0, sizeof(callbacks));
+	callbacks.start = server_job_started;
+	opts.callbacks = &callbacks;
+	memset(&io, 0, sizeof(io));
+	io.write = server_stream_write;
+
+	for (i = 0; i < job->ptests_no; i++) {
+		struct server_stream st = {fd, job->id, job->ptests[i]};
+		struct ptest_list *run;
+		struct timespec start, end;
+		FILE *log_fp;
+		int rc;
+
+		run = filter_ptests(srv->index, &job->ptests[i], 1);
+		if (run == NULL) {
+			const char *msg = "ptest disappeared from the index";
+
+			if ((fp = event_begin(&buf, &size, "error")) != NULL) {
+				event_str(fp, "message", msg, strlen(msg));
+				job_event_end(fp, &buf, &size, fd);
+			}
+			fail++;
+			continue;
+		}
+
+		if ((fp = event_begin(&buf, &size, "start")) != NULL) {
+			fprintf(fp, ",\"job\":%d", job->id);
+			event_str(fp, "ptest", job->ptests[i], strlen(job->ptests[i]));
+			event_str(fp, "path", run->next->run_ptest,
+					strlen(run->next->run_ptest));
+			job_event_end(fp, &buf, &size, fd);
+		}
+
+		log_fp = fopencookie(&st, "w", io);
+		CHECK_ALLOCATION(log_fp, 1, 1);
+		setvbuf(log_fp, NULL, _IONBF, 0);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		rc = run_ptests(run, &opts, srv->progname, log_fp, log_fp);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		server_ptest_pid = 0;
+		fclose(log_fp);
+
+		if (run->next->status != PTEST_STATUS_PASS)
+			fail++;
+
+		if ((fp = event_begin(&buf, &size, "end")) != NULL) {
+			fprintf(fp, ",\"job\":%d", job->id);
+			event_str(fp, "ptest", job->ptests[i], strlen(job->ptests[i]));
+			fprintf(fp, ",\"status\":\"%s\",\"failures\":%d,\"duration_ms\":%ld",
+					run->next->status == PTEST_STATUS_PASS ? "pass" : "fail",
+					rc,
+					(end.tv_sec - start.tv_sec) * 1000 +
+					(end.tv_nsec - start.tv_nsec) / 1000000);
+			job_event_end(fp, &buf, &size, fd);
+		}
+
+		ptest_list_free_all(run);
+	}
+
+	if ((fp = event_begin(&buf, &size, "done")) != NULL) {
+		fprintf(fp, ",\"job\":%d,\"total\":%d,\"fail\":%d",
+				job->id, job->ptests_no, fail);
+		job_event_end(fp, &buf, &size, fd);
+	}
+}
+
+static void
+server_schedule(struct server *srv)
+{
+	while (srv->queue != NULL && srv->running_no < srv->jobs) {
+		struct server_job *job = srv->queue;
+		int pipefd[2];
+		pid_t pid;
+
+		/* Start from a fresh index so new packages are picked up. */
+		server_index(srv);
+
+		if (pipe2(pipefd, O_CLOEXEC) == -1) {
+			fprintf(stderr, "ERROR: pipe() failed with: %s.\n", strerror(errno));
+			return;
+		}
+
+		fflush(stdout);
+		fflush(stderr);
+		pid = fork();
+		if (pid == -1) {
+			fprintf(stderr, "ERROR: Fork %s\n", strerror(errno));
+			close(pipefd[0]);
+			close(pipefd[1]);
+			return;
+		} else if (pid == 0) {
+			struct server_job *j;
+			sigset_t mask;
+			int i;
+
+			signal(SIGTERM, server_job_term);
+			signal(SIGINT, server_job_term);
+			signal(SIGHUP, server_job_term);
+			sigemptyset(&mask);
+			sigprocmask(SIG_SETMASK, &mask, NULL);
+
+			close(pipefd[0]);
+			close(srv->listen_fd);
+			close(srv->signal_fd);
+			if (srv->inotify_fd >= 0)
+				close(srv->inotify_fd);
+			for (i = 0; i < srv->clients_no; i++)
+				close(srv->clients[i].fd);
+			for (j = srv->running; j != NULL; j = j->next)
+				if (j->fd >= 0)
+					close(j->fd);
+
+			server_job_exec(srv, job, pipefd[1]);
+			_exit(0);
+		}
+
+		close(pipefd[1]);
+		fcntl(pipefd[0], F_SETFL, O_NONBLOCK);
+		srv->queue = job->next;
+		job->fd = pipefd[0];
+		job->pid = pid;
+		job->next = srv->running;
+		srv->running = job;
+		srv->running_no++;
+	}
+}
+
+static void
+server_reap(struct server *srv)
+{
+	pid_t pid;
+	int status;
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		struct server_job **j;
+
+		for (j = &srv->running; *j != NULL; j = &(*j)->next) {
+			if ((*j)->pid == pid) {
+				struct server_job *job = *j;
+				*j = job->next;
+				/* What the worker wrote before it exited still goes out. */
+				while (job->fd >= 0 && server_job_read(srv, job) > 0)
+					;
+				server_job_free(job);
+				srv->running_no--;
+				break;
+			}
+		}
+	}
+}
+
+static void
+server_signal(struct server *srv)
+{
+	struct signalfd_siginfo si;
+
+	while (read(srv->signal_fd, &si, sizeof(si)) == sizeof(si)) {
+		if (si.ssi_signo == SIGCHLD)
+			server_reap(srv);
+		else
+			srv->done = 1;
+	}
+}
+
+static void
+server_client_close(struct server *srv, int i)
+{
+	close(srv->clients[i].fd);
+	free(srv->clients[i].out);
+	srv->clients_no--;
+	if (i != srv->clients_no)
+		memcpy(&srv->clients[i], &srv->clients[srv->clients_no],
+				sizeof(struct server_client));
+}
+
+static void
+server_accept(struct server *srv)
+{
+	int fd = accept4(srv->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+	struct server_client *c;
+
+	if (fd == -1)
+		return;
+
+	c = &srv->clients[srv->clients_no];
+	if (srv->clients_no == SERVER_MAX_CLIENTS) {
+		const char *msg = "{\"event\":\"error\",\"message\":\"too many clients\"}\n";
+
+		send(fd, msg, strlen(msg), MSG_NOSIGNAL | MSG_DONTWAIT);
+		close(fd);
+		return;
+	}
+
+	memset(c, 0, sizeof(*c));
+	c->fd = fd;
+	c->id = ++srv->next_client_id;
+	srv->clients_no++;
+}
+
+/* Returns -1 when the client went away. */
+static int
+server_client_read(struct server *srv, struct server_client *c)
+{
+	ssize_t n;
+	char *nl;
+
+	n = read(c->fd, c->buf + c->len, sizeof(c->buf) - c->len - 1);
+	if (n <= 0)
+		return n < 0 && errno == EINTR ? 0 : -1;
+	c->len += (size_t) n;
+	c->buf[c->len] = '\0';
+
+	while ((nl = memchr(c->buf, '\n', c->len)) != NULL) {
+		size_t used = (size_t) (nl - c->buf) + 1;
+
+		*nl = '\0';
+		if (nl > c->buf && nl[-1] == '\r')
+			nl[-1] = '\0';
+		server_request(srv, c, c->buf);
+
+		c->len -= used;
+		memmove(c->buf, c->buf + used, c->len);
+		c->buf[c->len] = '\0';
+	}
+
+	if (c->len == sizeof(c->buf) - 1) {
+		send_error(c, "request too long");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+server_listen(const char *path)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "ERROR: socket path too long, %s\n", path);
+		return -1;
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		fprintf(stderr, "ERROR: socket() failed with: %s.\n", strerror(errno));
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	/* Only a stale socket is replaced, never some other file. */
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			fprintf(stderr, "ERROR: %s exists and is not a socket\n", path);
+			close(fd);
+			return -1;
+		}
+		unlink(path);
+	}
+
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1 ||
+	    listen(fd, SERVER_BACKLOG) == -1) {
+		fprintf(stderr, "ERROR: Unable to listen on %s, %s\n", path,
+				strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int
+ptest_server_run(const struct ptest_options *opts, const char *socket_path,
+		int jobs, const char *progname)
+{
+	struct server srv;
+	struct server_job *job;
+	struct pollfd *pfds;
+	sigset_t mask;
+	int i;
+
+	memset(&srv, 0, sizeof(srv));
+	srv.opts = opts;
+	srv.progname = progname;
+	srv.jobs = jobs > 0 ? jobs : SERVER_DEFAULT_JOBS;
+	srv.inotify_fd = -1;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGHUP);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+	srv.signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (srv.signal_fd == -1) {
+		fprintf(stderr, "ERROR: signalfd() failed with: %s.\n", strerror(errno));
+		return 1;
+	}
+
+	srv.listen_fd = server_listen(socket_path);
+	if (srv.listen_fd == -1) {
+		close(srv.signal_fd);
+		sigprocmask(SIG_UNBLOCK, &mask, NULL);
+		return 1;
+	}
+
+	pfds = calloc(3 + SERVER_MAX_CLIENTS + (size_t) srv.jobs, sizeof(struct pollfd));
+	CHECK_ALLOCATION(pfds, 3 + SERVER_MAX_CLIENTS + (size_t) srv.jobs, 1);
+
+	server_watch(&srv);
+	server_scan(&srv);
+	fprintf(stdout, "Listening on %s, %d ptests available.\n", socket_path,
+			ptest_list_length(srv.index));
+	fflush(stdout);
+
+	while (!srv.done) {
+		int nfds = 3, clients_no = srv.clients_no;
+
+		pfds[0].fd = srv.listen_fd;
+		pfds[1].fd = srv.signal_fd;
+		pfds[2].fd = srv.inotify_fd;
+		for (i = 0; i < clients_no; i++)
+			pfds[nfds++].fd = srv.clients[i].fd;
+		for (job = srv.running; job != NULL; job = job->next)
+			if (job->fd >= 0)
+				pfds[nfds++].fd = job->fd;
+		for (i = 0; i < nfds; i++) {
+			pfds[i].events = POLLIN;
+			pfds[i].revents = 0;
+		}
+		for (i = 0; i < clients_no; i++)
+			if (srv.clients[i].out_len > 0)
+				pfds[3 + i].events |= POLLOUT;
+
+		if (poll(pfds, (nfds_t) nfds, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "ERROR: poll() failed with: %s.\n", strerror(errno));
+			break;
+		}
+
+		/* Jobs first, reaping in server_signal() may free them. */
+		i = 3 + clients_no;
+		for (job = srv.running; job != NULL; job = job->next) {
+			if (job->fd < 0)
+				continue;
+			if (pfds[i++].revents & (POLLIN | POLLHUP | POLLERR) &&
+			    server_job_read(&srv, job) == -1) {
+				close(job->fd);
+				job->fd = -1;
+			}
+		}
+
+		/* Walk backwards, closing a client moves the last one into i. */
+		for (i = clients_no - 1; i >= 0; i--) {
+			struct server_client *c = &srv.clients[i];
+
+			if (pfds[3 + i].revents & POLLOUT)
+				server_client_write(c);
+			if (pfds[3 + i].revents & (POLLIN | POLLHUP | POLLERR) &&
+			    server_client_read(&srv, c) == -1)
+				c->dropped = 1;
+			if (c->dropped)
+				server_client_close(&srv, i);
+		}
+
+		if (pfds[1].revents & POLLIN)
+			server_signal(&srv);
+
+		if (pfds[2].revents & POLLIN)
+			server_inotify(&srv);
+
+		if (pfds[0].revents & POLLIN)
+			server_accept(&srv);
+
+		server_schedule(&srv);
+	}
+
+	for (job = srv.running; job != NULL; job = job->next)
+		kill(job->pid, SIGTERM);
+	while (srv.running != NULL) {
+		job = srv.running;
+		waitpid(job->pid, NULL, 0);
+		srv.running = job->next;
+		server_job_free(job);
+	}
+	while (srv.queue != NULL) {
+		job = srv.queue;
+		srv.queue = job->next;
+		server_job_free(job);
+	}
+	while (srv.clients_no > 0)
+		server_client_close(&srv, srv.clients_no - 1);
+	free(pfds);
+	free(srv.dir_wds);
+
+	close(srv.listen_fd);
+	close(srv.signal_fd);
+	if (srv.inotify_fd >= 0)
+		close(srv.inotify_fd);
+	unlink(socket_path);
+	ptest_list_free_all(srv.index);
+	sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+	return 0;
+}
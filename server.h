@@ -0,0 +1,48 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#ifndef PTEST_RUNNER_SERVER_H
+#define PTEST_RUNNER_SERVER_H
+
+#include "utils.h"
+
+#define SERVER_DEFAULT_JOBS 1
+
+/*
+ * Resident mode, requests are read one per line from clients connected
+ * to a Unix socket and answered with one JSON object per line:
+ *
+ *   list                 -> {"event":"ptest",...} ... {"event":"done"}
+ *   status               -> {"event":"status",...}
+ *   run [ptest1 ...]     -> {"event":"queued",...} {"event":"start",...}
+ *                           {"event":"output",...} ... {"event":"end",...}
+ *                           ... {"event":"done",...}
+ *
+ * The log of a running ptest is streamed in "output" events as it is
+ * read. A client that stops reading is dropped once too much output is
+ * queued for it.
+ */
+extern int ptest_server_run(const struct ptest_options *, const char *, int,
+		const char *);
+
+#endif // PTEST_RUNNER_SERVER_H
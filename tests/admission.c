@@ -0,0 +1,209 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <sys/stat.h>
+
+#include <check.h>
+
+#include "admission.h"
+#include "utils.h"
+
+extern Suite *admission_suite(void);
+
+#define ADMISSION_TEST_PROC "./test.proc"
+
+static void
+write_file(const char *path, const char *content)
+{
+	FILE *fp = fopen(path, "w");
+
+	ck_assert(fp != NULL);
+	fputs(content, fp);
+	fclose(fp);
+}
+
+static void
+fake_proc(const char *memory_avg10)
+{
+	char buf[256];
+
+	mkdir(ADMISSION_TEST_PROC, 0755);
+	mkdir(ADMISSION_TEST_PROC "/pressure", 0755);
+	write_file(ADMISSION_TEST_PROC "/pressure/cpu",
+			"some avg10=5.00 avg60=1.00 avg300=0.50 total=10\n");
+	write_file(ADMISSION_TEST_PROC "/pressure/io",
+			"some avg10=0.00 avg60=0.00 avg300=0.00 total=0\n"
+			"full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n");
+	snprintf(buf, sizeof(buf), "some avg10=%s avg60=0.00 avg300=0.00 total=1\n"
+			"full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n", memory_avg10);
+	write_file(ADMISSION_TEST_PROC "/pressure/memory", buf);
+	write_file(ADMISSION_TEST_PROC "/meminfo",
+			"MemTotal:        1000000 kB\nMemFree:          100000 kB\n"
+			"MemAvailable:     200000 kB\n");
+}
+
+static void
+remove_fake_proc(void)
+{
+	unlink(ADMISSION_TEST_PROC "/pressure/cpu");
+	unlink(ADMISSION_TEST_PROC "/pressure/io");
+	unlink(ADMISSION_TEST_PROC "/pressure/memory");
+	unlink(ADMISSION_TEST_PROC "/meminfo");
+	rmdir(ADMISSION_TEST_PROC "/pressure");
+	rmdir(ADMISSION_TEST_PROC);
+}
+
+START_TEST(test_admission_parse)
+{
+	struct ptest_admission adm;
+
+	ptest_admission_init(&adm);
+	ck_assert(adm.cpu < 0 && adm.memory < 0 && adm.io < 0);
+	ck_assert(ptest_admission_parse(&adm, "memory=20,io=40.5,mem_available=65536,max_wait=10") == 0);
+	ck_assert(adm.memory == 20);
+	ck_assert(adm.io == 40.5);
+	ck_assert(adm.cpu < 0);
+	ck_assert_int_eq(adm.mem_available_kb, 65536);
+	ck_assert_int_eq(adm.max_wait, 10);
+
+	ck_assert(ptest_admission_parse(&adm, "memory") == -1);
+	ck_assert(ptest_admission_parse(&adm, "disk=1") == -1);
+	ck_assert(ptest_admission_parse(&adm, "cpu=-1") == -1);
+}
+END_TEST
+
+START_TEST(test_admission_check)
+{
+	struct ptest_admission adm;
+	struct ptest_pressure pr;
+	char reason[128];
+
+	fake_proc("30.00");
+	ck_assert(ptest_pressure_read(ADMISSION_TEST_PROC, &pr) == 0);
+	ck_assert(pr.cpu == 5);
+	ck_assert(pr.memory == 30);
+	ck_assert(pr.io == 0);
+	ck_assert_int_eq(pr.mem_available_kb, 200000);
+
+	ptest_admission_init(&adm);
+	ck_assert_int_eq(ptest_admission_check(&adm, &pr, reason, sizeof(reason)), 0);
+
+	adm.memory = 20;
+	ck_assert(ptest_admission_check(&adm, &pr, reason, sizeof(reason)) != 0);
+	ck_assert_str_eq(reason, "memory pressure 30.00 > 20.00");
+
+	adm.memory = 40;
+	adm.mem_available_kb = 300000;
+	ck_assert(ptest_admission_check(&adm, &pr, reason, sizeof(reason)) != 0);
+	ck_assert_str_eq(reason, "MemAvailable 200000 kB < 300000 kB");
+
+	adm.mem_available_kb = 0;
+	adm.cpu = 10;
+	ck_assert_int_eq(ptest_admission_check(&adm, &pr, reason, sizeof(reason)), 0);
+
+	remove_fake_proc();
+}
+END_TEST
+
+static int64_t
+fake_clock_ms(void *data)
+{
+	return *(int64_t *) data;
+}
+
+static int
+fake_poll(void *data, struct pollfd *fds, nfds_t nfds, int timeout)
+{
+	*(int64_t *) data += timeout;
+
+	return 0;
+}
+
+START_TEST(test_admission_wait)
+{
+	struct ptest_admission adm;
+	struct ptest_backend be;
+	int64_t now = 0;
+	char *buf;
+	size_t size;
+	FILE *fp;
+
+	fake_proc("30.00");
+	ptest_admission_init(&adm);
+	adm.proc = ADMISSION_TEST_PROC;
+
+	/* Under the thresholds, nothing logged. */
+	fp = open_memstream(&buf, &size);
+	ck_assert(ptest_admission_wait(&adm, "gcc", NULL, fp) < ADMISSION_POLL_MS);
+	fclose(fp);
+	ck_assert_int_eq(size, 0);
+	free(buf);
+
+	/* Over, held back until max_wait then started anyway. */
+	adm.memory = 20;
+	adm.max_wait = 1;
+	fp = open_memstream(&buf, &size);
+	ck_assert(ptest_admission_wait(&adm, "gcc", NULL, fp) >= 1000);
+	fclose(fp);
+	ck_assert(strstr(buf, "DELAYED: gcc, memory pressure 30.00 > 20.00\n") == buf);
+	ck_assert(strstr(buf, "ADMITTED: gcc after ") != NULL);
+	free(buf);
+
+	/* The wait passes on the clock of the backend. */
+	memset(&be, 0, sizeof(be));
+	be.clock_ms = fake_clock_ms;
+	be.poll = fake_poll;
+	be.data = &now;
+	adm.max_wait = 600;
+	fp = open_memstream(&buf, &size);
+	ck_assert_int_eq(ptest_admission_wait(&adm, "gcc", &be, fp), 600000);
+	fclose(fp);
+	ck_assert(strstr(buf, "ADMITTED: gcc after 600000 ms, still ") != NULL);
+	free(buf);
+
+	remove_fake_proc();
+}
+END_TEST
+
+Suite *
+admission_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("admission");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_admission_parse);
+	tcase_add_test(tc_core, test_admission_check);
+	tcase_add_test(tc_core, test_admission_wait);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
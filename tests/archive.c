@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <check.h>
+
+#include "archive.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+extern Suite *archive_suite(void);
+
+#define ARCHIVE_TEST_FILE "./test.archive"
+
+START_TEST(test_lz_roundtrip)
+{
+	static unsigned char in[ARCHIVE_BLOCK_SIZE], out[ARCHIVE_BLOCK_SIZE];
+	static unsigned char packed[ARCHIVE_PACKED_SIZE];
+	size_t i, n;
+
+	/* Log like text compresses, random bytes may only grow by the bound. */
+	for (i = 0, n = 0; n + 32 < sizeof(in); i++)
+		n += (size_t) sprintf((char *) in + n, "PASS: test_%zu\n", i % 500);
+	n = ptest_lz_compress(in, sizeof(in), packed);
+	ck_assert(n < sizeof(in) / 4);
+	ck_assert_int_eq(ptest_lz_decompress(packed, n, out, sizeof(out)), sizeof(in));
+	ck_assert(memcmp(in, out, sizeof(in)) == 0);
+
+	srand(1);
+	for (i = 0; i < sizeof(in); i++)
+		in[i] = (unsigned char) rand();
+	n = ptest_lz_compress(in, sizeof(in), packed);
+	ck_assert(n <= ARCHIVE_PACKED_SIZE);
+	ck_assert_int_eq(ptest_lz_decompress(packed, n, out, sizeof(out)), sizeof(in));
+	ck_assert(memcmp(in, out, sizeof(in)) == 0);
+
+	/* Distances before the start of the output are rejected. */
+	packed[0] = 0x80;
+	packed[1] = 1;
+	packed[2] = 0;
+	ck_assert_int_eq(ptest_lz_decompress(packed, 3, out, sizeof(out)), -1);
+}
+END_TEST
+
+START_TEST(test_archive_show)
+{
+	struct ptest_list *head, *filtered;
+	struct ptest_options opts;
+	struct ptest_archive *a;
+	char *ptests[] = {"bash", "gcc", "fail"};
+	char *live, *shown;
+	size_t live_size, shown_size;
+	FILE *fp;
+
+	memset(&opts, 0, sizeof(opts));
+	opts.timeout = 5;
+
+	ck_assert(ptest_archive_open("/nonexistent/dir/archive") == NULL);
+
+	a = ptest_archive_open(ARCHIVE_TEST_FILE);
+	ck_assert(a != NULL);
+	opts.callbacks = &a->callbacks;
+
+	head = get_available_ptests("./tests/data");
+	filtered = filter_ptests(head, ptests, 3);
+	fp = open_memstream(&live, &live_size);
+	ck_assert(run_ptests(filtered, &opts, "archive", fp, fp) == 1);
+	fclose(fp);
+	ck_assert(ptest_archive_close(a) == 0);
+
+	/* bash spans several blocks, its output must come back byte exact. */
+	fp = open_memstream(&shown, &shown_size);
+	ck_assert(ptest_archive_show(ARCHIVE_TEST_FILE, "bash", fp) == 0);
+	fclose(fp);
+	ck_assert(shown_size > ARCHIVE_BLOCK_SIZE);
+	ck_assert(strncmp(shown, "bash\n", 5) == 0);
+	ck_assert(strstr(live, shown) != NULL);
+	free(shown);
+
+	fp = open_memstream(&shown, &shown_size);
+	ck_assert(ptest_archive_show(ARCHIVE_TEST_FILE, "gcc", fp) == 0);
+	ck_assert(ptest_archive_show(ARCHIVE_TEST_FILE, "fail", fp) == 0);
+	fclose(fp);
+	ck_assert_str_eq(shown, "gcc\n");
+	free(shown);
+
+	fp = fopen("/dev/null", "w");
+	ck_assert(ptest_archive_show(ARCHIVE_TEST_FILE, "nothere", fp) == 1);
+	ck_assert(ptest_archive_show("/nonexistent/archive", "gcc", fp) == -1);
+	ck_assert(ptest_archive_show("./tests/data/gcc/ptest/run-ptest", "gcc", fp) == -1);
+	fclose(fp);
+
+	free(live);
+	ptest_list_free_all(filtered);
+	ptest_list_free_all(head);
+	unlink(ARCHIVE_TEST_FILE);
+}
+END_TEST
+
+Suite *
+archive_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("archive");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_lz_roundtrip);
+	tcase_add_test(tc_core, test_archive_show);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <check.h>
+
+#include "budget.h"
+#include "history.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+extern Suite *budget_suite(void);
+
+#define BUDGET_TEST_FILE "./test.budget"
+
+START_TEST(test_budget_select)
+{
+	const char *names[] = {"gcc", "fail", "glibc", "python", "bash"};
+	const char *expected[] = {"bash", "fail", "gcc", "python", "glibc"};
+	struct ptest_history *h;
+	struct ptest_list *head, *p;
+	char path[64], *buf;
+	size_t size, i;
+	FILE *fp;
+
+	fp = fopen(BUDGET_TEST_FILE, "w");
+	ck_assert(fp != NULL);
+	/* Samples from the future keep run-ptest from looking changed. */
+	fprintf(fp, "gcc 4000000000 1 0 10000 10\ngcc 4000000000 1 0 10000 10\n"
+			"gcc 4000000000 1 0 10000 10\n"
+			"fail 4000000000 1 0 20000 10\nfail 4000000000 2 0 20000 10\n"
+			"fail 4000000000 2 0 20000 10\n"
+			"glibc 4000000000 1 0 90000 10\n"
+			"bash 1 1 0 5000 10\n");
+	fclose(fp);
+	h = ptest_history_load(BUDGET_TEST_FILE);
+	ck_assert(h != NULL);
+
+	head = ptest_list_alloc();
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		snprintf(path, sizeof(path), "./tests/data/%s/ptest/run-ptest", names[i]);
+		ck_assert(ptest_list_add(head, strdup(names[i]), strdup(path)) != NULL);
+	}
+
+	fp = open_memstream(&buf, &size);
+	ck_assert_int_eq(ptest_budget_select(head, h, 100, fp), 4);
+	fclose(fp);
+
+	i = 0;
+	PTEST_LIST_ITERATE_START(head, p)
+		ck_assert_str_eq(p->ptest, expected[i]);
+		ck_assert(p->prev != NULL);
+		ck_assert_int_eq(p->status, i < 4 ? PTEST_STATUS_NOTRUN :
+				PTEST_STATUS_BUDGET);
+		i++;
+	PTEST_LIST_ITERATE_END
+	ck_assert_int_eq(i, 5);
+
+	ck_assert(strstr(buf, "BUDGET: run bash, estimated 5.0 s, value 3.0, changed\n") != NULL);
+	ck_assert(strstr(buf, "BUDGET: run python, estimated 60.0 s, value 3.0, changed\n") != NULL);
+	ck_assert(strstr(buf, "BUDGET: skip glibc, estimated 90.0 s") != NULL);
+	ck_assert(strstr(buf, "BUDGET: 4 of 5 ptests selected, estimated 95.0 of 100 seconds\n") != NULL);
+	free(buf);
+
+	ptest_list_free_all(head);
+	ptest_history_free(h);
+	unlink(BUDGET_TEST_FILE);
+}
+END_TEST
+
+START_TEST(test_budget_run_stop)
+{
+	struct ptest_list *head, *filtered;
+	struct ptest_options opts;
+	char *ptests[] = {"hang", "python"};
+	char *buf;
+	size_t size;
+	FILE *fp;
+
+	memset(&opts, 0, sizeof(opts));
+	opts.timeout = 5;
+	opts.time_budget = 1;
+
+	/* hang is cut at the end of the budget, python is not started. */
+	head = get_available_ptests("./tests/data");
+	filtered = filter_ptests(head, ptests, 2);
+	fp = open_memstream(&buf, &size);
+	ck_assert_int_eq(run_ptests(filtered, &opts, "budget", fp, fp), 0);
+	fclose(fp);
+
+	/* Running out of time is not a failure of the ptest. */
+	ck_assert(strstr(buf, "ERROR: Deadline of 1 seconds exceeded") == NULL);
+	ck_assert(strstr(buf, "TIMEOUT: ") == NULL);
+	ck_assert(strstr(strstr(buf, "DURATION: "), "\nSKIPPED: ") != NULL);
+	ck_assert(strstr(strstr(buf, "BEGIN: ") + 1, "BEGIN: ") == NULL);
+	ck_assert_int_eq(ptest_list_search(filtered, "hang")->status,
+			PTEST_STATUS_BUDGET);
+	ck_assert_int_eq(ptest_list_search(filtered, "python")->status,
+			PTEST_STATUS_BUDGET);
+
+	free(buf);
+	ptest_list_free_all(filtered);
+	ptest_list_free_all(head);
+}
+END_TEST
+
+Suite *
+budget_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("budget");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_budget_select);
+	tcase_add_test(tc_core, test_budget_run_stop);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -0,0 +1,115 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <check.h>
+
+#include "cache.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+extern Suite *cache_suite(void);
+
+#define CACHE_TEST_FILE "./test.cache"
+
+START_TEST(test_cache_hash_dir)
+{
+	uint64_t meta1, meta2, content1 = 0, content2 = 0;
+
+	ck_assert(ptest_cache_hash_dir("./tests/data/gcc/ptest", 0, &meta1, &content1) == 0);
+	ck_assert(ptest_cache_hash_dir("./tests/data/gcc/ptest", 0, &meta2, &content2) == 0);
+	ck_assert(meta1 == meta2);
+	ck_assert(content1 == content2);
+
+	/* Different run-ptest content must give a different hash. */
+	ck_assert(ptest_cache_hash_dir("./tests/data/glibc/ptest", 0, &meta2, &content2) == 0);
+	ck_assert(content1 != content2);
+
+	ck_assert(ptest_cache_hash_dir("./tests/data/none", 0, &meta1, &content1) == -1);
+}
+END_TEST
+
+START_TEST(test_cache_mark_update)
+{
+	struct ptest_list *head;
+	struct ptest_cache *cache;
+	uint64_t env = ptest_cache_hash_env(NULL, 0);
+
+	unlink(CACHE_TEST_FILE);
+
+	head = get_available_ptests("./tests/data");
+	ck_assert(head != NULL);
+
+	cache = ptest_cache_load(CACHE_TEST_FILE, env, PTEST_CACHE_DEFAULT_MAX_AGE);
+	ck_assert(cache != NULL);
+	ck_assert_int_eq(ptest_cache_mark(cache, head), 0);
+
+	ptest_list_search(head, "gcc")->status = PTEST_STATUS_PASS;
+	ptest_list_search(head, "fail")->status = PTEST_STATUS_FAIL;
+	ptest_cache_update(cache, head);
+	ck_assert(ptest_cache_save(cache) == 0);
+	ptest_cache_free(cache);
+	ptest_list_free_all(head);
+
+	/* Only the passing ptest is served from the cache. */
+	head = get_available_ptests("./tests/data");
+	cache = ptest_cache_load(CACHE_TEST_FILE, env, PTEST_CACHE_DEFAULT_MAX_AGE);
+	ck_assert(cache != NULL);
+	ck_assert_int_eq(ptest_cache_mark(cache, head), 1);
+	ck_assert(ptest_list_search(head, "gcc")->status == PTEST_STATUS_CACHED);
+	ck_assert(ptest_list_search(head, "fail")->status == PTEST_STATUS_NOTRUN);
+	ptest_cache_free(cache);
+	ptest_list_free_all(head);
+
+	/* A different environment invalidates every entry. */
+	head = get_available_ptests("./tests/data");
+	cache = ptest_cache_load(CACHE_TEST_FILE, env + 1, PTEST_CACHE_DEFAULT_MAX_AGE);
+	ck_assert(cache != NULL);
+	ck_assert_int_eq(ptest_cache_mark(cache, head), 0);
+	ptest_cache_free(cache);
+	ptest_list_free_all(head);
+
+	unlink(CACHE_TEST_FILE);
+}
+END_TEST
+
+Suite *
+cache_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("cache");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_cache_hash_dir);
+	tcase_add_test(tc_core, test_cache_mark_update);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <check.h>
+
+#include "capture.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+extern Suite *capture_suite(void);
+
+#define CAPTURE_TEST_FILE "./test.capture"
+#define CAPTURE_TEST_BUF_SIZE 8192
+
+START_TEST(test_capture_streams)
+{
+	struct ptest_list *head, *filtered;
+	struct ptest_options opts;
+	struct ptest_capture *c;
+	char *ptests[] = {"bash"};
+	char line[CAPTURE_TEST_BUF_SIZE];
+	char *out_buf, *err_buf;
+	size_t out_size, err_size;
+	FILE *fp, *out, *err;
+	int lines = 0, err_lines = 0, long_lines = 0;
+	double t, last = 0;
+
+	memset(&opts, 0, sizeof(opts));
+	opts.timeout = 5;
+	opts.separate_stderr = 1;
+
+	ck_assert(ptest_capture_open("/nonexistent/dir/capture") == NULL);
+
+	c = ptest_capture_open(CAPTURE_TEST_FILE);
+	ck_assert(c != NULL);
+	opts.callbacks = &c->callbacks;
+
+	head = get_available_ptests("./tests/data");
+	filtered = filter_ptests(head, ptests, 1);
+	out = open_memstream(&out_buf, &out_size);
+	err = open_memstream(&err_buf, &err_size);
+	ck_assert(run_ptests(filtered, &opts, "capture", out, err) == 0);
+	fclose(out);
+	fclose(err);
+	ptest_capture_close(c);
+
+	/* stderr is no longer folded into stdout. */
+	ck_assert(strstr(err_buf, "Hello World!,stderr\n") != NULL);
+	ck_assert(strstr(out_buf, "Hello World!,stderr") == NULL);
+	ck_assert(strstr(out_buf, "bash2\n") != NULL);
+
+	fp = fopen(CAPTURE_TEST_FILE, "r");
+	ck_assert(fp != NULL);
+	ck_assert(fgets(line, sizeof(line), fp) != NULL);
+	ck_assert_str_eq(line, "# BEGIN bash\n");
+	while (fgets(line, sizeof(line), fp) != NULL && line[0] != '#') {
+		ck_assert(sscanf(line, "%lf", &t) == 1);
+		ck_assert(t >= last);
+		last = t;
+		if (strstr(line, " err Hello World!,stderr") != NULL)
+			err_lines++;
+		if (strlen(line) > CAPTURE_LINE_MAX)
+			long_lines++;
+		lines++;
+	}
+	ck_assert_str_eq(line, "# END bash pass\n");
+	ck_assert(fgets(line, sizeof(line), fp) == NULL);
+	fclose(fp);
+
+	ck_assert_int_eq(err_lines, 3);
+	/* The single huge line at the end is split at CAPTURE_LINE_MAX. */
+	ck_assert(long_lines > 1);
+	ck_assert(lines > 7 + long_lines);
+
+	free(out_buf);
+	free(err_buf);
+	ptest_list_free_all(filtered);
+	ptest_list_free_all(head);
+	unlink(CAPTURE_TEST_FILE);
+}
+END_TEST
+
+Suite *
+capture_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("capture");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_capture_streams);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -0,0 +1,243 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <sys/stat.h>
+
+#include <check.h>
+
+#include "cgroup.h"
+#include "config.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+extern Suite *cgroup_suite(void);
+
+/* A plain directory standing in for a delegated cgroup v2 subtree. */
+#define CGROUP_TEST_DIR "./test.cgroup"
+
+static const char *cgroup_files[] = {
+	"cgroup.procs", "cgroup.kill", "memory.max", "pids.max",
+	"cpu.weight", "io.weight", "memory.events", "memory.peak", NULL,
+};
+
+static void
+fake_cgroup(const char *ptest, const char *events, const char *peak)
+{
+	char path[PATH_MAX];
+	FILE *fp;
+	int i;
+
+	mkdir(CGROUP_TEST_DIR, 0755);
+	snprintf(path, sizeof(path), CGROUP_TEST_DIR "/%s.%d", ptest, (int) getpid());
+	mkdir(path, 0755);
+	for (i = 0; cgroup_files[i] != NULL; i++) {
+		snprintf(path, sizeof(path), CGROUP_TEST_DIR "/%s.%d/%s", ptest,
+				(int) getpid(), cgroup_files[i]);
+		fp = fopen(path, "w");
+		ck_assert(fp != NULL);
+		if (strcmp(cgroup_files[i], "memory.events") == 0)
+			fputs(events, fp);
+		if (strcmp(cgroup_files[i], "memory.peak") == 0)
+			fputs(peak, fp);
+		fclose(fp);
+	}
+}
+
+static void
+remove_fake_cgroup(const char *ptest)
+{
+	char path[PATH_MAX];
+	int i;
+
+	for (i = 0; cgroup_files[i] != NULL; i++) {
+		snprintf(path, sizeof(path), CGROUP_TEST_DIR "/%s.%d/%s", ptest,
+				(int) getpid(), cgroup_files[i]);
+		unlink(path);
+	}
+	snprintf(path, sizeof(path), CGROUP_TEST_DIR "/%s.%d", ptest, (int) getpid());
+	rmdir(path);
+	rmdir(CGROUP_TEST_DIR);
+}
+
+static void
+read_file(const char *ptest, const char *file, char *buf, size_t size)
+{
+	char path[PATH_MAX];
+	FILE *fp;
+	size_t n;
+
+	snprintf(path, sizeof(path), CGROUP_TEST_DIR "/%s.%d/%s", ptest,
+			(int) getpid(), file);
+	fp = fopen(path, "r");
+	ck_assert(fp != NULL);
+	n = fread(buf, 1, size - 1, fp);
+	buf[n] = '\0';
+	fclose(fp);
+}
+
+START_TEST(test_cgroup_create)
+{
+	struct ptest_config *cfg = calloc(1, sizeof(struct ptest_config));
+	struct ptest_cgroup cg;
+	char buf[64];
+	int oom;
+	long peak;
+
+	ck_assert(cfg != NULL);
+	ck_assert(ptest_config_add(cfg, "*", "pids.max", "64") == 0);
+	ck_assert(ptest_config_add(cfg, "gcc", "memory.max", "1048576") == 0);
+	ck_assert(ptest_config_add(cfg, "gcc", "timeout", "5") == 0);
+
+	ck_assert(ptest_cgroup_setup("/nonexistent/cgroup") == -1);
+
+	fake_cgroup("gcc", "low 0\nhigh 0\nmax 3\noom 1\noom_kill 2\n", "2097152\n");
+	ck_assert(ptest_cgroup_create(&cg, CGROUP_TEST_DIR, "gcc", cfg) == 0);
+
+	read_file("gcc", "memory.max", buf, sizeof(buf));
+	ck_assert_str_eq(buf, "1048576");
+	read_file("gcc", "pids.max", buf, sizeof(buf));
+	ck_assert_str_eq(buf, "64");
+	read_file("gcc", "cpu.weight", buf, sizeof(buf));
+	ck_assert_str_eq(buf, "");
+
+	ck_assert(ptest_cgroup_enter(&cg) == 0);
+	read_file("gcc", "cgroup.procs", buf, sizeof(buf));
+	ck_assert_str_eq(buf, "0");
+
+	ptest_cgroup_stats(&cg, &oom, &peak);
+	ck_assert_int_eq(oom, 2);
+	ck_assert_int_eq(peak, 2048);
+
+	remove_fake_cgroup("gcc");
+	ptest_config_free(cfg);
+}
+END_TEST
+
+START_TEST(test_cgroup_run_oom)
+{
+	struct ptest_list *head, *filtered;
+	struct ptest_options opts;
+	char *ptests[] = {"gcc"};
+	char *buf;
+	size_t size;
+	FILE *fp;
+
+	/* gcc exits 0, the OOM kill of one of its processes still fails it. */
+	fake_cgroup("gcc", "oom_kill 1\n", "4096\n");
+
+	memset(&opts, 0, sizeof(opts));
+	opts.timeout = 1;
+	opts.cgroup = CGROUP_TEST_DIR;
+
+	head = get_available_ptests("./tests/data");
+	filtered = filter_ptests(head, ptests, 1);
+	fp = open_memstream(&buf, &size);
+	ck_assert_int_eq(run_ptests(filtered, &opts, "cgroup", fp, fp), 1);
+	fclose(fp);
+
+	ck_assert_int_eq(filtered->next->oom_killed, 1);
+	ck_assert_int_eq(filtered->next->memory_peak_kb, 4);
+	ck_assert_int_eq(filtered->next->status, PTEST_STATUS_FAIL);
+	ck_assert(strstr(buf, "ERROR: Killed by the OOM killer") != NULL);
+
+	free(buf);
+	ptest_list_free_all(filtered);
+	ptest_list_free_all(head);
+	remove_fake_cgroup("gcc");
+}
+END_TEST
+
+START_TEST(test_cgroup_run_unconfined)
+{
+	struct ptest_list *head, *filtered;
+	struct ptest_options opts;
+	char *ptests[] = {"gcc"};
+	char path[PATH_MAX];
+	char *buf;
+	size_t size;
+	FILE *fp;
+
+	memset(&opts, 0, sizeof(opts));
+	opts.timeout = 1;
+	opts.cgroup = "/nonexistent/cgroup";
+
+	/* No cgroup, no run, and the run is not green. */
+	head = get_available_ptests("./tests/data");
+	filtered = filter_ptests(head, ptests, 1);
+	fp = open_memstream(&buf, &size);
+	ck_assert_int_eq(run_ptests(filtered, &opts, "cgroup", fp, fp), 1);
+	fclose(fp);
+	ck_assert_int_eq(filtered->next->status, PTEST_STATUS_FAIL);
+	ck_assert(strstr(buf, "ERROR: Unable to create cgroup for gcc") != NULL);
+	ck_assert(strstr(buf, "BEGIN: ") == NULL);
+	free(buf);
+	ptest_list_free_all(filtered);
+
+	/* The child does not go on when it can not move itself in. */
+	fake_cgroup("gcc", "", "0\n");
+	snprintf(path, sizeof(path), CGROUP_TEST_DIR "/gcc.%d/cgroup.procs",
+			(int) getpid());
+	unlink(path);
+	ck_assert(mkdir(path, 0755) == 0);
+	opts.cgroup = CGROUP_TEST_DIR;
+
+	filtered = filter_ptests(head, ptests, 1);
+	fp = open_memstream(&buf, &size);
+	ck_assert_int_eq(run_ptests(filtered, &opts, "cgroup", fp, fp), 1);
+	fclose(fp);
+	ck_assert_int_eq(filtered->next->status, PTEST_STATUS_FAIL);
+	/* Its error went to a copy of the memstream, only the exit shows. */
+	ck_assert(strstr(buf, "ERROR: Exit status is 1") != NULL);
+	ck_assert(strstr(buf, "\ngcc\n") == NULL);
+	free(buf);
+
+	rmdir(path);
+	ptest_list_free_all(filtered);
+	ptest_list_free_all(head);
+	remove_fake_cgroup("gcc");
+}
+END_TEST
+
+Suite *
+cgroup_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("cgroup");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_cgroup_create);
+	tcase_add_test(tc_core, test_cgroup_run_oom);
+	tcase_add_test(tc_core, test_cgroup_run_unconfined);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <check.h>
+
+#include "compare.h"
+#include "history.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+extern Suite *compare_suite(void);
+
+#define COMPARE_TEST_FILE "./test.baseline"
+
+static struct ptest_list *
+add_result(struct ptest_list *head, const char *name, int status,
+		int64_t duration_ms, int64_t cpu_ms)
+{
+	struct ptest_list *p;
+
+	p = ptest_list_add(head, strdup(name), strdup("/ptest/run-ptest"));
+	ck_assert(p != NULL);
+	p->status = status;
+	p->duration_ms = duration_ms;
+	p->utime_ms = cpu_ms;
+
+	return p;
+}
+
+START_TEST(test_compare_rank)
+{
+	struct ptest_regression *r;
+	struct ptest_history *baseline;
+	struct ptest_list *head;
+	char *buf;
+	size_t size;
+	FILE *fp;
+	int n;
+
+	fp = fopen(COMPARE_TEST_FILE, "w");
+	ck_assert(fp != NULL);
+	/*
+	 * gcc is steady, glibc noisy, python only has a failing sample and
+	 * perl too few passing ones to tell its noise.
+	 */
+	fprintf(fp, "gcc 1 1 0 1000 100\ngcc 2 1 0 1010 100\n"
+			"gcc 3 1 0 990 110\ngcc 4 1 0 1005 100\n"
+			"glibc 1 1 0 1000 10\nglibc 2 1 0 1500 10\n"
+			"glibc 3 1 0 500 10\nglibc 4 1 0 1200 10\n"
+			"python 1 2 0 10 10\n"
+			"perl 1 1 0 100 100\nperl 2 1 0 100 100\n");
+	fclose(fp);
+	baseline = ptest_history_load(COMPARE_TEST_FILE);
+	ck_assert(baseline != NULL);
+
+	head = ptest_list_alloc();
+	add_result(head, "gcc", PTEST_STATUS_PASS, 1300, 500);
+	add_result(head, "glibc", PTEST_STATUS_PASS, 1400, 10);
+	add_result(head, "python", PTEST_STATUS_PASS, 5000, 5000);
+	add_result(head, "bash", PTEST_STATUS_PASS, 5000, 5000);
+	add_result(head, "perl", PTEST_STATUS_PASS, 5000, 5000);
+	add_result(head, "fail", PTEST_STATUS_FAIL, 5000, 5000);
+
+	n = ptest_compare(baseline, head, COMPARE_DEFAULT_SIGMA, &r);
+	ck_assert_int_eq(n, 2);
+	ck_assert_str_eq(r[0].p->ptest, "gcc");
+	ck_assert_str_eq(r[0].metric, "cpu");
+	ck_assert_int_eq(r[0].median, 100);
+	ck_assert_str_eq(r[1].metric, "duration");
+	ck_assert_int_eq(r[1].median, 1002);
+	ck_assert(r[0].score > r[1].score);
+
+	fp = open_memstream(&buf, &size);
+	ptest_compare_print(fp, r, n);
+	fclose(fp);
+	ck_assert(strncmp(buf, "REGRESSIONS: 2\nREGRESSION: gcc cpu 500 ms,"
+			" baseline median 100 ms", 60) == 0);
+	free(buf);
+	free(r);
+
+	/* A looser threshold tolerates the duration growth. */
+	n = ptest_compare(baseline, head, 50, &r);
+	ck_assert_int_eq(n, 1);
+	ck_assert_str_eq(r[0].metric, "cpu");
+	free(r);
+
+	ptest_list_free_all(head);
+	ptest_history_free(baseline);
+	unlink(COMPARE_TEST_FILE);
+}
+END_TEST
+
+Suite *
+compare_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("compare");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_compare_rank);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <check.h>
+
+#include "config.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+extern Suite *config_suite(void);
+
+#define CONFIG_TEST_FILE "./test.config"
+
+START_TEST(test_config_load)
+{
+	struct ptest_config *cfg;
+	FILE *fp;
+
+	ck_assert(ptest_config_load("/nonexistent/config") == NULL);
+
+	fp = fopen(CONFIG_TEST_FILE, "w");
+	ck_assert(fp != NULL);
+	fprintf(fp, "# comment\n\n*\tdeadline=100 netns\nglibc deadline=900 timeout=x\n"
+			"glibc timeout=60\n");
+	fclose(fp);
+
+	cfg = ptest_config_load(CONFIG_TEST_FILE);
+	ck_assert(cfg != NULL);
+	ck_assert_int_eq(ptest_config_get_int(cfg, "glibc", "deadline", 0), 900);
+	ck_assert_int_eq(ptest_config_get_int(cfg, "gcc", "deadline", 0), 100);
+	ck_assert_int_eq(ptest_config_get_int(cfg, "glibc", "timeout", 5), 60);
+	ck_assert_int_eq(ptest_config_get_int(cfg, "gcc", "timeout", 5), 5);
+	ck_assert_str_eq(ptest_config_get(cfg, "gcc", "netns"), "1");
+	ck_assert(ptest_config_get(cfg, "gcc", "none") == NULL);
+	ck_assert(ptest_config_get(NULL, "gcc", "deadline") == NULL);
+
+	ck_assert(ptest_config_add(cfg, "gcc", "deadline", "7") == 0);
+	ck_assert_int_eq(ptest_config_get_int(cfg, "gcc", "deadline", 0), 7);
+	ptest_config_free(cfg);
+
+	fp = fopen(CONFIG_TEST_FILE, "w");
+	ck_assert(fp != NULL);
+	fprintf(fp, "gcc =1\n");
+	fclose(fp);
+	ck_assert(ptest_config_load(CONFIG_TEST_FILE) == NULL);
+
+	unlink(CONFIG_TEST_FILE);
+}
+END_TEST
+
+START_TEST(test_config_deadline)
+{
+	struct ptest_list *head, *filtered;
+	struct ptest_options opts;
+	struct ptest_config cfg;
+	char *ptests[] = {"hang"};
+	FILE *out;
+
+	memset(&cfg, 0, sizeof(cfg));
+	ck_assert(ptest_config_add(&cfg, "hang", "deadline", "1") == 0);
+
+	/* The hang ptest prints nothing after start, inactivity is 10s. */
+	memset(&opts, 0, sizeof(opts));
+	opts.timeout = 10;
+	opts.config = &cfg;
+
+	head = get_available_ptests("./tests/data");
+	filtered = filter_ptests(head, ptests, 1);
+	out = fopen("/dev/null", "w");
+	ck_assert(run_ptests(filtered, &opts, "config", out, out) > 0);
+	fclose(out);
+
+	ck_assert_int_eq(filtered->next->timedout, PTEST_TIMEOUT_DEADLINE);
+	ck_assert(filtered->next->duration_ms < 3000);
+
+	ptest_list_free_all(filtered);
+	ptest_list_free_all(head);
+	free(cfg.entries[0].ptest);
+	free(cfg.entries[0].key);
+	free(cfg.entries[0].value);
+	free(cfg.entries);
+}
+END_TEST
+
+Suite *
+config_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("config");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_config_load);
+	tcase_add_test(tc_core, test_config_deadline);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -0,0 +1,342 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <sys/stat.h>
+
+#include <check.h>
+
+#include "config.h"
+#include "coordinator.h"
+#include "events.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+extern Suite *coordinator_suite(void);
+
+#define COORDINATOR_TEST_EVENTS "./test.coordinator.events"
+#define COORDINATOR_TEST_FIXTURES "./test.coordinator.fixtures"
+
+static struct ptest_list *
+coordinator_list(struct ptest_list *head, char **ptests, int ptests_no)
+{
+	struct ptest_list *run;
+
+	ck_assert(head != NULL);
+	run = filter_ptests(head, ptests, ptests_no);
+	ck_assert(run != NULL);
+
+	return run;
+}
+
+START_TEST(test_coordinator_run)
+{
+	struct ptest_list *head, *run, *p;
+	struct ptest_options opts;
+	struct ptest_stats stats;
+	char *dirs[] = {"./tests/data"};
+	char *ptests[] = {"gcc", "fail", "python"};
+	char *workers[] = {COORDINATOR_LOCAL_WORKER, COORDINATOR_LOCAL_WORKER};
+	char *buf;
+	size_t size;
+	FILE *fp;
+
+	memset(&opts, 0, sizeof(opts));
+	opts.dirs = dirs;
+	opts.dirs_no = 1;
+	opts.timeout = 5;
+	memset(&stats, 0, sizeof(stats));
+	opts.stats = &stats;
+
+	head = get_available_ptests_dirs(dirs, 1, NULL, stderr);
+	run = coordinator_list(head, ptests, 3);
+
+	fp = open_memstream(&buf, &size);
+	ck_assert_int_eq(ptest_coordinator_run(run, &opts, workers, 2,
+				"coordinator", fp), 1);
+	fclose(fp);
+
+	/* The overhead is the workers', added up. */
+	ck_assert(stats.spawn_us > 0);
+	ck_assert(stats.polls >= 3);
+	ck_assert(stats.bytes[0] > 0);
+	ck_assert(stats.maxrss_kb > 0);
+
+	PTEST_LIST_ITERATE_START(run, p)
+		ck_assert_int_eq(p->status, strcmp(p->ptest, "fail") == 0 ?
+				PTEST_STATUS_FAIL : PTEST_STATUS_PASS);
+	PTEST_LIST_ITERATE_END
+
+	/* One START/STOP pair around the logs merged from the workers. */
+	ck_assert(strncmp(buf, "START: coordinator\n", 19) == 0);
+	ck_assert(strstr(buf + 1, "START: ") == NULL);
+	ck_assert(strstr(buf, "STOP: coordinator\n") != NULL);
+	ck_assert(strstr(strstr(buf, "STOP: ") + 1, "STOP: ") == NULL);
+	ck_assert(strstr(buf, "/tests/data/gcc/ptest\n") != NULL);
+	ck_assert(strstr(buf, "/tests/data/fail/ptest\n") != NULL);
+	ck_assert(strstr(buf, "/tests/data/python/ptest\n") != NULL);
+
+	free(buf);
+	ptest_list_free_all(run);
+	ptest_list_free_all(head);
+}
+END_TEST
+
+static int
+count_events(const char *buf, const char *event)
+{
+	int n = 0;
+
+	while ((buf = strstr(buf, event)) != NULL) {
+		buf++;
+		n++;
+	}
+
+	return n;
+}
+
+START_TEST(test_coordinator_callbacks_once)
+{
+	struct ptest_list *head, *run;
+	struct ptest_options opts;
+	struct ptest_events *ev;
+	char *dirs[] = {"./tests/data"};
+	char *ptests[] = {"gcc", "python"};
+	char *workers[] = {COORDINATOR_LOCAL_WORKER, COORDINATOR_LOCAL_WORKER};
+	char buf[8192];
+	size_t len;
+	FILE *fp;
+
+	ev = ptest_events_open(COORDINATOR_TEST_EVENTS);
+	ck_assert(ev != NULL);
+
+	memset(&opts, 0, sizeof(opts));
+	opts.dirs = dirs;
+	opts.dirs_no = 1;
+	opts.timeout = 5;
+	opts.callbacks = &ev->callbacks;
+
+	head = get_available_ptests_dirs(dirs, 1, NULL, stderr);
+	run = coordinator_list(head, ptests, 2);
+
+	fp = fopen("/dev/null", "w");
+	ck_assert_int_eq(ptest_coordinator_run(run, &opts, workers, 2,
+				"coordinator", fp), 0);
+	fclose(fp);
+	ptest_events_close(ev);
+
+	/* Only the coordinator reports, not the forked workers as well. */
+	fp = fopen(COORDINATOR_TEST_EVENTS, "r");
+	ck_assert(fp != NULL);
+	len = fread(buf, 1, sizeof(buf) - 1, fp);
+	buf[len] = '\0';
+	fclose(fp);
+	ck_assert_int_eq(count_events(buf, "\"event\":\"run_start\""), 1);
+	ck_assert_int_eq(count_events(buf, "\"event\":\"ptest_start\""), 2);
+	ck_assert_int_eq(count_events(buf, "\"event\":\"ptest_end\""), 2);
+	ck_assert_int_eq(count_events(buf, "\"event\":\"run_end\""), 1);
+
+	unlink(COORDINATOR_TEST_EVENTS);
+	ptest_list_free_all(run);
+	ptest_list_free_all(head);
+}
+END_TEST
+
+static void
+write_script(const char *path, const char *content)
+{
+	FILE *fp = fopen(path, "w");
+
+	ck_assert(fp != NULL);
+	fprintf(fp, "#!/bin/sh\n%s\n", content);
+	fclose(fp);
+	ck_assert(chmod(path, 0755) == 0);
+}
+
+START_TEST(test_coordinator_depends)
+{
+	struct ptest_list *head, *run;
+	struct ptest_options opts;
+	struct ptest_config cfg;
+	char *dirs[] = {"./tests/data"};
+	char *ptests[] = {"fail", "gcc", "glibc", "python"};
+	char *workers[] = {COORDINATOR_LOCAL_WORKER, COORDINATOR_LOCAL_WORKER};
+	char *buf, trace[64];
+	size_t size, i;
+	FILE *fp;
+
+	mkdir(COORDINATOR_TEST_FIXTURES, 0755);
+	mkdir(COORDINATOR_TEST_FIXTURES "/svc", 0755);
+	write_script(COORDINATOR_TEST_FIXTURES "/svc/setup", "echo setup >> ../trace");
+	write_script(COORDINATOR_TEST_FIXTURES "/svc/teardown", "echo teardown >> ../trace");
+
+	memset(&cfg, 0, sizeof(cfg));
+	ck_assert(ptest_config_add(&cfg, "python", "depends", "fail") == 0);
+	ck_assert(ptest_config_add(&cfg, "gcc", "fixtures", "svc") == 0);
+	ck_assert(ptest_config_add(&cfg, "glibc", "fixtures", "svc") == 0);
+
+	memset(&opts, 0, sizeof(opts));
+	opts.dirs = dirs;
+	opts.dirs_no = 1;
+	opts.timeout = 5;
+	opts.config = &cfg;
+	opts.fixtures = COORDINATOR_TEST_FIXTURES;
+
+	head = get_available_ptests_dirs(dirs, 1, NULL, stderr);
+	run = coordinator_list(head, ptests, 4);
+
+	/* python waits for fail instead of running beside it, then skips. */
+	fp = open_memstream(&buf, &size);
+	ck_assert_int_eq(ptest_coordinator_run(run, &opts, workers, 2,
+				"coordinator", fp), 1);
+	fclose(fp);
+	ck_assert_int_eq(ptest_list_search(run, "python")->status,
+			PTEST_STATUS_NOTRUN);
+	ck_assert(strstr(buf, "SKIPPED: ") != NULL);
+	ck_assert(strstr(strstr(buf, "SKIPPED: "), "/tests/data/python/ptest\n") != NULL);
+	ck_assert_int_eq(ptest_list_search(run, "gcc")->status, PTEST_STATUS_PASS);
+	ck_assert_int_eq(ptest_list_search(run, "glibc")->status, PTEST_STATUS_PASS);
+	free(buf);
+
+	/* One setup and teardown for both workers. */
+	fp = fopen(COORDINATOR_TEST_FIXTURES "/trace", "r");
+	ck_assert(fp != NULL);
+	size = fread(trace, 1, sizeof(trace) - 1, fp);
+	trace[size] = '\0';
+	fclose(fp);
+	ck_assert_str_eq(trace, "setup\nteardown\n");
+
+	ptest_list_free_all(run);
+	ptest_list_free_all(head);
+	for (i = 0; i < (size_t) cfg.entries_no; i++) {
+		free(cfg.entries[i].ptest);
+		free(cfg.entries[i].key);
+		free(cfg.entries[i].value);
+	}
+	free(cfg.entries);
+	unlink(COORDINATOR_TEST_FIXTURES "/trace");
+	unlink(COORDINATOR_TEST_FIXTURES "/svc/setup");
+	unlink(COORDINATOR_TEST_FIXTURES "/svc/teardown");
+	rmdir(COORDINATOR_TEST_FIXTURES "/svc");
+	rmdir(COORDINATOR_TEST_FIXTURES);
+}
+END_TEST
+
+START_TEST(test_coordinator_worker_lost)
+{
+	struct ptest_list *head, *run;
+	struct ptest_options opts;
+	char *dirs[] = {"./tests/data"};
+	char *ptests[] = {"gcc", "python"};
+	/* Takes the first ptest and goes away without a result. */
+	char *workers[] = {"echo ready; read line"};
+	char *buf;
+	size_t size;
+	FILE *fp;
+
+	memset(&opts, 0, sizeof(opts));
+	opts.dirs = dirs;
+	opts.dirs_no = 1;
+	opts.timeout = 5;
+
+	head = get_available_ptests_dirs(dirs, 1, NULL, stderr);
+	run = coordinator_list(head, ptests, 2);
+
+	fp = open_memstream(&buf, &size);
+	ck_assert_int_eq(ptest_coordinator_run(run, &opts, workers, 1,
+				"coordinator", fp), 2);
+	fclose(fp);
+
+	ck_assert(strstr(buf, "exited while running gcc\n") != NULL);
+	ck_assert(strstr(strstr(buf, "SKIPPED: "), "/tests/data/python/ptest\n") != NULL);
+	ck_assert_int_eq(run->next->status, PTEST_STATUS_FAIL);
+
+	free(buf);
+	ptest_list_free_all(run);
+	ptest_list_free_all(head);
+}
+END_TEST
+
+START_TEST(test_coordinator_fail_fast)
+{
+	struct ptest_list *head, *run;
+	struct ptest_options opts;
+	char *dirs[] = {"./tests/data"};
+	char *ptests[] = {"fail", "hang"};
+	char *workers[] = {COORDINATOR_LOCAL_WORKER, COORDINATOR_LOCAL_WORKER};
+	int64_t start;
+	char *buf;
+	size_t size;
+	FILE *fp;
+
+	memset(&opts, 0, sizeof(opts));
+	opts.dirs = dirs;
+	opts.dirs_no = 1;
+	opts.timeout = 60;
+	opts.fail_fast = 1;
+
+	head = get_available_ptests_dirs(dirs, 1, NULL, stderr);
+	run = coordinator_list(head, ptests, 2);
+
+	/* hang does not keep running on the other worker after fail. */
+	start = ptest_clock_ms();
+	fp = open_memstream(&buf, &size);
+	ck_assert_int_eq(ptest_coordinator_run(run, &opts, workers, 2,
+				"coordinator", fp), 1);
+	fclose(fp);
+	ck_assert(ptest_clock_ms() - start < 30 * 1000);
+
+	ck_assert_int_eq(ptest_list_search(run, "hang")->status,
+			PTEST_STATUS_NOTRUN);
+	ck_assert(strstr(buf, "SKIPPED: ") != NULL);
+	ck_assert(strstr(strstr(buf, "SKIPPED: "), "/tests/data/hang/ptest\n") != NULL);
+
+	free(buf);
+	ptest_list_free_all(run);
+	ptest_list_free_all(head);
+}
+END_TEST
+
+Suite *
+coordinator_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("coordinator");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_coordinator_run);
+	tcase_add_test(tc_core, test_coordinator_callbacks_once);
+	tcase_add_test(tc_core, test_coordinator_worker_lost);
+	tcase_add_test(tc_core, test_coordinator_depends);
+	tcase_add_test(tc_core, test_coordinator_fail_fast);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -0,0 +1,213 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <check.h>
+
+#include "events.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+extern Suite *events_suite(void);
+
+#define EVENTS_TEST_FILE "./test.events"
+#define EVENTS_TEST_BUF_SIZE 8192
+
+START_TEST(test_events_stream)
+{
+	struct ptest_list *head, *filtered;
+	struct ptest_options opts;
+	struct ptest_events *ev;
+	char *ptests[] = {"gcc", "fail"};
+	char line[EVENTS_TEST_BUF_SIZE];
+	const char *expected[] = {
+		"{\"event\":\"run_start\"",
+		"{\"event\":\"ptest_start\"",
+		"{\"event\":\"ptest_end\"",
+		"{\"event\":\"ptest_start\"",
+		"{\"event\":\"ptest_end\"",
+		"{\"event\":\"run_end\"",
+		NULL
+	};
+	FILE *fp, *out;
+	int i;
+
+	memset(&opts, 0, sizeof(opts));
+	opts.timeout = 1;
+
+	ck_assert(ptest_events_open("/nonexistent/dir/events") == NULL);
+
+	ev = ptest_events_open(EVENTS_TEST_FILE);
+	ck_assert(ev != NULL);
+	opts.callbacks = &ev->callbacks;
+
+	head = get_available_ptests("./tests/data");
+	filtered = filter_ptests(head, ptests, 2);
+	out = fopen("/dev/null", "w");
+	ck_assert(run_ptests(filtered, &opts, "events", out, out) == 1);
+	fclose(out);
+	ptest_events_close(ev);
+
+	fp = fopen(EVENTS_TEST_FILE, "r");
+	ck_assert(fp != NULL);
+	for (i = 0; expected[i] != NULL; i++) {
+		ck_assert(fgets(line, sizeof(line), fp) != NULL);
+		ck_assert(strncmp(line, expected[i], strlen(expected[i])) == 0);
+		ck_assert(line[strlen(line) - 1] == '\n');
+		if (i == 4) {
+			ck_assert(strstr(line, "\"ptest\":\"fail\"") != NULL);
+			ck_assert(strstr(line, "\"status\":\"fail\",\"exit_code\":10") != NULL);
+		}
+	}
+	ck_assert(fgets(line, sizeof(line), fp) == NULL);
+	fclose(fp);
+
+	ptest_list_free_all(filtered);
+	ptest_list_free_all(head);
+	unlink(EVENTS_TEST_FILE);
+}
+END_TEST
+
+static int64_t
+fake_clock_ms(void *data)
+{
+	return *(int64_t *) data;
+}
+
+static int64_t
+fake_wall_ms(void *data)
+{
+	return 1500000000000 + *(int64_t *) data;
+}
+
+START_TEST(test_events_backend)
+{
+	struct ptest_backend be;
+	struct ptest_events *ev;
+	char line[EVENTS_TEST_BUF_SIZE];
+	int64_t now = 250;
+	FILE *fp;
+
+	memset(&be, 0, sizeof(be));
+	be.clock_ms = fake_clock_ms;
+	be.wall_ms = fake_wall_ms;
+	be.data = &now;
+
+	/* Stamps and durations follow the clocks of the run. */
+	ev = ptest_events_open(EVENTS_TEST_FILE);
+	ck_assert(ev != NULL);
+	ev->backend = &be;
+	ev->callbacks.run_start(ev, 0);
+	now += 30000;
+	ev->callbacks.run_end(ev, 0, 0);
+	ptest_events_close(ev);
+
+	fp = fopen(EVENTS_TEST_FILE, "r");
+	ck_assert(fp != NULL);
+	ck_assert(fgets(line, sizeof(line), fp) != NULL);
+	ck_assert(strstr(line, "\"time\":1500000000.250,") != NULL);
+	ck_assert(fgets(line, sizeof(line), fp) != NULL);
+	ck_assert(strstr(line, "\"time\":1500000030.250,") != NULL);
+	ck_assert(strstr(line, "\"duration_ms\":30000}") != NULL);
+	fclose(fp);
+	unlink(EVENTS_TEST_FILE);
+}
+END_TEST
+
+START_TEST(test_events_slots)
+{
+	struct ptest_list *head, *a, *b;
+	struct ptest_events *ev;
+	char line[EVENTS_TEST_BUF_SIZE];
+	FILE *fp;
+
+	head = ptest_list_alloc();
+	a = ptest_list_add(head, strdup("gcc"), strdup("/gcc/ptest/run-ptest"));
+	b = ptest_list_add(head, strdup("glibc"), strdup("/glibc/ptest/run-ptest"));
+	ck_assert(a != NULL && b != NULL);
+	a->slot = 1;
+
+	/* Output of ptests running side by side is counted apart. */
+	ev = ptest_events_open(EVENTS_TEST_FILE);
+	ck_assert(ev != NULL);
+	ev->callbacks.start(ev, a, 10);
+	ev->callbacks.start(ev, b, 11);
+	ev->callbacks.output(ev, a, 0, "gcc\n", 4);
+	ev->callbacks.output(ev, b, 1, "glibc failed\n", 13);
+	ev->callbacks.end(ev, a);
+	ev->callbacks.end(ev, b);
+	ptest_events_close(ev);
+
+	fp = fopen(EVENTS_TEST_FILE, "r");
+	ck_assert(fp != NULL);
+	ck_assert(fgets(line, sizeof(line), fp) != NULL);
+	ck_assert(strstr(line, "\"slot\":1,") != NULL);
+	ck_assert(fgets(line, sizeof(line), fp) != NULL);
+	ck_assert(strstr(line, "\"slot\":0,") != NULL);
+	ck_assert(fgets(line, sizeof(line), fp) != NULL);
+	ck_assert(strstr(line, "\"ptest\":\"gcc\",\"slot\":1,") != NULL);
+	ck_assert(strstr(line, "\"output_bytes\":4}") != NULL);
+	ck_assert(fgets(line, sizeof(line), fp) != NULL);
+	ck_assert(strstr(line, "\"ptest\":\"glibc\",\"slot\":0,") != NULL);
+	ck_assert(strstr(line, "\"output_bytes\":13}") != NULL);
+	fclose(fp);
+	unlink(EVENTS_TEST_FILE);
+	ptest_list_free_all(head);
+}
+END_TEST
+
+START_TEST(test_json_print_string)
+{
+	char *buf;
+	size_t size;
+	FILE *fp = open_memstream(&buf, &size);
+
+	json_print_string(fp, "a\"b\\c\n\x01", 7);
+	fclose(fp);
+	ck_assert_str_eq(buf, "\"a\\\"b\\\\c\\n\\u0001\"");
+	free(buf);
+}
+END_TEST
+
+Suite *
+events_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("events");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_events_stream);
+	tcase_add_test(tc_core, test_events_backend);
+	tcase_add_test(tc_core, test_events_slots);
+	tcase_add_test(tc_core, test_json_print_string);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
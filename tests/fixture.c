@@ -0,0 +1,321 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <check.h>
+
+#include "config.h"
+#include "fixture.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+extern Suite *fixture_suite(void);
+
+#define FIXTURE_TEST_DIR "./test.fixtures"
+
+static struct ptest_list *
+fixture_list(const char **names, size_t names_no)
+{
+	struct ptest_list *head = ptest_list_alloc();
+	char path[64];
+	size_t i;
+
+	for (i = 0; i < names_no; i++) {
+		snprintf(path, sizeof(path), "./tests/data/%s/ptest/run-ptest", names[i]);
+		ck_assert(ptest_list_add(head, strdup(names[i]), strdup(path)) != NULL);
+	}
+
+	return head;
+}
+
+static void
+write_script(const char *path, const char *content)
+{
+	FILE *fp = fopen(path, "w");
+
+	ck_assert(fp != NULL);
+	fprintf(fp, "#!/bin/sh\n%s\n", content);
+	fclose(fp);
+	ck_assert(chmod(path, 0755) == 0);
+}
+
+#define FAKE_PID 4343
+
+/* A setup that never exits, waiting for it only moves the clock. */
+struct fake_setup {
+	int64_t now;
+	int alive;
+	int padding1;
+	char path[64];
+};
+
+static int64_t
+fake_clock_ms(void *data)
+{
+	return ((struct fake_setup *) data)->now;
+}
+
+static pid_t
+fake_spawn(void *data, const struct ptest_list *p, int fd_out, int fd_err)
+{
+	struct fake_setup *s = data;
+
+	snprintf(s->path, sizeof(s->path), "%s", p->run_ptest);
+	s->alive = 1;
+
+	return FAKE_PID;
+}
+
+static int
+fake_poll(void *data, struct pollfd *fds, nfds_t nfds, int timeout)
+{
+	((struct fake_setup *) data)->now += timeout;
+
+	return 0;
+}
+
+static int
+fake_kill(void *data, pid_t pid, int sig)
+{
+	ck_assert_int_eq(pid, -FAKE_PID);
+	((struct fake_setup *) data)->alive = 0;
+
+	return 0;
+}
+
+static pid_t
+fake_wait(void *data, pid_t pid, int *status, int options, struct rusage *ru)
+{
+	struct fake_setup *s = data;
+
+	if (s->alive && (options & WNOHANG))
+		return 0;
+	ck_assert(!s->alive);
+	*status = SIGKILL;
+
+	return pid;
+}
+
+START_TEST(test_depends_order)
+{
+	const char *names[] = {"bash", "fail", "gcc", "python"};
+	const char *expected[] = {"fail", "python", "gcc", "bash"};
+	struct ptest_config cfg;
+	struct ptest_list *head, *p, *prev;
+	char *buf;
+	size_t size, i;
+	FILE *fp;
+
+	memset(&cfg, 0, sizeof(cfg));
+	ck_assert(ptest_config_add(&cfg, "bash", "depends", "fail,gcc") == 0);
+	ck_assert(ptest_config_add(&cfg, "gcc", "depends", "python") == 0);
+	/* Not in the list, nothing to wait for. */
+	ck_assert(ptest_config_add(&cfg, "python", "depends", "glibc") == 0);
+
+	head = fixture_list(names, 4);
+	ck_assert_int_eq(ptest_depends_order(head, &cfg, stderr), 0);
+	i = 0;
+	prev = head;
+	PTEST_LIST_ITERATE_START(head, p)
+		ck_assert_str_eq(p->ptest, expected[i++]);
+		ck_assert(p->prev == prev);
+		prev = p;
+	PTEST_LIST_ITERATE_END
+	ck_assert_int_eq(i, 4);
+
+	/* A cycle is reported and the order left alone. */
+	ck_assert(ptest_config_add(&cfg, "python", "depends", "bash") == 0);
+	fp = open_memstream(&buf, &size);
+	ck_assert_int_eq(ptest_depends_order(head, &cfg, fp), -1);
+	fclose(fp);
+	ck_assert_str_eq(buf, "ERROR: Dependency cycle between python gcc bash\n");
+	ck_assert_str_eq(head->next->ptest, "fail");
+	free(buf);
+
+	ptest_list_free_all(head);
+	for (i = 0; i < (size_t) cfg.entries_no; i++) {
+		free(cfg.entries[i].ptest);
+		free(cfg.entries[i].key);
+		free(cfg.entries[i].value);
+	}
+	free(cfg.entries);
+}
+END_TEST
+
+START_TEST(test_fixtures_run)
+{
+	char *names[] = {"fail", "gcc", "python", "glibc", "bash"};
+	struct ptest_options opts;
+	struct ptest_config cfg;
+	struct ptest_list *head, *run;
+	char *buf, *bash, trace[64];
+	size_t size, i;
+	FILE *fp;
+
+	mkdir(FIXTURE_TEST_DIR, 0755);
+	mkdir(FIXTURE_TEST_DIR "/svc", 0755);
+	write_script(FIXTURE_TEST_DIR "/svc/setup", "echo setup >> ../trace");
+	write_script(FIXTURE_TEST_DIR "/svc/teardown", "echo teardown >> ../trace");
+
+	memset(&cfg, 0, sizeof(cfg));
+	ck_assert(ptest_config_add(&cfg, "gcc", "fixtures", "svc") == 0);
+	ck_assert(ptest_config_add(&cfg, "python", "fixtures", "svc") == 0);
+	ck_assert(ptest_config_add(&cfg, "bash", "depends", "fail") == 0);
+	ck_assert(ptest_config_add(&cfg, "glibc", "fixtures", "svc,broken") == 0);
+
+	memset(&opts, 0, sizeof(opts));
+	opts.timeout = 5;
+	opts.config = &cfg;
+	opts.fixtures = FIXTURE_TEST_DIR;
+
+	/*
+	 * fail fails, bash is skipped for it, glibc is not run but fails
+	 * as it has no broken fixture.
+	 */
+	head = get_available_ptests("./tests/data");
+	run = filter_ptests(head, names, 5);
+	fp = open_memstream(&buf, &size);
+	ck_assert_int_eq(run_ptests(run, &opts, "fixtures", fp, fp), 2);
+	fclose(fp);
+	ck_assert_int_eq(ptest_list_search(run, "glibc")->status, PTEST_STATUS_FAIL);
+
+	/* Set up once for gcc, kept until glibc, the last that wanted it. */
+	fp = fopen(FIXTURE_TEST_DIR "/trace", "r");
+	ck_assert(fp != NULL);
+	size = fread(trace, 1, sizeof(trace) - 1, fp);
+	trace[size] = '\0';
+	fclose(fp);
+	ck_assert_str_eq(trace, "setup\nteardown\n");
+
+	ck_assert(strstr(buf, "FIXTURE: setup svc\n") < strstr(buf, "/tests/data/gcc/ptest\n"));
+	ck_assert(strstr(buf, "ERROR: Fixture broken has no ") != NULL);
+	ck_assert(strstr(buf, "FIXTURE: teardown svc\n") > strstr(buf, "/tests/data/glibc/ptest\n"));
+	ck_assert(strstr(buf, "FIXTURE: teardown svc\n") < strstr(buf, "/tests/data/bash/ptest\n"));
+	bash = strstr(buf, "/tests/data/bash/ptest\n");
+	while (bash > buf && bash[-1] != '\n')
+		bash--;
+	ck_assert(strncmp(bash, "SKIPPED: ", 9) == 0);
+	free(buf);
+	ptest_list_free_all(run);
+
+	/* A run where only a fixture failed is not green. */
+	run = filter_ptests(head, &names[3], 1);
+	fp = open_memstream(&buf, &size);
+	ck_assert_int_eq(run_ptests(run, &opts, "fixtures", fp, fp), 1);
+	fclose(fp);
+	free(buf);
+
+	ptest_list_free_all(run);
+	ptest_list_free_all(head);
+	for (i = 0; i < (size_t) cfg.entries_no; i++) {
+		free(cfg.entries[i].ptest);
+		free(cfg.entries[i].key);
+		free(cfg.entries[i].value);
+	}
+	free(cfg.entries);
+	unlink(FIXTURE_TEST_DIR "/trace");
+	unlink(FIXTURE_TEST_DIR "/svc/setup");
+	unlink(FIXTURE_TEST_DIR "/svc/teardown");
+	rmdir(FIXTURE_TEST_DIR "/svc");
+	rmdir(FIXTURE_TEST_DIR);
+}
+END_TEST
+
+START_TEST(test_fixtures_backend)
+{
+	const char *names[] = {"gcc"};
+	struct ptest_backend be;
+	struct ptest_fixtures fx;
+	struct ptest_config cfg;
+	struct fake_setup s;
+	struct ptest_list *head;
+	char *buf;
+	size_t size, i;
+	FILE *fp;
+
+	mkdir(FIXTURE_TEST_DIR, 0755);
+	mkdir(FIXTURE_TEST_DIR "/svc", 0755);
+	write_script(FIXTURE_TEST_DIR "/svc/setup", "sleep 60");
+
+	memset(&cfg, 0, sizeof(cfg));
+	ck_assert(ptest_config_add(&cfg, "gcc", "fixtures", "svc") == 0);
+
+	memset(&s, 0, sizeof(s));
+	memset(&be, 0, sizeof(be));
+	be.clock_ms = fake_clock_ms;
+	be.spawn = fake_spawn;
+	be.poll = fake_poll;
+	be.kill = fake_kill;
+	be.wait = fake_wait;
+	be.data = &s;
+
+	/* The timeout passes on the backend clock, not the real one. */
+	head = fixture_list(names, 1);
+	fp = open_memstream(&buf, &size);
+	ptest_fixtures_init(&fx, FIXTURE_TEST_DIR, &cfg, 2, &be);
+	ck_assert_int_eq(ptest_fixtures_acquire(&fx, head->next, fp), -1);
+	ptest_fixtures_free(&fx);
+	fclose(fp);
+
+	ck_assert_str_eq(s.path, FIXTURE_TEST_DIR "/svc/setup");
+	ck_assert(s.now >= 2000 && s.now < 2000 + FIXTURE_POLL_MS);
+	ck_assert(strstr(buf, "ERROR: Fixture svc setup timed out after 2 seconds\n") != NULL);
+	free(buf);
+
+	ptest_list_free_all(head);
+	for (i = 0; i < (size_t) cfg.entries_no; i++) {
+		free(cfg.entries[i].ptest);
+		free(cfg.entries[i].key);
+		free(cfg.entries[i].value);
+	}
+	free(cfg.entries);
+	unlink(FIXTURE_TEST_DIR "/svc/setup");
+	rmdir(FIXTURE_TEST_DIR "/svc");
+	rmdir(FIXTURE_TEST_DIR);
+}
+END_TEST
+
+Suite *
+fixture_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("fixture");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_depends_order);
+	tcase_add_test(tc_core, test_fixtures_run);
+	tcase_add_test(tc_core, test_fixtures_backend);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <check.h>
+
+#include "history.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+extern Suite *history_suite(void);
+
+#define HISTORY_TEST_FILE "./test.history"
+
+START_TEST(test_history_save_load)
+{
+	struct ptest_history *h;
+	struct ptest_history_entry *e;
+	struct ptest_list *head, *p;
+	int i;
+
+	unlink(HISTORY_TEST_FILE);
+
+	h = ptest_history_load(HISTORY_TEST_FILE);
+	ck_assert(h != NULL);
+	ck_assert_int_eq(h->entries_no, 0);
+
+	head = ptest_list_alloc();
+	p = ptest_list_add(head, strdup("gcc"), strdup("/gcc/ptest/run-ptest"));
+	ck_assert(p != NULL);
+	ck_assert(ptest_list_add(head, strdup("glibc"), strdup("/glibc/ptest/run-ptest")) != NULL);
+
+	/* glibc never ran, no sample. */
+	p->status = PTEST_STATUS_PASS;
+	for (i = 1; i <= PTEST_HISTORY_MAX_SAMPLES + 5; i++) {
+		p->duration_ms = i * 100;
+		ptest_history_update(h, head);
+	}
+	ck_assert(ptest_history_save(h) == 0);
+	ptest_history_free(h);
+	ptest_list_free_all(head);
+
+	h = ptest_history_load(HISTORY_TEST_FILE);
+	ck_assert(h != NULL);
+	ck_assert(ptest_history_find(h, "glibc") == NULL);
+	e = ptest_history_find(h, "gcc");
+	ck_assert(e != NULL);
+	ck_assert_int_eq(e->samples_no, PTEST_HISTORY_MAX_SAMPLES);
+	ck_assert_int_eq(e->samples[0].duration_ms, 600);
+	ck_assert_int_eq(ptest_history_percentile(e, 99), 2500);
+	ck_assert_int_eq(ptest_history_percentile(e, 50), 1500);
+
+	/* Failures don't count as durations. */
+	e->samples_no = PTEST_HISTORY_MIN_SAMPLES;
+	e->samples[0].status = PTEST_STATUS_FAIL;
+	ck_assert_int_eq(ptest_history_percentile(e, 99), -1);
+
+	ptest_history_free(h);
+	unlink(HISTORY_TEST_FILE);
+}
+END_TEST
+
+START_TEST(test_history_adaptive_deadline)
+{
+	struct ptest_list *head, *filtered;
+	struct ptest_options opts;
+	char *ptests[] = {"hang"};
+	FILE *fp, *out;
+
+	fp = fopen(HISTORY_TEST_FILE, "w");
+	ck_assert(fp != NULL);
+	fprintf(fp, "hang 1 1 0 100 0\nhang 2 1 0 200 0\nhang 3 1 0 150 0\n");
+	fclose(fp);
+
+	memset(&opts, 0, sizeof(opts));
+	opts.timeout = 10;
+	opts.history = ptest_history_load(HISTORY_TEST_FILE);
+	opts.adaptive_factor = 2;
+	opts.adaptive_floor = 1;
+	ck_assert(opts.history != NULL);
+
+	head = get_available_ptests("./tests/data");
+	filtered = filter_ptests(head, ptests, 1);
+	out = fopen("/dev/null", "w");
+	ck_assert(run_ptests(filtered, &opts, "history", out, out) > 0);
+	fclose(out);
+
+	/* p99 of 200ms times 2 rounds up to the 1s floor. */
+	ck_assert_int_eq(filtered->next->timedout, PTEST_TIMEOUT_DEADLINE);
+	ck_assert(filtered->next->duration_ms < 3000);
+
+	ptest_list_free_all(filtered);
+	ptest_list_free_all(head);
+	ptest_history_free(opts.history);
+	unlink(HISTORY_TEST_FILE);
+}
+END_TEST
+
+Suite *
+history_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("history");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_history_save_load);
+	tcase_add_test(tc_core, test_history_adaptive_deadline);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -32,9 +32,45 @@ typedef Suite *(SuiteFunction)(void);
 
 extern Suite *ptest_list_suite(void);
 extern Suite *utils_suite(void);
+extern Suite *cache_suite(void);
+extern Suite *server_suite(void);
+extern Suite *events_suite(void);
+extern Suite *report_suite(void);
+extern Suite *pool_suite(void);
+extern Suite *config_suite(void);
+extern Suite *history_suite(void);
+extern Suite *admission_suite(void);
+extern Suite *cgroup_suite(void);
+extern Suite *sandbox_suite(void);
+extern Suite *capture_suite(void);
+extern Suite *archive_suite(void);
+extern Suite *metrics_suite(void);
+extern Suite *compare_suite(void);
+extern Suite *budget_suite(void);
+extern Suite *prefetch_suite(void);
+extern Suite *fixture_suite(void);
+extern Suite *coordinator_suite(void);
 static SuiteFunction *suites[] = {
 	&ptest_list_suite,
 	&utils_suite,
+	&cache_suite,
+	&server_suite,
+	&events_suite,
+	&report_suite,
+	&pool_suite,
+	&config_suite,
+	&history_suite,
+	&admission_suite,
+	&cgroup_suite,
+	&sandbox_suite,
+	&capture_suite,
+	&archive_suite,
+	&metrics_suite,
+	&compare_suite,
+	&budget_suite,
+	&prefetch_suite,
+	&fixture_suite,
+	&coordinator_suite,
 	NULL,
 };
 
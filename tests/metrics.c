@@ -0,0 +1,181 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <check.h>
+
+#include "metrics.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+extern Suite *metrics_suite(void);
+
+#define METRICS_TEST_FILE "./test.prom"
+#define METRICS_TEST_BUF_SIZE 16384
+
+static void
+read_metrics(char *buf, size_t size)
+{
+	FILE *fp;
+	size_t n;
+
+	fp = fopen(METRICS_TEST_FILE, "r");
+	ck_assert(fp != NULL);
+	n = fread(buf, 1, size - 1, fp);
+	buf[n] = '\0';
+	fclose(fp);
+}
+
+START_TEST(test_metrics_file)
+{
+	struct ptest_list *head, *filtered;
+	struct ptest_options opts;
+	struct ptest_metrics *m;
+	struct ptest_stats stats;
+	char *ptests[] = {"gcc", "fail"};
+	char buf[METRICS_TEST_BUF_SIZE];
+	FILE *out;
+
+	memset(&opts, 0, sizeof(opts));
+	memset(&stats, 0, sizeof(stats));
+	opts.timeout = 1;
+	opts.stats = &stats;
+
+	m = ptest_metrics_open(METRICS_TEST_FILE);
+	ck_assert(m != NULL);
+	opts.callbacks = &m->callbacks;
+
+	head = get_available_ptests("./tests/data");
+	filtered = filter_ptests(head, ptests, 2);
+	out = fopen("/dev/null", "w");
+	ck_assert(run_ptests(filtered, &opts, "metrics", out, out) == 1);
+	fclose(out);
+
+	read_metrics(buf, sizeof(buf));
+	ck_assert(access(METRICS_TEST_FILE ".tmp", F_OK) == -1);
+	ck_assert(strstr(buf, "# TYPE ptest_runner_ptest_duration_seconds gauge\n") != NULL);
+	ck_assert(strstr(buf, "ptest_runner_ptest_passed{ptest=\"gcc\"} 1\n") != NULL);
+	ck_assert(strstr(buf, "ptest_runner_ptest_passed{ptest=\"fail\"} 0\n") != NULL);
+	ck_assert(strstr(buf, "ptest_runner_ptest_exit_code{ptest=\"fail\"} 10\n") != NULL);
+	ck_assert(strstr(buf, "ptest_runner_ptest_timeout{ptest=\"gcc\"} 0\n") != NULL);
+	ck_assert(strstr(buf, "ptest_runner_running 0\n") != NULL);
+	ck_assert(strstr(buf, "ptest_runner_ptests 2\n") != NULL);
+	ck_assert(strstr(buf, "ptest_runner_ptests_failed 1\n") != NULL);
+	ck_assert(strstr(buf, "ptest_runner_progress_ratio 1\n") != NULL);
+	ck_assert(strstr(buf, "ptest_runner_overhead_seconds{phase=\"spawn\"} ") != NULL);
+
+	/* Label values are escaped. */
+	free(filtered->next->ptest);
+	filtered->next->ptest = strdup("a\"b\\c");
+	ck_assert(ptest_metrics_write(m) == 0);
+	read_metrics(buf, sizeof(buf));
+	ck_assert(strstr(buf, "{ptest=\"a\\\"b\\\\c\"}") != NULL);
+
+	ptest_metrics_close(m);
+	ptest_list_free_all(filtered);
+	ptest_list_free_all(head);
+	unlink(METRICS_TEST_FILE);
+}
+END_TEST
+
+static int64_t
+fake_clock_ms(void *data)
+{
+	return *(int64_t *) data;
+}
+
+static int64_t
+fake_wall_ms(void *data)
+{
+	return *(int64_t *) data;
+}
+
+START_TEST(test_metrics_interval)
+{
+	struct ptest_list *head, *p;
+	struct ptest_backend be;
+	struct ptest_metrics *m;
+	char buf[METRICS_TEST_BUF_SIZE];
+	int64_t now = 0;
+
+	memset(&be, 0, sizeof(be));
+	be.clock_ms = fake_clock_ms;
+	be.wall_ms = fake_wall_ms;
+	be.data = &now;
+
+	head = ptest_list_alloc();
+	p = ptest_list_add(head, strdup("gcc"), strdup("./gcc/ptest/run-ptest"));
+	ck_assert(p != NULL);
+	p->status = PTEST_STATUS_PASS;
+
+	m = ptest_metrics_open(METRICS_TEST_FILE);
+	ck_assert(m != NULL);
+	m->backend = &be;
+	m->callbacks.run_start(m, 3);
+
+	/* Soon after the last write the file is left alone. */
+	now = METRICS_WRITE_INTERVAL_MS - 1;
+	m->callbacks.end(m, p);
+	read_metrics(buf, sizeof(buf));
+	ck_assert(strstr(buf, "{ptest=\"gcc\"}") == NULL);
+
+	now = METRICS_WRITE_INTERVAL_MS;
+	m->callbacks.end(m, p);
+	read_metrics(buf, sizeof(buf));
+	ck_assert(strstr(buf, "ptest_runner_ptest_passed{ptest=\"gcc\"} 1\n") != NULL);
+	ck_assert(strstr(buf, "ptest_runner_progress_ratio 1\n") == NULL);
+
+	/* The end of the run is always written. */
+	now++;
+	m->callbacks.end(m, p);
+	m->callbacks.run_end(m, 3, 0);
+	read_metrics(buf, sizeof(buf));
+	ck_assert(strstr(buf, "ptest_runner_progress_ratio 1\n") != NULL);
+	ck_assert(strstr(buf, "ptest_runner_running 0\n") != NULL);
+
+	ptest_metrics_close(m);
+	ptest_list_free_all(head);
+	unlink(METRICS_TEST_FILE);
+}
+END_TEST
+
+Suite *
+metrics_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("metrics");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_metrics_file);
+	tcase_add_test(tc_core, test_metrics_interval);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <check.h>
+
+#include "pool.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+extern Suite *pool_suite(void);
+
+START_TEST(test_pool_alloc)
+{
+	struct ptest_pool *pool = ptest_pool_create(64);
+	char *a, *b;
+
+	ck_assert(pool != NULL);
+
+	a = ptest_pool_strdup(pool, "abc");
+	ck_assert_str_eq(a, "abc");
+	ck_assert(ptest_pool_owns(pool, a));
+	b = ptest_pool_alloc(pool, 1);
+	ck_assert(b != NULL);
+	ck_assert((size_t) (b - a) % PTEST_POOL_ALIGN == 0);
+
+	ck_assert(ptest_pool_alloc(pool, 64) == NULL);
+	ck_assert(!ptest_pool_owns(pool, &pool));
+	ck_assert(!ptest_pool_owns(NULL, a));
+
+	ptest_pool_destroy(pool);
+}
+END_TEST
+
+START_TEST(test_pool_discovery_budget)
+{
+	char *dirs[] = {"./tests/data"};
+	struct ptest_pool *pool;
+	struct ptest_list *head;
+	int all;
+
+	head = get_available_ptests("./tests/data");
+	ck_assert(head != NULL);
+	all = ptest_list_length(head);
+	ptest_list_free_all(head);
+
+	/* Room for the head and a couple of ptests only. */
+	pool = ptest_pool_create(sizeof(struct ptest_list) * 4);
+	ck_assert(pool != NULL);
+
+	head = get_available_ptests_dirs(dirs, 1, pool, stderr);
+	ck_assert(head != NULL);
+	ck_assert(ptest_list_length(head) > 0);
+	ck_assert(pool->dropped > 0);
+	ck_assert(ptest_list_length(head) < all);
+	ck_assert(pool->used <= pool->size);
+
+	ck_assert(ptest_list_remove(head, head->next->ptest, 1) == NULL);
+	ptest_list_free_all(head);
+
+	ptest_pool_destroy(pool);
+}
+END_TEST
+
+Suite *
+pool_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("pool");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_pool_alloc);
+	tcase_add_test(tc_core, test_pool_discovery_budget);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -0,0 +1,167 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <check.h>
+
+#include "prefetch.h"
+#include "ptest_list.h"
+#include "utils.h"
+
+extern Suite *prefetch_suite(void);
+
+#define PREFETCH_TEST_DIR "./test.prefetch"
+#define PREFETCH_TEST_PROC "./test.prefetch.proc"
+
+static void
+write_file(const char *path, const char *content, size_t size)
+{
+	FILE *fp = fopen(path, "w");
+	size_t i;
+
+	ck_assert(fp != NULL);
+	for (i = 0; i < size; i++)
+		fputc(content[i % strlen(content)], fp);
+	fclose(fp);
+}
+
+static void
+fake_proc(const char *memory_avg10)
+{
+	char buf[256];
+
+	mkdir(PREFETCH_TEST_PROC, 0755);
+	mkdir(PREFETCH_TEST_PROC "/pressure", 0755);
+	snprintf(buf, sizeof(buf), "some avg10=%s avg60=0.00 avg300=0.00 total=1\n",
+			memory_avg10);
+	write_file(PREFETCH_TEST_PROC "/pressure/memory", buf, strlen(buf));
+}
+
+static void
+remove_fake_proc(void)
+{
+	unlink(PREFETCH_TEST_PROC "/pressure/memory");
+	rmdir(PREFETCH_TEST_PROC "/pressure");
+	rmdir(PREFETCH_TEST_PROC);
+}
+
+START_TEST(test_prefetch_dir)
+{
+	mkdir(PREFETCH_TEST_DIR, 0755);
+	mkdir(PREFETCH_TEST_DIR "/sub", 0755);
+	write_file(PREFETCH_TEST_DIR "/run-ptest", "x", 10000);
+	write_file(PREFETCH_TEST_DIR "/sub/data", "y", 10000);
+	fake_proc("0.00");
+
+	ck_assert_int_eq(ptest_prefetch_dir(PREFETCH_TEST_DIR, 1 << 20,
+				PREFETCH_TEST_PROC), 20000);
+	/* The budget cuts the second file short. */
+	ck_assert_int_eq(ptest_prefetch_dir(PREFETCH_TEST_DIR, 15000,
+				PREFETCH_TEST_PROC), 15000);
+	ck_assert_int_eq(ptest_prefetch_dir("/nonexistent/dir", 1 << 20,
+				PREFETCH_TEST_PROC), 0);
+
+	remove_fake_proc();
+	fake_proc("50.00");
+	ck_assert_int_eq(ptest_prefetch_dir(PREFETCH_TEST_DIR, 1 << 20,
+				PREFETCH_TEST_PROC), -1);
+	remove_fake_proc();
+
+	unlink(PREFETCH_TEST_DIR "/sub/data");
+	unlink(PREFETCH_TEST_DIR "/run-ptest");
+	rmdir(PREFETCH_TEST_DIR "/sub");
+	rmdir(PREFETCH_TEST_DIR);
+}
+END_TEST
+
+START_TEST(test_prefetch_window)
+{
+	const char *names[] = {"gcc", "fail", "glibc", "python", "bash"};
+	struct ptest_prefetch *pf;
+	struct ptest_list *head, *p;
+	char path[64];
+	size_t i;
+
+	head = ptest_list_alloc();
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		snprintf(path, sizeof(path), "./tests/data/%s/ptest/run-ptest", names[i]);
+		ck_assert(ptest_list_add(head, strdup(names[i]), strdup(path)) != NULL);
+	}
+
+	pf = ptest_prefetch_open(2);
+	ck_assert(pf != NULL);
+
+	/* Nothing is read ahead while memory is under pressure. */
+	fake_proc("50.00");
+	pf->proc = PREFETCH_TEST_PROC;
+	p = head->next;
+	pf->callbacks.start(pf->callbacks.data, p, 0);
+	ck_assert_int_eq(pf->pid, 0);
+	ck_assert(pf->last == NULL);
+	remove_fake_proc();
+
+	fake_proc("0.00");
+	pf->callbacks.start(pf->callbacks.data, p, 0);
+	ck_assert(pf->pid > 0);
+	ck_assert_str_eq(pf->last->ptest, "glibc");
+	ck_assert(waitpid(pf->pid, NULL, 0) == pf->pid);
+	pf->pid = 0;
+
+	/* Only python is new in the window of fail. */
+	pf->callbacks.start(pf->callbacks.data, p->next, 0);
+	ck_assert(pf->pid > 0);
+	ck_assert_str_eq(pf->last->ptest, "python");
+
+	pf->callbacks.run_end(pf->callbacks.data, 5, 0);
+	ck_assert_int_eq(pf->pid, 0);
+	ck_assert(pf->last == NULL);
+	remove_fake_proc();
+
+	ptest_prefetch_close(pf);
+	ptest_list_free_all(head);
+}
+END_TEST
+
+Suite *
+prefetch_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("prefetch");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_prefetch_dir);
+	tcase_add_test(tc_core, test_prefetch_window);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
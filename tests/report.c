@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <check.h>
+
+#include "ptest_list.h"
+#include "report.h"
+#include "utils.h"
+
+extern Suite *report_suite(void);
+
+#define REPORT_TEST_FILE "./test.report"
+#define REPORT_TEST_BUF_SIZE 8192
+
+static int
+run_report(struct ptest_callbacks *callbacks, char **ptests, int ptests_no)
+{
+	struct ptest_list *head, *filtered;
+	struct ptest_options opts;
+	FILE *out;
+	int rc;
+
+	memset(&opts, 0, sizeof(opts));
+	opts.timeout = 1;
+	opts.callbacks = callbacks;
+
+	head = get_available_ptests("./tests/data");
+	filtered = filter_ptests(head, ptests, ptests_no);
+	out = fopen("/dev/null", "w");
+	rc = run_ptests(filtered, &opts, "report", out, out);
+	fclose(out);
+
+	ptest_list_free_all(filtered);
+	ptest_list_free_all(head);
+
+	return rc;
+}
+
+START_TEST(test_report_tap)
+{
+	struct ptest_reporter *r;
+	char *ptests[] = {"gcc", "fail"};
+	char line[REPORT_TEST_BUF_SIZE];
+	const char *expected[] = {
+		"TAP version 13\n",
+		"1..2\n",
+		"ok 1 - gcc\n",
+		"# duration_ms ",
+		"not ok 2 - fail\n",
+		"# exit status 10\n",
+		"# duration_ms ",
+		NULL
+	};
+	FILE *fp;
+	int i;
+
+	ck_assert(ptest_reporter_open("tap") == NULL);
+	ck_assert(ptest_reporter_open("xunit:" REPORT_TEST_FILE) == NULL);
+
+	r = ptest_reporter_open("tap:" REPORT_TEST_FILE);
+	ck_assert(r != NULL);
+	ck_assert(run_report(&r->callbacks, ptests, 2) == 1);
+	ptest_reporter_close(r);
+
+	fp = fopen(REPORT_TEST_FILE, "r");
+	ck_assert(fp != NULL);
+	for (i = 0; expected[i] != NULL; i++) {
+		ck_assert(fgets(line, sizeof(line), fp) != NULL);
+		ck_assert(strncmp(line, expected[i], strlen(expected[i])) == 0);
+	}
+	ck_assert(fgets(line, sizeof(line), fp) == NULL);
+	fclose(fp);
+
+	unlink(REPORT_TEST_FILE);
+}
+END_TEST
+
+static int junit_checked;
+
+/* Chained after the JUnit reporter, the file must parse after every case. */
+static void
+junit_check_end(void *data, const struct ptest_list *p)
+{
+	char buf[REPORT_TEST_BUF_SIZE];
+	size_t len;
+	FILE *fp;
+
+	fp = fopen(REPORT_TEST_FILE, "r");
+	ck_assert(fp != NULL);
+	len = fread(buf, 1, sizeof(buf) - 1, fp);
+	buf[len] = '\0';
+	fclose(fp);
+
+	ck_assert(strncmp(buf, "<?xml", 5) == 0);
+	ck_assert(len > 13 && strcmp(buf + len - 13, "</testsuite>\n") == 0);
+	ck_assert(strstr(buf, p->ptest) != NULL);
+	junit_checked++;
+}
+
+START_TEST(test_report_junit_streaming)
+{
+	struct ptest_reporter *r;
+	struct ptest_callbacks check = {
+		.end = junit_check_end,
+	};
+	char *ptests[] = {"gcc", "fail", "python"};
+
+	r = ptest_reporter_open("junit:" REPORT_TEST_FILE);
+	ck_assert(r != NULL);
+	r->callbacks.next = &check;
+
+	junit_checked = 0;
+	ck_assert(run_report(&r->callbacks, ptests, 3) == 1);
+	ck_assert_int_eq(junit_checked, 3);
+	ptest_reporter_close(r);
+
+	unlink(REPORT_TEST_FILE);
+}
+END_TEST
+
+START_TEST(test_report_subunit_packet)
+{
+	const unsigned char expected[] = {
+		0xb3, 0x2a, 0x03, 0x0f, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x01, 'a', 0x36, 0x92, 0x74, 0x91
+	};
+	unsigned char buf[REPORT_TEST_BUF_SIZE];
+	char content[1000];
+	size_t len;
+
+	ck_assert_int_eq(subunit_packet(NULL, 0, 3, 0, 0, "a", NULL, NULL, 0),
+			sizeof(expected));
+	len = subunit_packet(buf, sizeof(buf), 3, 0, 0, "a", NULL, NULL, 0);
+	ck_assert_int_eq(len, sizeof(expected));
+	ck_assert(memcmp(buf, expected, len) == 0);
+
+	/* A packet over 63 bytes needs a two bytes length field. */
+	memset(content, 'x', sizeof(content));
+	len = subunit_packet(buf, sizeof(buf), 0, 0, 0, "a", "stdout",
+			content, sizeof(content));
+	ck_assert(buf[3] >> 6 == 1);
+	ck_assert_int_eq(((buf[3] & 0x3f) << 8) | buf[4], len);
+}
+END_TEST
+
+Suite *
+report_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("report");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_report_tap);
+	tcase_add_test(tc_core, test_report_junit_streaming);
+	tcase_add_test(tc_core, test_report_subunit_packet);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -0,0 +1,190 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <limits.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <check.h>
+
+#include "ptest_list.h"
+#include "sandbox.h"
+#include "utils.h"
+
+extern Suite *sandbox_suite(void);
+
+#define SANDBOX_TEST_DIR "./test.sandbox"
+#define SANDBOX_TEST_PTEST SANDBOX_TEST_DIR "/writer/ptest"
+#define SANDBOX_TEST_MARK SANDBOX_TMP "/ptest-sandbox-test"
+
+static void
+make_writer(const char *script)
+{
+	FILE *fp;
+
+	mkdir(SANDBOX_TEST_DIR, 0755);
+	mkdir(SANDBOX_TEST_DIR "/writer", 0755);
+	mkdir(SANDBOX_TEST_PTEST, 0755);
+	fp = fopen(SANDBOX_TEST_PTEST "/run-ptest", "w");
+	ck_assert(fp != NULL);
+	fprintf(fp, "#!/bin/sh\n%s\n", script);
+	fclose(fp);
+	chmod(SANDBOX_TEST_PTEST "/run-ptest", 0755);
+}
+
+static void
+remove_writer(void)
+{
+	unlink(SANDBOX_TEST_PTEST "/out.txt");
+	unlink(SANDBOX_TEST_PTEST "/run-ptest");
+	rmdir(SANDBOX_TEST_PTEST);
+	rmdir(SANDBOX_TEST_DIR "/writer");
+	rmdir(SANDBOX_TEST_DIR);
+}
+
+/* Mount namespaces need CAP_SYS_ADMIN, probe in a throwaway child. */
+static int
+can_sandbox(void)
+{
+	int status;
+	pid_t pid;
+
+	pid = fork();
+	ck_assert(pid != -1);
+	if (pid == 0)
+		_exit(unshare(CLONE_NEWNS) == -1);
+	ck_assert(waitpid(pid, &status, 0) == pid);
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+START_TEST(test_sandbox_run)
+{
+	struct ptest_list *head;
+	struct ptest_options opts;
+	char *buf;
+	size_t size;
+	FILE *fp;
+	int rc;
+
+	make_writer("echo data > out.txt && cat out.txt && "
+			"touch " SANDBOX_TEST_MARK " && echo written");
+	unlink(SANDBOX_TEST_MARK);
+
+	memset(&opts, 0, sizeof(opts));
+	opts.timeout = 5;
+	opts.sandbox = 1;
+
+	head = get_available_ptests(SANDBOX_TEST_DIR);
+	ck_assert_int_eq(ptest_list_length(head), 1);
+	fp = open_memstream(&buf, &size);
+	rc = run_ptests(head, &opts, "sandbox", fp, fp);
+	fclose(fp);
+
+	if (can_sandbox()) {
+		ck_assert_int_eq(rc, 0);
+		ck_assert(strstr(buf, "data\nwritten\n") != NULL);
+	} else {
+		/* Without privileges the ptest fails instead of running unconfined. */
+		ck_assert_int_eq(rc, 1);
+		ck_assert(strstr(buf, "ERROR: Unable to sandbox") != NULL);
+		ck_assert(strstr(buf, "written") == NULL);
+	}
+	ck_assert(access(SANDBOX_TEST_PTEST "/out.txt", F_OK) == -1);
+	ck_assert(access(SANDBOX_TEST_MARK, F_OK) == -1);
+
+	free(buf);
+	ptest_list_free_all(head);
+	remove_writer();
+}
+END_TEST
+
+START_TEST(test_sandbox_netns)
+{
+	struct ptest_list *head;
+	struct ptest_options opts;
+	char host[PATH_MAX], line[PATH_MAX + 16];
+	char *buf;
+	size_t size;
+	ssize_t n;
+	FILE *fp;
+	int rc;
+
+	n = readlink("/proc/self/ns/net", host, sizeof(host) - 1);
+	ck_assert(n > 0);
+	host[n] = '\0';
+
+	/* Interface lines in /proc/net/dev are the only ones with a colon. */
+	make_writer("readlink /proc/self/ns/net && grep -c : /proc/net/dev");
+
+	memset(&opts, 0, sizeof(opts));
+	opts.timeout = 5;
+	opts.netns = 1;
+
+	head = get_available_ptests(SANDBOX_TEST_DIR);
+	fp = open_memstream(&buf, &size);
+	rc = run_ptests(head, &opts, "netns", fp, fp);
+	fclose(fp);
+
+	snprintf(line, sizeof(line), "%s\n", host);
+	if (can_sandbox()) {
+		ck_assert_int_eq(rc, 0);
+		ck_assert(strstr(buf, "net:[") != NULL);
+		ck_assert(strstr(buf, line) == NULL);
+		ck_assert(strstr(buf, "]\n1\n") != NULL);
+	} else {
+		ck_assert_int_eq(rc, 1);
+		ck_assert(strstr(buf, "ERROR: Unable to sandbox") != NULL);
+		ck_assert(strstr(buf, "net:[") == NULL);
+	}
+
+	free(buf);
+	ptest_list_free_all(head);
+	remove_writer();
+}
+END_TEST
+
+Suite *
+sandbox_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("sandbox");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_sandbox_run);
+	tcase_add_test(tc_core, test_sandbox_netns);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -0,0 +1,173 @@
+/**
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * AUTHORS
+ * 	Aníbal Limón <anibal.limon@intel.com>
+ */
+
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <check.h>
+
+#include "events.h"
+#include "server.h"
+#include "utils.h"
+
+extern Suite *server_suite(void);
+
+#define SERVER_TEST_SOCKET "./test.sock"
+#define SERVER_TEST_BUF_SIZE 8192
+#define SERVER_TEST_EVENTS "./test.server.events"
+
+static FILE *
+server_connect(void)
+{
+	struct sockaddr_un addr;
+	int fd, i;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, SERVER_TEST_SOCKET);
+
+	for (i = 0; i < 50; i++) {
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		ck_assert(fd != -1);
+		if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0)
+			return fdopen(fd, "r+");
+		close(fd);
+		usleep(100000);
+	}
+
+	return NULL;
+}
+
+START_TEST(test_server_run)
+{
+	struct ptest_options opts;
+	struct ptest_events *ev;
+	char *dirs[] = {"./tests/data"};
+	char line[SERVER_TEST_BUF_SIZE];
+	FILE *fp;
+	pid_t pid;
+	int status, output = 0;
+
+	/* Jobs leave the reporters of the daemon's options alone. */
+	ev = ptest_events_open(SERVER_TEST_EVENTS);
+	ck_assert(ev != NULL);
+
+	memset(&opts, 0, sizeof(opts));
+	opts.dirs = dirs;
+	opts.dirs_no = 1;
+	opts.timeout = 1;
+	opts.callbacks = &ev->callbacks;
+
+	pid = fork();
+	ck_assert(pid != -1);
+	if (pid == 0) {
+		fclose(stdout);
+		exit(ptest_server_run(&opts, SERVER_TEST_SOCKET, 1, "test_server"));
+	}
+
+	fp = server_connect();
+	ck_assert(fp != NULL);
+
+	fprintf(fp, "status\n");
+	fflush(fp);
+	ck_assert(fgets(line, sizeof(line), fp) != NULL);
+	ck_assert(strstr(line, "\"event\":\"status\"") != NULL);
+	ck_assert(strstr(line, "\"ptests\":7") != NULL);
+
+	fprintf(fp, "run gcc fail\n");
+	fflush(fp);
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		/* The log comes before the end of its ptest. */
+		if (strstr(line, "\"event\":\"output\"") != NULL)
+			output++;
+		if (strstr(line, "\"event\":\"end\"") != NULL)
+			ck_assert(output > 0);
+		if (strstr(line, "\"event\":\"done\"") != NULL)
+			break;
+	}
+	ck_assert(strstr(line, "\"total\":2,\"fail\":1") != NULL);
+
+	fprintf(fp, "run nothere\n");
+	fflush(fp);
+	ck_assert(fgets(line, sizeof(line), fp) != NULL);
+	ck_assert(strstr(line, "\"event\":\"error\"") != NULL);
+
+	fclose(fp);
+	kill(pid, SIGTERM);
+	ck_assert(waitpid(pid, &status, 0) == pid);
+	ck_assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	ck_assert(access(SERVER_TEST_SOCKET, F_OK) == -1);
+
+	ptest_events_close(ev);
+	fp = fopen(SERVER_TEST_EVENTS, "r");
+	ck_assert(fp != NULL);
+	ck_assert(fgets(line, sizeof(line), fp) == NULL);
+	fclose(fp);
+	unlink(SERVER_TEST_EVENTS);
+}
+END_TEST
+
+START_TEST(test_server_not_socket)
+{
+	struct ptest_options opts;
+	char *dirs[] = {"./tests/data"};
+	FILE *fp;
+
+	memset(&opts, 0, sizeof(opts));
+	opts.dirs = dirs;
+	opts.dirs_no = 1;
+
+	/* Some other file in the way is left alone. */
+	fp = fopen(SERVER_TEST_SOCKET, "w");
+	ck_assert(fp != NULL);
+	fclose(fp);
+	ck_assert_int_eq(ptest_server_run(&opts, SERVER_TEST_SOCKET, 1,
+			"test_server"), 1);
+	ck_assert(access(SERVER_TEST_SOCKET, F_OK) == 0);
+	unlink(SERVER_TEST_SOCKET);
+}
+END_TEST
+
+Suite *
+server_suite()
+{
+	Suite *s;
+	TCase *tc_core;
+
+	s = suite_create("server");
+	tc_core = tcase_create("Core");
+
+	tcase_add_test(tc_core, test_server_run);
+	tcase_add_test(tc_core, test_server_not_socket);
+
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
@@ -28,6 +28,8 @@
 #include <errno.h>
 #include <stdbool.h>
 
+#include <sys/wait.h>
+
 #include <check.h>
 
 #include "ptest_list.h"
@@ -73,7 +75,137 @@ find_word(const char *line, const char *word)
 }
 
 static void test_ptest_expected_failure(struct ptest_list *, const unsigned int, char *,
-	void (*h_analyzer)(const int, FILE *));
+	const struct ptest_backend *, void (*h_analyzer)(const int, FILE *));
+
+#define FAKE_PID 4242
+#define FAKE_EPOCH 1500000000
+
+/*
+ * Simulated child for run_ptests(), it writes its output when spawned
+ * and exits after exit_ms of simulated time (never when -1) or when it
+ * is killed. Waiting in poll() only moves the clock forward.
+ */
+struct fake_child {
+	const char *output;
+	int64_t exit_ms;
+	int exit_code;
+	int alive;
+	int fds[2];
+	int status;
+	int kills;
+	int64_t now;
+	int64_t start_ms;
+};
+
+static void
+fake_exit(struct fake_child *c, int status)
+{
+	c->alive = 0;
+	c->status = status;
+	close(c->fds[0]);
+	close(c->fds[1]);
+}
+
+static int64_t
+fake_clock_ms(void *data)
+{
+	return ((struct fake_child *) data)->now;
+}
+
+static int64_t
+fake_clock_us(void *data)
+{
+	return ((struct fake_child *) data)->now * 1000;
+}
+
+static int64_t
+fake_wall_ms(void *data)
+{
+	return (int64_t) FAKE_EPOCH * 1000 + ((struct fake_child *) data)->now;
+}
+
+static pid_t
+fake_spawn(void *data, const struct ptest_list *p, int fd_out, int fd_err)
+{
+	struct fake_child *c = data;
+
+	c->fds[0] = dup(fd_out);
+	c->fds[1] = dup(fd_err);
+	ck_assert(write(c->fds[0], c->output, strlen(c->output)) ==
+			(ssize_t) strlen(c->output));
+	c->alive = 1;
+	c->start_ms = c->now;
+	if (c->exit_ms == 0)
+		fake_exit(c, c->exit_code << 8);
+
+	return FAKE_PID;
+}
+
+static int
+fake_poll(void *data, struct pollfd *fds, nfds_t nfds, int timeout)
+{
+	struct fake_child *c = data;
+	int ret = poll(fds, nfds, 0);
+
+	if (ret != 0)
+		return ret;
+
+	if (c->alive && c->exit_ms > 0 && c->start_ms + c->exit_ms <= c->now + timeout) {
+		c->now = c->start_ms + c->exit_ms;
+		fake_exit(c, c->exit_code << 8);
+		return poll(fds, nfds, 0);
+	}
+	c->now += timeout;
+
+	return 0;
+}
+
+static int
+fake_kill(void *data, pid_t pid, int sig)
+{
+	struct fake_child *c = data;
+
+	ck_assert_int_eq(pid, -FAKE_PID);
+	c->kills++;
+	if (c->alive)
+		fake_exit(c, sig);
+
+	return 0;
+}
+
+static pid_t
+fake_wait(void *data, pid_t pid, int *status, int options, struct rusage *ru)
+{
+	struct fake_child *c = data;
+
+	if (c->alive && (options & WNOHANG))
+		return 0;
+	ck_assert(!c->alive);
+	if (ru != NULL)
+		memset(ru, 0, sizeof(*ru));
+	*status = c->status;
+
+	return pid;
+}
+
+static void
+fake_backend(struct ptest_backend *be, struct fake_child *c,
+		const char *output, int64_t exit_ms, int exit_code)
+{
+	memset(c, 0, sizeof(*c));
+	c->output = output;
+	c->exit_ms = exit_ms;
+	c->exit_code = exit_code;
+
+	be->clock_ms = fake_clock_ms;
+	be->clock_us = fake_clock_us;
+	be->wall_ms = fake_wall_ms;
+	be->spawn = fake_spawn;
+	be->poll = fake_poll;
+	be->kill = fake_kill;
+	be->wait = fake_wait;
+	be->data = c;
+}
 
 START_TEST(test_get_available_ptests)
 {
@@ -88,6 +220,8 @@ START_TEST(test_get_available_ptests)
 		ck_assert(ptest_list_search(head, ptests_not_found[i]) == NULL);
 
 	ptest_list_free_all(head);
+
+	ck_assert(get_available_ptests("/nonexistent/ptests") == NULL);
 }
 END_TEST
 
@@ -189,7 +323,7 @@ START_TEST(test_run_ptests)
 	ptest_list_remove(head, "fail", 1);
 	ptest_list_remove(head, "signal", 1);
 
-	rc = run_ptests(head, opts, "test_run_ptests", fp_stdout, fp_stderr);
+	rc = run_ptests(head, &opts, "test_run_ptests", fp_stdout, fp_stderr);
 	ck_assert(rc == 0);
 	ptest_list_free_all(head);
 
@@ -228,13 +362,86 @@ START_TEST(test_run_timeout_duration_ptest)
 {
 	struct ptest_list *head = get_available_ptests(opts_directory);
 	unsigned int timeout = 1;
+	struct ptest_backend be;
+	struct fake_child c;
 
-	test_ptest_expected_failure(head, timeout, "hang", search_for_timeout_error_and_duration);
+	/* hang on a simulated timeline, killed after a second of silence. */
+	fake_backend(&be, &c, "hang\n", -1, 0);
+	test_ptest_expected_failure(head, timeout, "hang", &be,
+			search_for_timeout_error_and_duration);
+	ck_assert_int_eq(c.now, 1000);
+	ck_assert_int_eq(c.kills, 1);
 
 	ptest_list_free_all(head);
 }
 END_TEST
 
+static int heartbeats;
+
+static void
+count_heartbeat(void *data, const struct ptest_list *p, int64_t elapsed_ms)
+{
+	heartbeats++;
+	ck_assert_int_eq(elapsed_ms, heartbeats * 10000);
+}
+
+START_TEST(test_run_deadline_heartbeat_ptest)
+{
+	struct ptest_list *head = get_available_ptests(opts_directory);
+	struct ptest_list *filtered;
+	struct ptest_options opts = EmptyOpts;
+	struct ptest_callbacks callbacks = {
+		.heartbeat = count_heartbeat,
+	};
+	struct ptest_backend be;
+	struct fake_child c;
+	char *ptests[] = {"hang"};
+	char *buf_stdout;
+	size_t size_stdout = PRINT_PTEST_BUF_SIZE;
+	FILE *fp_stdout;
+
+	fp_stdout = open_memstream(&buf_stdout, &size_stdout);
+	ck_assert(fp_stdout != NULL);
+
+	/* Keeps writing is what the deadline is for, here it never exits. */
+	fake_backend(&be, &c, "hang\n", -1, 0);
+	filtered = filter_ptests(head, ptests, 1);
+	opts.timeout = 100;
+	opts.deadline = 30;
+	opts.heartbeat = 10;
+	opts.callbacks = &callbacks;
+	opts.backend = &be;
+	heartbeats = 0;
+	/* Killed by the signal and timed out, both count. */
+	ck_assert(run_ptests(filtered, &opts, "deadline", fp_stdout, fp_stdout) == 2);
+	fflush(fp_stdout);
+
+	ck_assert_int_eq(heartbeats, 3);
+	ck_assert_int_eq(filtered->next->duration_ms, 30000);
+	ck_assert_int_eq(filtered->next->timedout, PTEST_TIMEOUT_DEADLINE);
+	ck_assert(strstr(buf_stdout, "ERROR: Deadline of 30 seconds exceeded\n") != NULL);
+	ck_assert(strstr(buf_stdout, "DURATION: 30\n") != NULL);
+
+	/* Exits on its own before the inactivity timeout. */
+	fake_backend(&be, &c, "", 5000, 3);
+	opts.deadline = 0;
+	opts.heartbeat = 0;
+	opts.timeout = 10;
+	ck_assert(run_ptests(filtered, &opts, "deadline", fp_stdout, fp_stdout) == 1);
+	fflush(fp_stdout);
+
+	ck_assert_int_eq(filtered->next->duration_ms, 5000);
+	ck_assert_int_eq(filtered->next->timedout, PTEST_TIMEOUT_NONE);
+	ck_assert_int_eq(filtered->next->exit_code, 3);
+	ck_assert(strstr(buf_stdout, "ERROR: Exit status is 3\n") != NULL);
+
+	PTEST_LIST_FREE_ALL_CLEAN(filtered);
+	ptest_list_free_all(head);
+	fclose(fp_stdout);
+	free(buf_stdout);
+}
+END_TEST
+
 static void
 search_for_signal_and_duration(const int rp, FILE *fp_stdout)
 {
@@ -259,7 +466,8 @@ START_TEST(test_run_signal_ptest)
 	struct ptest_list *head = get_available_ptests(opts_directory);
 	unsigned int timeout = 10;
 
-	test_ptest_expected_failure(head, timeout, "signal", search_for_signal_and_duration);
+	test_ptest_expected_failure(head, timeout, "signal", NULL,
+			search_for_signal_and_duration);
 
 	ptest_list_free_all(head);
 }
@@ -289,9 +497,221 @@ START_TEST(test_run_fail_ptest)
 	struct ptest_list *head = get_available_ptests(opts_directory);
 	unsigned int timeout = 1;
 
-	test_ptest_expected_failure(head, timeout, "fail", search_for_fail);
+	test_ptest_expected_failure(head, timeout, "fail", NULL, search_for_fail);
+
+	ptest_list_free_all(head);
+}
+END_TEST
+
+START_TEST(test_run_fail_fast_ptest)
+{
+	struct ptest_list *head = get_available_ptests(opts_directory);
+	struct ptest_list *filtered;
+	struct ptest_options opts = EmptyOpts;
+	char *ptests[] = {"fail", "gcc", "glibc"};
+	char line_buf[PRINT_PTEST_BUF_SIZE];
+	int skipped = 0;
+	char *buf_stdout;
+	size_t size_stdout = PRINT_PTEST_BUF_SIZE;
+	FILE *fp_stdout;
+
+	fp_stdout = open_memstream(&buf_stdout, &size_stdout);
+	ck_assert(fp_stdout != NULL);
+
+	filtered = filter_ptests(head, ptests, 3);
+	ck_assert(ptest_list_length(filtered) == 3);
+
+	opts.timeout = 1;
+	opts.fail_fast = 1;
+	ck_assert(run_ptests(filtered, &opts, "fail-fast", fp_stdout, fp_stdout) == 1);
+
+	while (fgets(line_buf, PRINT_PTEST_BUF_SIZE, fp_stdout) != NULL)
+		if (find_word(line_buf, "SKIPPED"))
+			skipped++;
+	ck_assert_int_eq(skipped, 2);
+	ck_assert(ptest_list_search(filtered, "fail")->status == PTEST_STATUS_FAIL);
+	ck_assert(ptest_list_search(filtered, "gcc")->status == PTEST_STATUS_NOTRUN);
 
+	PTEST_LIST_FREE_ALL_CLEAN(filtered);
 	ptest_list_free_all(head);
+	fclose(fp_stdout);
+	free(buf_stdout);
+}
+END_TEST
+
+struct callback_counts {
+	int run_start;
+	int start;
+	int output;
+	int end;
+	int failed;
+	int run_end;
+};
+
+static void
+count_run_start(void *data, int ptests)
+{
+	((struct callback_counts *) data)->run_start = ptests;
+}
+
+static void
+count_start(void *data, const struct ptest_list *p, pid_t pid)
+{
+	ck_assert(p != NULL && pid > 0);
+	((struct callback_counts *) data)->start++;
+}
+
+static void
+count_output(void *data, const struct ptest_list *p, int stream, const char *buf, size_t len)
+{
+	ck_assert(p != NULL && buf != NULL && len > 0);
+	((struct callback_counts *) data)->output++;
+}
+
+static void
+count_end(void *data, const struct ptest_list *p)
+{
+	struct callback_counts *counts = data;
+
+	counts->end++;
+	if (p->status == PTEST_STATUS_FAIL) {
+		ck_assert_int_eq(p->exit_code, 10);
+		counts->failed++;
+	}
+}
+
+static void
+count_run_end(void *data, int ptests, int failures)
+{
+	((struct callback_counts *) data)->run_end = failures;
+}
+
+START_TEST(test_run_ptests_callbacks)
+{
+	struct ptest_list *head = get_available_ptests(opts_directory);
+	struct ptest_list *filtered;
+	struct ptest_options opts = EmptyOpts;
+	struct callback_counts counts = {0, 0, 0, 0, 0, -1};
+	struct ptest_callbacks callbacks = {
+		.run_start = count_run_start,
+		.start = count_start,
+		.output = count_output,
+		.end = count_end,
+		.run_end = count_run_end,
+		.data = &counts,
+	};
+	char *ptests[] = {"gcc", "fail"};
+	char *buf_stdout;
+	size_t size_stdout = PRINT_PTEST_BUF_SIZE;
+	FILE *fp_stdout;
+
+	fp_stdout = open_memstream(&buf_stdout, &size_stdout);
+	ck_assert(fp_stdout != NULL);
+
+	filtered = filter_ptests(head, ptests, 2);
+	opts.timeout = 1;
+	opts.callbacks = &callbacks;
+	ck_assert(run_ptests(filtered, &opts, "callbacks", fp_stdout, fp_stdout) == 1);
+
+	ck_assert_int_eq(counts.run_start, 2);
+	ck_assert_int_eq(counts.start, 2);
+	ck_assert(counts.output > 0);
+	ck_assert_int_eq(counts.end, 2);
+	ck_assert_int_eq(counts.failed, 1);
+	ck_assert_int_eq(counts.run_end, 1);
+
+	PTEST_LIST_FREE_ALL_CLEAN(filtered);
+	ptest_list_free_all(head);
+	fclose(fp_stdout);
+	free(buf_stdout);
+}
+END_TEST
+
+static int stats_called;
+
+static void
+check_stats(void *data, const struct ptest_stats *st)
+{
+	stats_called++;
+	ck_assert(st->maxrss_kb > 0);
+}
+
+START_TEST(test_run_ptests_stats)
+{
+	struct ptest_list *head = get_available_ptests(opts_directory);
+	struct ptest_list *filtered;
+	struct ptest_options opts = EmptyOpts;
+	struct ptest_stats stats;
+	struct ptest_callbacks callbacks = {
+		.stats = check_stats,
+	};
+	char *ptests[] = {"gcc", "fail"};
+	char *buf_stdout;
+	size_t size_stdout = PRINT_PTEST_BUF_SIZE;
+	FILE *fp_stdout;
+
+	fp_stdout = open_memstream(&buf_stdout, &size_stdout);
+	ck_assert(fp_stdout != NULL);
+
+	memset(&stats, 0, sizeof(stats));
+	filtered = filter_ptests(head, ptests, 2);
+	opts.timeout = 1;
+	opts.callbacks = &callbacks;
+	opts.stats = &stats;
+	stats_called = 0;
+	ck_assert(run_ptests(filtered, &opts, "stats", fp_stdout, fp_stdout) == 1);
+
+	ck_assert_int_eq(stats_called, 1);
+	ck_assert(stats.spawn_us > 0);
+	ck_assert(stats.relay_us > 0);
+	/* gcc run-ptest writes "gcc\n". */
+	ck_assert(stats.bytes[0] >= 4);
+	ck_assert(stats.reads >= 2);
+	ck_assert(stats.polls >= stats.reads / 2);
+	ck_assert(stats.writes > 0);
+
+	PTEST_LIST_FREE_ALL_CLEAN(filtered);
+	ptest_list_free_all(head);
+	fclose(fp_stdout);
+	free(buf_stdout);
+}
+END_TEST
+
+START_TEST(test_run_ptests_output_cap)
+{
+	struct ptest_list *head = get_available_ptests(opts_directory);
+	struct ptest_list *filtered;
+	struct ptest_options opts = EmptyOpts;
+	char *ptests[] = {"bash"};
+	char *buf_stdout;
+	size_t size_stdout = PRINT_PTEST_BUF_SIZE;
+	FILE *fp_stdout;
+
+	fp_stdout = open_memstream(&buf_stdout, &size_stdout);
+	ck_assert(fp_stdout != NULL);
+
+	/* bash prints about 8 MiB, most of it on its last line. */
+	filtered = filter_ptests(head, ptests, 1);
+	opts.timeout = 5;
+	opts.output_head = 5;
+	opts.output_tail = 19;
+	ck_assert(run_ptests(filtered, &opts, "cap", fp_stdout, fp_stdout) == 0);
+	fflush(fp_stdout);
+	ck_assert(strstr(buf_stdout, "\nbash\n\n[... ") != NULL);
+	ck_assert(strstr(buf_stdout, " bytes of output dropped ...]\n"
+			"999999\\n 1000000\\n\n") != NULL);
+	ck_assert(size_stdout < PRINT_PTEST_BUF_SIZE);
+
+	opts.output_tail = 0;
+	opts.output_fail = 1;
+	ck_assert(run_ptests(filtered, &opts, "cap", fp_stdout, fp_stdout) == 1);
+	fflush(fp_stdout);
+	ck_assert(strstr(buf_stdout, "ERROR: Output cap exceeded") != NULL);
+
+	PTEST_LIST_FREE_ALL_CLEAN(filtered);
+	ptest_list_free_all(head);
+	fclose(fp_stdout);
+	free(buf_stdout);
 }
 END_TEST
 
@@ -353,8 +773,13 @@ utils_suite(void)
 	tcase_add_test(tc_core, test_filter_ptests);
 	tcase_add_test(tc_core, test_run_ptests);
 	tcase_add_test(tc_core, test_run_timeout_duration_ptest);
+	tcase_add_test(tc_core, test_run_deadline_heartbeat_ptest);
 	tcase_add_test(tc_core, test_run_signal_ptest);
 	tcase_add_test(tc_core, test_run_fail_ptest);
+	tcase_add_test(tc_core, test_run_fail_fast_ptest);
+	tcase_add_test(tc_core, test_run_ptests_callbacks);
+	tcase_add_test(tc_core, test_run_ptests_stats);
+	tcase_add_test(tc_core, test_run_ptests_output_cap);
 	tcase_add_test(tc_core, test_xml_pass);
 	tcase_add_test(tc_core, test_xml_fail);
 
@@ -365,7 +790,7 @@ utils_suite(void)
 
 static void
 test_ptest_expected_failure(struct ptest_list *head, const unsigned int timeout, char *progname,
-		void (*h_analyzer)(const int, FILE *))
+		const struct ptest_backend *backend, void (*h_analyzer)(const int, FILE *))
 {
 	char *buf_stdout;
 	size_t size_stdout = PRINT_PTEST_BUF_SIZE;
@@ -385,9 +810,10 @@ test_ptest_expected_failure(struct ptest_list *head, const unsigned int timeout,
 
 		struct ptest_options opts = EmptyOpts;
 		opts.timeout = timeout;
+		opts.backend = backend;
 
 		h_analyzer(
-			run_ptests(filtered, opts, progname, fp_stdout, fp_stderr),
+			run_ptests(filtered, &opts, progname, fp_stdout, fp_stderr),
 			fp_stdout
 		);
 
@@ -30,6 +30,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <grp.h>
+#include <inttypes.h>
 #include <libgen.h>
 #include <poll.h>
 #include <pty.h>
@@ -48,6 +49,15 @@
 #include <sys/wait.h>
 
 #include "ptest_list.h"
+#include "pool.h"
+#include "config.h"
+#include "history.h"
+#include "admission.h"
+#include "cgroup.h"
+#include "sandbox.h"
+#include "fixture.h"
+#include "report.h"
+#include "probes.h"
 #include "utils.h"
 
 #define GET_STIME_BUF_SIZE 1024
@@ -55,6 +65,12 @@
 
 #define UNUSED(x) (void)(x)
 
+#define PTEST_STATS_ADD(opts, field, value) \
+	do { \
+		if ((opts)->stats) \
+			(opts)->stats->field += (value); \
+	} while (0)
+
 enum {
 	PIPE_READ = 0,
 	PIPE_WRITE = 1,
@@ -71,6 +87,26 @@ get_stime(char *stime, size_t size, time_t t)
 	return stime;
 }
 
+int64_t
+ptest_clock_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int64_t
+ptest_clock_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 void
 check_allocation1(void *p, size_t size, char *file, int line, int exit_on_null)
 {
@@ -106,8 +142,8 @@ do_close(int *fd)
 }
 
 
-struct ptest_list *
-get_available_ptests(const char *dir)
+static struct ptest_list *
+available_ptests(const char *dir, struct ptest_pool *pool)
 {
 	struct ptest_list *head;
 	struct stat st_buf;
@@ -120,12 +156,12 @@ get_available_ptests(const char *dir)
 
 	if (realpath(dir, realdir) == NULL) {
 		fprintf(stderr, "ERROR: get_available_ptests failed to get realpath, %s\n", strerror(errno));
-		exit(1);
+		return NULL;
 	}
 
 	do
 	{
-		head = ptest_list_alloc();
+		head = ptest_list_alloc_pool(pool);
 		CHECK_ALLOCATION(head, sizeof(struct ptest_list *), 0);
 		if (head == NULL)
 			break;
@@ -150,56 +186,45 @@ get_available_ptests(const char *dir)
 
 		fail = 0;
 		for (i = 0; i < n; i++) {
-			char *run_ptest;
-
-			char *d_name = strdup(namelist[i]->d_name);
-			CHECK_ALLOCATION(d_name, sizeof(namelist[i]->d_name), 0);
-			if (d_name == NULL) {
-				fail = 1;
-				saved_errno = errno;
-				break;
-			}
+			char run_ptest[PATH_MAX];
+			char *d_name = namelist[i]->d_name;
+			char *ptest, *path;
 
 			if (strcmp(d_name, ".") == 0 ||
-			    strcmp(d_name, "..") == 0) {
-				free(d_name);
+			    strcmp(d_name, "..") == 0)
 				continue;
-			}
 
-			if (asprintf(&run_ptest, "%s/%s/ptest/run-ptest",
-			    realdir, d_name) == -1)  {
-				fail = 1;
-				saved_errno = errno;
-				free(d_name);
-				break;
-			}
+			if (snprintf(run_ptest, sizeof(run_ptest), "%s/%s/ptest/run-ptest",
+			    realdir, d_name) >= (int) sizeof(run_ptest))
+				continue;
 
-			if (stat(run_ptest, &st_buf) == -1) {
-				free(run_ptest);
-				free(d_name);
+			int stat_rc = stat(run_ptest, &st_buf);
+			PTEST_PROBE2(discovery_entry, d_name, stat_rc);
+			if (stat_rc == -1)
 				continue;
-			}
 
-			if (!S_ISREG(st_buf.st_mode)) {
-				free(run_ptest);
-				free(d_name);
+			if (!S_ISREG(st_buf.st_mode))
 				continue;
-			}
 
-			if (ptest_list_search_by_file(head, run_ptest, st_buf)) {
-				free(run_ptest);
-				free(d_name);
+			if (ptest_list_search_by_file(head, run_ptest, st_buf))
 				continue;
-			}
 
-			struct ptest_list *p = ptest_list_add(head,
-				d_name, run_ptest);
+			/* Only allocate once the ptest is known to be kept. */
+			ptest = ptest_list_strdup(pool, d_name);
+			path = ptest == NULL ? NULL : ptest_list_strdup(pool, run_ptest);
+			struct ptest_list *p = path == NULL ? NULL :
+				ptest_list_add(head, ptest, path);
+			if (p == NULL && pool != NULL) {
+				/* Out of budget, keep what fits and go on. */
+				pool->dropped++;
+				continue;
+			}
 			CHECK_ALLOCATION(p, sizeof(struct ptest_list *), 0);
 			if (p == NULL) {
 				fail = 1;
 				saved_errno = errno;
-				free(run_ptest);
-				free(d_name);
+				free(path);
+				free(ptest);
 				break;
 			}
 		}
@@ -218,6 +243,37 @@ get_available_ptests(const char *dir)
 	return head;
 }
 
+struct ptest_list *
+get_available_ptests(const char *dir)
+{
+	return available_ptests(dir, NULL);
+}
+
+struct ptest_list *
+get_available_ptests_dirs(char **dirs, int dirs_no, struct ptest_pool *pool,
+		FILE *fp_stderr)
+{
+	struct ptest_list *head = NULL;
+	int i;
+
+	for (i = 0; i < dirs_no; i++) {
+		struct ptest_list *tmp;
+
+		tmp = available_ptests(dirs[i], pool);
+		if (tmp == NULL) {
+			fprintf(fp_stderr, PRINT_PTESTS_NOT_FOUND_DIR, dirs[i]);
+			continue;
+		}
+
+		if (head == NULL)
+			head = tmp;
+		else
+			head = ptest_list_extend(head, tmp);
+	}
+
+	return head;
+}
+
 int
 print_ptests(struct ptest_list *head, FILE *fp)
 {
@@ -246,7 +302,7 @@ filter_ptests(struct ptest_list *head, char **ptests, int ptest_num)
 			break;
 		}
 
-		head_new = ptest_list_alloc();
+		head_new = ptest_list_alloc_pool(head->pool);
 		if (head_new == NULL)
 			break;
 
@@ -261,8 +317,8 @@ filter_ptests(struct ptest_list *head, char **ptests, int ptest_num)
 				break;
 			}
 
-			ptest = strdup(n->ptest);
-			run_ptest = strdup(n->run_ptest);
+			ptest = ptest_list_strdup(head->pool, n->ptest);
+			run_ptest = ptest_list_strdup(head->pool, n->run_ptest);
 			if (ptest == NULL || run_ptest == NULL) {
 				saved_errno = errno;
 				fail = 1;
@@ -324,42 +380,287 @@ collect_system_state(FILE* fout)
 }
 
 static inline void
-run_child(char *run_ptest, int fd_stdout, int fd_stderr)
+run_child(char *run_ptest, int fd_stdout, int fd_stderr, int separate_stderr)
 {
 	char *const argv[2] = {run_ptest, NULL};
 
 	dup2(fd_stdout, STDOUT_FILENO);
-	// XXX: Redirect stderr to stdout to avoid buffer ordering problems.
-	dup2(fd_stdout, STDERR_FILENO);
+	if (separate_stderr) {
+		/* Read apart and timestamped, see capture.h. */
+		dup2(fd_stderr, STDERR_FILENO);
+	} else {
+		// XXX: Redirect stderr to stdout to avoid buffer ordering problems.
+		dup2(fd_stdout, STDERR_FILENO);
+	}
 
 	/* since it isn't use by the child, close(fd_stderr) ? */
 	close(fd_stderr); /* try using to see if this fixes bash run-read. rwm todo */
 	close_fds();
 
+	PTEST_PROBE2(exec, run_ptest, getpid());
 	execv(run_ptest, argv);
+}
+
+/*
+ * Output of one stream of a ptest past its cap, the first head bytes
+ * are relayed as they come and only the last tail bytes are kept in a
+ * ring until the stream ends, whatever is in between is counted and
+ * dropped.
+ */
+struct output_cap {
+	size_t head;
+	size_t tail;
+	uint64_t seen;
+	size_t ring_len;
+	size_t ring_pos;
+	char *ring;
+};
+
+static void
+relay_output(const struct ptest_options *opts, const struct ptest_list *p,
+		int stream, const char *buf, size_t n, FILE *dest)
+{
+	if (n == 0)
+		return;
+
+	fwrite(buf, n, 1, dest);
+	PTEST_STATS_ADD(opts, writes, 1);
+	PTEST_STATS_ADD(opts, bytes[stream], (uint64_t) n);
+	PTEST_CALLBACK(opts, output, p, stream, buf, n);
+}
+
+static void
+relay_capped(const struct ptest_options *opts, const struct ptest_list *p,
+		int stream, const char *buf, size_t n, FILE *dest,
+		struct output_cap *cap)
+{
+	size_t keep = 0;
+
+	if (cap->seen < cap->head) {
+		keep = cap->head - (size_t) cap->seen;
+		if (keep > n)
+			keep = n;
+		relay_output(opts, p, stream, buf, keep, dest);
+	}
+	cap->seen += n;
+	buf += keep;
+	n -= keep;
+
+	if (cap->ring == NULL || n == 0)
+		return;
+	if (n > cap->tail) {
+		buf += n - cap->tail;
+		n = cap->tail;
+	}
+	while (n > 0) {
+		size_t chunk = cap->tail - cap->ring_pos;
+
+		if (chunk > n)
+			chunk = n;
+		memcpy(cap->ring + cap->ring_pos, buf, chunk);
+		cap->ring_pos = (cap->ring_pos + chunk) % cap->tail;
+		cap->ring_len += chunk;
+		if (cap->ring_len > cap->tail)
+			cap->ring_len = cap->tail;
+		buf += chunk;
+		n -= chunk;
+	}
+}
+
+/* Relays the marker and the kept tail, returns the bytes dropped. */
+static uint64_t
+relay_capped_end(const struct ptest_options *opts, const struct ptest_list *p,
+		int stream, FILE *dest, struct output_cap *cap)
+{
+	uint64_t dropped = 0;
+	char marker[128];
+
+	if (cap->seen > cap->head + cap->ring_len)
+		dropped = cap->seen - cap->head - cap->ring_len;
+	if (dropped > 0) {
+		int n = snprintf(marker, sizeof(marker),
+				"\n[... %" PRIu64 " bytes of output dropped ...]\n", dropped);
+		relay_output(opts, p, stream, marker, (size_t) n, dest);
+	}
+
+	/* Once the ring wrapped the oldest byte is at ring_pos. */
+	if (cap->ring_len == cap->tail) {
+		relay_output(opts, p, stream, cap->ring + cap->ring_pos,
+				cap->tail - cap->ring_pos, dest);
+		relay_output(opts, p, stream, cap->ring, cap->ring_pos, dest);
+	} else {
+		relay_output(opts, p, stream, cap->ring, cap->ring_len, dest);
+	}
+
+	free(cap->ring);
+	cap->ring = NULL;
+
+	return dropped;
+}
+
+/*
+ * Inactivity timeout and wall clock deadline in seconds for a ptest, a
+ * deadline of 0 means none. The deadline is derived from the history
+ * when opts->adaptive_factor is set, values from the config win.
+ */
+static void
+get_ptest_limits(const struct ptest_options *opts, const struct ptest_list *p,
+		unsigned int *timeout, unsigned int *deadline)
+{
+	*timeout = (unsigned int) ptest_config_get_int(opts->config, p->ptest,
+			"timeout", (int) opts->timeout);
+	*deadline = opts->deadline;
+
+	if (opts->history && opts->adaptive_factor > 0) {
+		struct ptest_history_entry *e;
+		int64_t p99 = -1;
+
+		e = ptest_history_find(opts->history, p->ptest);
+		if (e != NULL)
+			p99 = ptest_history_percentile(e, 99);
+		if (p99 >= 0) {
+			*deadline = (unsigned int) (p99 * opts->adaptive_factor / 1000 + 1);
+			if (*deadline < opts->adaptive_floor)
+				*deadline = opts->adaptive_floor;
+		}
+	}
+
+	*deadline = (unsigned int) ptest_config_get_int(opts->config, p->ptest,
+			"deadline", (int) *deadline);
+}
+
+static int64_t
+system_clock_ms(void *data)
+{
+	return ptest_clock_ms();
+}
+
+static int64_t
+system_clock_us(void *data)
+{
+	return ptest_clock_us();
+}
+
+static int64_t
+system_wall_ms(void *data)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static pid_t
+system_spawn(void *data, const struct ptest_list *p, int fd_out, int fd_err)
+{
+	return fork();
+}
+
+static int
+system_poll(void *data, struct pollfd *fds, nfds_t nfds, int timeout)
+{
+	return poll(fds, nfds, timeout);
+}
+
+static int
+system_kill(void *data, pid_t pid, int sig)
+{
+	return kill(pid, sig);
+}
+
+static pid_t
+system_wait(void *data, pid_t pid, int *status, int options,
+		struct rusage *ru)
+{
+	return wait4(pid, status, options, ru);
+}
+
+static const struct ptest_backend system_backend = {
+	.clock_ms = system_clock_ms,
+	.clock_us = system_clock_us,
+	.wall_ms = system_wall_ms,
+	.spawn = system_spawn,
+	.poll = system_poll,
+	.kill = system_kill,
+	.wait = system_wait,
+};
+
+const struct ptest_backend *
+ptest_backend_get(const struct ptest_backend *be)
+{
+	return be != NULL ? be : &system_backend;
+}
+
+int64_t
+ptest_backend_clock_ms(const struct ptest_backend *be)
+{
+	if (be == NULL)
+		be = &system_backend;
+
+	return be->clock_ms(be->data);
+}
+
+int64_t
+ptest_backend_clock_us(const struct ptest_backend *be)
+{
+	if (be == NULL)
+		be = &system_backend;
+
+	return be->clock_us(be->data);
+}
+
+int64_t
+ptest_backend_wall_ms(const struct ptest_backend *be)
+{
+	if (be == NULL)
+		be = &system_backend;
+
+	return be->wall_ms(be->data);
+}
 
-	/* exit(1); not needed? */
+/* Waits for ms on the backend clock, polling nothing. */
+void
+ptest_backend_sleep(const struct ptest_backend *be, int ms)
+{
+	if (be == NULL)
+		be = &system_backend;
+
+	be->poll(be->data, NULL, 0, ms);
 }
 
 int
-run_ptests(struct ptest_list *head, const struct ptest_options opts,
+run_ptests(struct ptest_list *head, const struct ptest_options *opts,
 		const char *progname, FILE *fp, FILE *fp_stderr)
 {
+	const struct ptest_backend *be = ptest_backend_get(opts->backend);
 	int rc = 0;
-	FILE *xh = NULL;
+	int failed_ptests = 0;
+	struct ptest_reporter *xml = NULL;
+	struct ptest_options xml_opts;
+	struct ptest_fixtures fixtures;
 
 	struct ptest_list *p;
 
-	if (opts.xml_filename) {
-		xh = xml_create(ptest_list_length(head), opts.xml_filename);
-		if (!xh)
-			exit(EXIT_FAILURE);
+	if (opts->xml_filename) {
+		xml = ptest_reporter_open_format(PTEST_REPORT_JUNIT, opts->xml_filename);
+		if (!xml)
+			return -1;
+
+		xml_opts = *opts;
+		xml->callbacks.next = opts->callbacks;
+		xml_opts.callbacks = &xml->callbacks;
+		opts = &xml_opts;
 	}
 
 	do
 	{
 
 		fprintf(fp, "START: %s\n", progname);
+		int64_t run_start_ms = be->clock_ms(be->data);
+		PTEST_CALLBACK(opts, run_start, ptest_list_length(head));
+		ptest_fixtures_init(&fixtures, opts->fixtures, opts->config,
+				opts->timeout, be);
 		PTEST_LIST_ITERATE_START(head, p)
 			char ptest_dir[PATH_MAX] = {'\0'};
 			int pipefd_stdout[2] = {-1, -1};
@@ -369,6 +670,80 @@ run_ptests(struct ptest_list *head, const struct ptest_options opts,
 			strcpy(ptest_dir, p->run_ptest);
 			dirname(ptest_dir);
 
+			/* Fixtures nothing from here on needs are stopped. */
+			ptest_fixtures_release(&fixtures, p, fp);
+
+			if (p->status == PTEST_STATUS_CACHED) {
+				fprintf(fp, "CACHED: %s\n", ptest_dir);
+				PTEST_CALLBACK(opts, skipped, p, "cached-pass");
+				continue;
+			}
+
+			if (opts->fail_fast > 0 && failed_ptests >= opts->fail_fast) {
+				fprintf(fp, "SKIPPED: %s\n", ptest_dir);
+				PTEST_CALLBACK(opts, skipped, p, "fail-fast");
+				continue;
+			}
+
+			int64_t budget_left_ms = (int64_t) opts->time_budget * 1000 -
+				(be->clock_ms(be->data) - run_start_ms);
+			if (p->status == PTEST_STATUS_BUDGET ||
+			    (opts->time_budget > 0 && budget_left_ms <= 0)) {
+				p->status = PTEST_STATUS_BUDGET;
+				fprintf(fp, "SKIPPED: %s\n", ptest_dir);
+				PTEST_CALLBACK(opts, skipped, p, "time-budget");
+				continue;
+			}
+
+			/* Its own result would only repeat the dependency's. */
+			if (ptest_depends_failed(head, p, opts->config) != NULL) {
+				fprintf(fp, "SKIPPED: %s\n", ptest_dir);
+				PTEST_CALLBACK(opts, skipped, p, "dependency");
+				continue;
+			}
+
+			/* Nothing ran, but the run is not green without it. */
+			if (ptest_fixtures_acquire(&fixtures, p, fp) == -1) {
+				fprintf(fp, "SKIPPED: %s\n", ptest_dir);
+				p->status = PTEST_STATUS_FAIL;
+				PTEST_CALLBACK(opts, skipped, p, "fixture");
+				failed_ptests++;
+				rc += 1;
+				continue;
+			}
+
+			/* Hold the launch back while the system is under pressure. */
+			if (opts->admission) {
+				int64_t waited = ptest_admission_wait(opts->admission,
+						p->ptest, be, fp);
+				PTEST_STATS_ADD(opts, admission_us, waited * 1000);
+			}
+
+			/* As for the sandbox, never run without the limits asked for. */
+			struct ptest_cgroup cg;
+			int cg_active = 0;
+			if (opts->cgroup) {
+				if (ptest_cgroup_create(&cg, opts->cgroup, p->ptest,
+				    opts->config) == -1) {
+					fprintf(fp, "ERROR: Unable to create cgroup for %s, %s\n",
+							p->ptest, strerror(errno));
+					fprintf(fp, "SKIPPED: %s\n", ptest_dir);
+					p->status = PTEST_STATUS_FAIL;
+					PTEST_CALLBACK(opts, skipped, p, "cgroup");
+					failed_ptests++;
+					rc += 1;
+					continue;
+				}
+				cg_active = 1;
+			}
+
+			int sandbox = ptest_config_get_int(opts->config, p->ptest,
+					"sandbox", opts->sandbox);
+			int netns = ptest_config_get_int(opts->config, p->ptest,
+					"netns", opts->netns);
+
+			int64_t spawn_start = opts->stats ? be->clock_us(be->data) : 0;
+
 			if (pipe2(pipefd_stdout, 0) == -1) {
 				fprintf(fp, "ERROR: pipe2() failed with: %s.\n", strerror(errno));
 				rc = -1;
@@ -387,7 +762,12 @@ run_ptests(struct ptest_list *head, const struct ptest_options opts,
 				goto ptest_list_fail3;
 			}
 
-			pid_t child = fork();
+			/* Nothing buffered may be written twice by the child. */
+			fflush(fp);
+			fflush(fp_stderr);
+
+			pid_t child = be->spawn(be->data, p, pipefd_stdout[PIPE_WRITE],
+					pipefd_stderr[PIPE_WRITE]);
 			if (child == -1) {
 				fprintf(fp, "ERROR: Fork %s\n", strerror(errno));
 				rc = -1;
@@ -403,6 +783,10 @@ run_ptests(struct ptest_list *head, const struct ptest_options opts,
 				if (setsid() ==  -1) {
 					fprintf(fp, "ERROR: setsid() failed, %s\n", strerror(errno));
 				}
+				if (cg_active && ptest_cgroup_enter(&cg) == -1) {
+					fprintf(fp, "ERROR: Unable to enter cgroup %s, %s\n", cg.path, strerror(errno));
+					goto child_fail;
+				}
 				if (ioctl(pty[1], TIOCSCTTY, NULL) == -1) {
 					fprintf(fp, "ERROR: Unable to attach to controlling tty, %s\n", strerror(errno));
 				}
@@ -412,22 +796,88 @@ run_ptests(struct ptest_list *head, const struct ptest_options opts,
 				}
 				do_close(&pty[1]);
 
-				if (chdir(ptest_dir) == -1) {
+				/* Same as the sandbox, no silent fallback to the host network. */
+				if (netns && ptest_netns_enter(fp) == -1)
+					goto child_fail;
+
+				if (sandbox) {
+					/*
+					 * Never run unconfined when a sandbox was asked for,
+					 * the absolute path may be hidden by the private /tmp.
+					 */
+					if (ptest_sandbox_enter(ptest_dir, fp) == 0)
+						run_child(SANDBOX_RUN_PTEST, pipefd_stdout[PIPE_WRITE],
+								pipefd_stderr[PIPE_WRITE], opts->separate_stderr);
+				} else if (chdir(ptest_dir) == -1) {
 					fprintf(fp, "ERROR: Unable to chdir(%s), %s\n", ptest_dir, strerror(errno));
 				} else {
-					run_child(p->run_ptest, pipefd_stdout[PIPE_WRITE], pipefd_stderr[PIPE_WRITE]);
+					run_child(p->run_ptest, pipefd_stdout[PIPE_WRITE],
+							pipefd_stderr[PIPE_WRITE], opts->separate_stderr);
 				}
+
+child_fail:
+				/* Never return into the caller's loop from the child. */
+				fflush(fp);
+				_exit(1);
 			} else {
-				bool timedout = false;
+				int timedout = PTEST_TIMEOUT_NONE;
 				char stime[GET_STIME_BUF_SIZE];
+				unsigned int timeout, deadline;
+				struct output_cap caps[2];
+				uint64_t dropped = 0;
+				int budget_capped = 0;
+
+				get_ptest_limits(opts, p, &timeout, &deadline);
+				/* Nothing runs past the end of the time budget. */
+				if (opts->time_budget > 0) {
+					unsigned int left = (unsigned int) ((budget_left_ms + 999) / 1000);
+
+					if (deadline == 0 || deadline > left) {
+						deadline = left;
+						budget_capped = 1;
+					}
+				}
+				PTEST_PROBE2(fork, p->ptest, child);
+
+				/* Caps apply to stdout and stderr each. */
+				int head = ptest_config_get_int(opts->config, p->ptest,
+						"output.head", (int) opts->output_head);
+				int tail = ptest_config_get_int(opts->config, p->ptest,
+						"output.tail", (int) opts->output_tail);
+				int capped = head > 0 || tail > 0;
+				memset(caps, 0, sizeof(caps));
+				for (int i = 0; capped && i < 2; i++) {
+					caps[i].head = head > 0 ? (size_t) head : 0;
+					caps[i].tail = tail > 0 ? (size_t) tail : 0;
+					if (caps[i].tail > 0) {
+						caps[i].ring = malloc(caps[i].tail);
+						CHECK_ALLOCATION(caps[i].ring, caps[i].tail, 0);
+						if (caps[i].ring == NULL) {
+							/* The child runs already, relay it all. */
+							fprintf(fp, "WARNING: Output of %s is not capped\n",
+									p->ptest);
+							free(caps[0].ring);
+							capped = 0;
+						}
+					}
+				}
 
 				/* Close write ends of the pipe, otherwise this process will never get EOF when the child dies */
 				do_close(&pipefd_stdout[PIPE_WRITE]);
 				do_close(&pipefd_stderr[PIPE_WRITE]);
+				if (opts->stats)
+					PTEST_STATS_ADD(opts, spawn_us,
+							be->clock_us(be->data) - spawn_start);
+
+				int64_t start_ms = be->clock_ms(be->data);
+				int64_t last_activity = start_ms;
+				int64_t next_heartbeat = start_ms + (int64_t) opts->heartbeat * 1000;
+				int64_t deadline_at = start_ms + (int64_t) deadline * 1000;
 
-				time_t start_time= time(NULL);
+				time_t start_time = (time_t) (be->wall_ms(be->data) / 1000);
 				fprintf(fp, "%s\n", get_stime(stime, GET_STIME_BUF_SIZE, start_time));
 				fprintf(fp, "BEGIN: %s\n", ptest_dir);
+				PTEST_CALLBACK(opts, start, p, child);
 
 				struct pollfd pfds[2];
 				FILE* dest_fps[2];
@@ -441,6 +891,9 @@ run_ptests(struct ptest_list *head, const struct ptest_options opts,
 				pfds[1].events = POLLIN;
 				dest_fps[1] = fp_stderr;
 
+				int64_t relay_start = opts->stats ? be->clock_us(be->data) : 0;
+				bool output_seen = false;
+				int64_t relay_report = opts->stats ? opts->stats->report_us : 0;
 				while (true) {
 					/*
 					 * Check all the poll file descriptors.
@@ -460,23 +913,69 @@ run_ptests(struct ptest_list *head, const struct ptest_options opts,
 						break;
 					}
 
-					int ret = poll(pfds, 2, opts.timeout*1000);
+					/*
+					 * The timeout is on output inactivity, wake
+					 * up earlier for the deadline and to emit
+					 * heartbeats.
+					 */
+					int64_t now = be->clock_ms(be->data);
+					int64_t wait_ms = (int64_t) timeout * 1000;
+					if (!timedout)
+						wait_ms -= now - last_activity;
+					if (!timedout && deadline > 0 && deadline_at - now < wait_ms)
+						wait_ms = deadline_at - now;
+					if (opts->heartbeat > 0 && next_heartbeat - now < wait_ms)
+						wait_ms = next_heartbeat - now;
+					if (wait_ms < 0)
+						wait_ms = 0;
+
+					int ret = be->poll(be->data, pfds, 2, (int) wait_ms);
+					PTEST_STATS_ADD(opts, polls, 1);
+
+					now = be->clock_ms(be->data);
+					if (ret > 0)
+						last_activity = now;
+
+					if (opts->heartbeat > 0 && now >= next_heartbeat) {
+						PTEST_CALLBACK(opts, heartbeat, p, now - start_ms);
+						next_heartbeat = now + (int64_t) opts->heartbeat * 1000;
+					}
+
+					int expired = PTEST_TIMEOUT_NONE;
+					if (!timedout && deadline > 0 && now >= deadline_at)
+						expired = PTEST_TIMEOUT_DEADLINE;
+					else if (ret == 0 && !timedout &&
+					    now - last_activity >= (int64_t) timeout * 1000)
+						expired = PTEST_TIMEOUT_INACTIVITY;
 
-					if (ret == 0 && !timedout) {
+					if (expired) {
 						/* kill the child if we haven't
 						 * already. Note that we
 						 * continue to read data from
 						 * the pipes until EOF to make
 						 * sure we get all the output
 						 */
-						kill(-child, SIGKILL);
-						timedout = true;
+						PTEST_PROBE3(timeout, p->ptest, child, expired);
+						PTEST_PROBE2(kill, p->ptest, child);
+						be->kill(be->data, -child, SIGKILL);
+						if (cg_active)
+							ptest_cgroup_kill(&cg);
+						timedout = expired;
+						p->timedout = timedout;
+						PTEST_CALLBACK(opts, timeout, p);
 					}
 
 					for (int i = 0; i < 2; i++) {
 						if (pfds[i].revents & (POLLIN | POLLHUP)) {
 							char buf[WAIT_CHILD_BUF_MAX_SIZE];
 							ssize_t n = read(pfds[i].fd, buf, sizeof(buf));
+							PTEST_STATS_ADD(opts, reads, 1);
+							if (n > 0 && !output_seen) {
+								output_seen = true;
+								PTEST_PROBE3(first_output, p->ptest, child,
+										be->clock_ms(be->data) - start_ms);
+							}
+							PTEST_PROBE4(read, p->ptest, child, i, n);
 
 							if (n == 0) {
 								/* Closed */
@@ -490,15 +989,31 @@ run_ptests(struct ptest_list *head, const struct ptest_options opts,
 									fprintf(stderr, "Error reading from stream %d: %s\n", i, strerror(errno));
 								}
 								continue;
+							} else if (capped) {
+								relay_capped(opts, p, i, buf, (size_t) n,
+										dest_fps[i], &caps[i]);
 							} else {
-								fwrite(buf, (size_t)n, 1, dest_fps[i]);
+								relay_output(opts, p, i, buf, (size_t) n, dest_fps[i]);
 							}
 						}
 					}
 				}
 
+				for (int i = 0; capped && i < 2; i++)
+					dropped += relay_capped_end(opts, p, i, dest_fps[i], &caps[i]);
+
+				/* Callbacks run from the loop are accounted as report time. */
+				if (opts->stats)
+					PTEST_STATS_ADD(opts, relay_us, be->clock_us(be->data) - relay_start -
+						(opts->stats->report_us - relay_report));
+
+				/* Stopped by the budget, not a failure of the ptest. */
+				int budget_cut = budget_capped &&
+					timedout == PTEST_TIMEOUT_DEADLINE;
+
 				if (timedout) {
-					collect_system_state(fp);
+					if (!budget_cut)
+						collect_system_state(fp);
 				} else {
 					/*
 					 * This kill is just in case the child did
@@ -508,37 +1023,79 @@ run_ptests(struct ptest_list *head, const struct ptest_options opts,
 					 * will just fail because the child is already
 					 * dead
 					 */
-					kill(-child, SIGKILL);
+					PTEST_PROBE2(kill, p->ptest, child);
+					be->kill(be->data, -child, SIGKILL);
 				}
 				int status;
-				waitpid(child, &status, 0);
-
-				time_t end_time = time(NULL);
-				time_t duration = end_time - start_time;
-
-				int exit_code = -1;
-				if (WIFEXITED(status)) {
-					exit_code = WEXITSTATUS(status);
-					if (exit_code) {
-						fprintf(fp, "\nERROR: Exit status is %d\n", exit_code);
+				struct rusage ru;
+				be->wait(be->data, child, &status, 0, &ru);
+				PTEST_PROBE3(reap, p->ptest, child, status);
+
+				time_t end_time = (time_t) (be->wall_ms(be->data) / 1000);
+				p->duration_ms = be->clock_ms(be->data) - start_ms;
+				p->utime_ms = (int64_t) ru.ru_utime.tv_sec * 1000 + ru.ru_utime.tv_usec / 1000;
+				p->stime_ms = (int64_t) ru.ru_stime.tv_sec * 1000 + ru.ru_stime.tv_usec / 1000;
+				p->maxrss_kb = ru.ru_maxrss;
+				if (cg_active)
+					ptest_cgroup_stats(&cg, &p->oom_killed, &p->memory_peak_kb);
+				time_t duration = (time_t) (p->duration_ms / 1000);
+
+				if (budget_cut) {
+					fprintf(fp, "DURATION: %d\n", (int) duration);
+					fprintf(fp, "SKIPPED: %s\n", ptest_dir);
+					p->status = PTEST_STATUS_BUDGET;
+					p->exit_code = -1;
+					p->signal = 0;
+					p->timedout = timedout;
+					PTEST_CALLBACK(opts, skipped, p, "time-budget");
+				} else {
+					int exit_code = -1;
+					int failed = rc;
+					p->signal = 0;
+					if (WIFEXITED(status)) {
+						exit_code = WEXITSTATUS(status);
+						if (exit_code) {
+							fprintf(fp, "\nERROR: Exit status is %d\n", exit_code);
+							rc += 1;
+						}
+					} else if (WIFSIGNALED(status)) {
+						int signal = WTERMSIG(status);
+						fprintf(fp, "\nERROR: Exited from signal %s (%d)\n", strsignal(signal), signal);
+						p->signal = signal;
+						rc += 1;
+					} else {
+						fprintf(fp, "\nERROR: Exited for unknown reason (%d)\n", status);
+						rc += 1;
+					}
+					if (p->oom_killed) {
+						fprintf(fp, "\nERROR: Killed by the OOM killer\n");
+						if (rc == failed)
+							rc += 1;
+					}
+					if (dropped > 0 && ptest_config_get_int(opts->config, p->ptest,
+					    "output.fail", opts->output_fail)) {
+						fprintf(fp, "\nERROR: Output cap exceeded, %" PRIu64
+								" bytes dropped\n", dropped);
+						if (rc == failed)
+							rc += 1;
+					}
+					fprintf(fp, "DURATION: %d\n", (int) duration);
+					if (timedout) {
+						if (timedout == PTEST_TIMEOUT_DEADLINE)
+							fprintf(fp, "ERROR: Deadline of %u seconds exceeded\n", deadline);
+						fprintf(fp, "TIMEOUT: %s\n", ptest_dir);
 						rc += 1;
 					}
-				} else if (WIFSIGNALED(status)) {
-					int signal = WTERMSIG(status);
-					fprintf(fp, "\nERROR: Exited from signal %s (%d)\n", strsignal(signal), signal);
-					rc += 1;
-				} else {
-					fprintf(fp, "\nERROR: Exited for unknown reason (%d)\n", status);
-					rc += 1;
-				}
-				fprintf(fp, "DURATION: %d\n", (int) duration);
-				if (timedout) {
-					fprintf(fp, "TIMEOUT: %s\n", ptest_dir);
-					rc += 1;
-				}
 
-				if (opts.xml_filename)
-					xml_add_case(xh, exit_code, ptest_dir, timedout, (int) duration);
+					p->status = rc > failed ? PTEST_STATUS_FAIL : PTEST_STATUS_PASS;
+					p->exit_code = exit_code;
+					p->timedout = timedout;
+					if (p->status == PTEST_STATUS_FAIL)
+						failed_ptests++;
+					PTEST_PROBE2(report_start, p->ptest, child);
+					PTEST_CALLBACK(opts, end, p);
+					PTEST_PROBE2(report_end, p->ptest, child);
+				}
 
 				fprintf(fp, "END: %s\n", ptest_dir);
 				fprintf(fp, "%s\n", get_stime(stime, GET_STIME_BUF_SIZE, end_time));
@@ -556,6 +1113,8 @@ ptest_list_fail2:
 			do_close(&pipefd_stdout[PIPE_WRITE]);
 
 ptest_list_fail1:
+			if (cg_active)
+				ptest_cgroup_destroy(&cg);
 			fflush(fp);
 			fflush(fp_stderr);
 
@@ -565,11 +1124,21 @@ ptest_list_fail1:
 			}
 
 		PTEST_LIST_ITERATE_END
+		ptest_fixtures_release(&fixtures, NULL, fp);
+		ptest_fixtures_free(&fixtures);
 		fprintf(fp, "STOP: %s\n", progname);
 	} while (0);
 
-	if (opts.xml_filename)
-		xml_finish(xh);
+	if (opts->stats) {
+		struct rusage ru;
+
+		getrusage(RUSAGE_SELF, &ru);
+		opts->stats->maxrss_kb = ru.ru_maxrss;
+		PTEST_CALLBACK(opts, stats, opts->stats);
+	}
+	PTEST_CALLBACK(opts, run_end, ptest_list_length(head), rc);
+
+	ptest_reporter_close(xml);
 
 	fflush(fp);
 	fflush(fp_stderr);
@@ -577,14 +1146,114 @@ ptest_list_fail1:
 	return rc;
 }
 
+void
+ptest_stats_print(FILE *fp, const struct ptest_stats *st)
+{
+	fprintf(fp, "STATS: discovery %.3f ms, filter %.3f ms, spawn %.3f ms,"
+			" relay %.3f ms, report %.3f ms, admission %.3f ms\n",
+			st->discovery_us / 1000.0, st->filter_us / 1000.0,
+			st->spawn_us / 1000.0, st->relay_us / 1000.0,
+			st->report_us / 1000.0, st->admission_us / 1000.0);
+	fprintf(fp, "STATS: stdout %ju bytes, stderr %ju bytes, read %ju,"
+			" write %ju, poll %ju, maxrss %ld kB\n",
+			(uintmax_t) st->bytes[0], (uintmax_t) st->bytes[1],
+			(uintmax_t) st->reads, (uintmax_t) st->writes,
+			(uintmax_t) st->polls, st->maxrss_kb);
+}
+
+void
+json_print_string(FILE *fp, const char *s, size_t len)
+{
+	size_t i;
+
+	fputc('"', fp);
+	for (i = 0; i < len; i++) {
+		unsigned char c = (unsigned char) s[i];
+
+		switch (c) {
+			case '"':
+				fputs("\\\"", fp);
+			break;
+			case '\\':
+				fputs("\\\\", fp);
+			break;
+			case '\n':
+				fputs("\\n", fp);
+			break;
+			case '\r':
+				fputs("\\r", fp);
+			break;
+			case '\t':
+				fputs("\\t", fp);
+			break;
+			default:
+				if (c < 0x20 || c == 0x7f)
+					fprintf(fp, "\\u%04x", c);
+				else
+					fputc(c, fp);
+		}
+	}
+	fputc('"', fp);
+}
+
+static void
+xml_print_escaped(FILE *xh, const char *s)
+{
+	for (; *s != '\0'; s++) {
+		switch (*s) {
+			case '&':
+				fputs("&amp;", xh);
+			break;
+			case '<':
+				fputs("&lt;", xh);
+			break;
+			case '>':
+				fputs("&gt;", xh);
+			break;
+			case '\'':
+				fputs("&apos;", xh);
+			break;
+			case '"':
+				fputs("&quot;", xh);
+			break;
+			default:
+				fputc(*s, xh);
+		}
+	}
+}
+
+/*
+ * Keep the file a complete document after every testcase: the closing
+ * tag is written and flushed, then the position moves back onto it so
+ * the next testcase overwrites it. A killed run leaves valid XML.
+ */
+static void
+xml_write_footer(FILE *xh)
+{
+	long pos = ftell(xh);
+
+	fprintf(xh, "</testsuite>\n");
+	fflush(xh);
+
+	if (pos != -1)
+		fseek(xh, pos, SEEK_SET);
+}
+
+void
+xml_start(FILE *xh, int test_count)
+{
+	fprintf(xh, "<?xml version='1.0' encoding='UTF-8'?>\n");
+	fprintf(xh, "<testsuite name='ptest' tests='%d'>\n", test_count);
+	xml_write_footer(xh);
+}
+
 FILE *
 xml_create(int test_count, char *xml_filename)
 {
 	FILE *xh;
 
 	if ((xh = fopen(xml_filename, "w"))) {
-		fprintf(xh, "<?xml version='1.0' encoding='UTF-8'?>\n");
-		fprintf(xh, "<testsuite name='ptest' tests='%d'>\n", test_count);
+		xml_start(xh, test_count);
 	} else {
 		fprintf(stderr, "XML File '%s' could not be created. %s.\n",
 				xml_filename, strerror(errno));
@@ -594,10 +1263,13 @@ xml_create(int test_count, char *xml_filename)
 	return xh;
 }
 
-void
-xml_add_case(FILE *xh, int status, const char *ptest_dir, int timeouted, int duration)
+static void
+xml_write_case(FILE *xh, int status, const char *ptest_dir, int timeouted,
+		int oom_killed, int duration)
 {
-	fprintf(xh, "\t<testcase classname='%s' name='run-ptest'>\n", ptest_dir);
+	fprintf(xh, "\t<testcase classname='");
+	xml_print_escaped(xh, ptest_dir);
+	fprintf(xh, "' name='run-ptest'>\n");
 	fprintf(xh, "\t\t<duration>%d</duration>\n", duration);
 
 	if (status != 0) {
@@ -607,8 +1279,38 @@ xml_add_case(FILE *xh, int status, const char *ptest_dir, int timeouted, int dur
 	}
 	if (timeouted)
 		fprintf(xh, "\t\t<failure type='timeout'/>\n");
+	if (oom_killed)
+		fprintf(xh, "\t\t<failure type='oom' message='%d processes killed"
+				" by the OOM killer'/>\n", oom_killed);
+
+	fprintf(xh, "\t</testcase>\n");
+	xml_write_footer(xh);
+}
 
+void
+xml_add_case(FILE *xh, int status, const char *ptest_dir, int timeouted, int duration)
+{
+	xml_write_case(xh, status, ptest_dir, timeouted, 0, duration);
+}
+
+void
+xml_add_result(FILE *xh, const struct ptest_list *p, const char *ptest_dir)
+{
+	xml_write_case(xh, p->exit_code, ptest_dir, p->timedout, p->oom_killed,
+			(int) (p->duration_ms / 1000));
+}
+
+void
+xml_add_skipped(FILE *xh, const char *ptest_dir, const char *message)
+{
+	fprintf(xh, "\t<testcase classname='");
+	xml_print_escaped(xh, ptest_dir);
+	fprintf(xh, "' name='run-ptest'>\n");
+	fprintf(xh, "\t\t<skipped message='");
+	xml_print_escaped(xh, message);
+	fprintf(xh, "'/>\n");
 	fprintf(xh, "\t</testcase>\n");
+	xml_write_footer(xh);
 }
 
 void
@@ -24,8 +24,18 @@
 #ifndef PTEST_RUNNER_UTILS_H
 #define PTEST_RUNNER_UTILS_H
 
+#include <poll.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+
 #include "ptest_list.h"
 
+struct ptest_config;
+struct ptest_history;
+struct ptest_admission;
+
 #define PRINT_PTESTS_NOT_FOUND "No ptests found.\n"
 #define PRINT_PTESTS_NOT_FOUND_DIR "Warning: ptests not found in, %s.\n"
 #define PRINT_PTESTS_AVAILABLE "Available ptests:\n"
@@ -33,27 +43,148 @@
 #define CHECK_ALLOCATION(p, size, exit_on_null) \
 	check_allocation1(p, size, __FILE__, __LINE__, exit_on_null)
 
+/*
+ * Runner self instrumentation, times are in microseconds. discovery_us
+ * and filter_us are filled in by the caller, run_ptests() adds the rest
+ * when opts->stats is set. report_us is the time spent in callbacks.
+ */
+struct ptest_stats {
+	int64_t discovery_us;
+	int64_t filter_us;
+	int64_t spawn_us;
+	int64_t relay_us;
+	int64_t report_us;
+	int64_t admission_us;
+	uint64_t bytes[2];
+	uint64_t reads;
+	uint64_t writes;
+	uint64_t polls;
+	long maxrss_kb;
+};
+
+/*
+ * Hooks called from run_ptests(), several can be chained through next.
+ * The ptest passed to start, output, timeout and heartbeat is the one
+ * running, end is called once its status, exit_code, signal, timedout,
+ * duration_ms and resource usage are filled in. heartbeat gets the
+ * elapsed milliseconds every opts->heartbeat seconds. stats is called
+ * before run_end when opts->stats is set. Unused hooks can be left NULL.
+ */
+struct ptest_callbacks {
+	void (*run_start)(void *, int);
+	void (*start)(void *, const struct ptest_list *, pid_t);
+	void (*output)(void *, const struct ptest_list *, int, const char *, size_t);
+	void (*timeout)(void *, const struct ptest_list *);
+	void (*heartbeat)(void *, const struct ptest_list *, int64_t);
+	void (*end)(void *, const struct ptest_list *);
+	void (*skipped)(void *, const struct ptest_list *, const char *);
+	void (*run_end)(void *, int, int);
+	void (*stats)(void *, const struct ptest_stats *);
+
+	void *data;
+	struct ptest_callbacks *next;
+};
+
+/*
+ * What run_ptests() needs from the system to run a ptest: the monotonic
+ * clock in milliseconds and microseconds, the wall clock in milliseconds
+ * for the log stamps, a fork(2)
+ * like spawn given the write ends of the stdout and stderr pipes, and
+ * poll(2), kill(2) and wait4(2) on the spawned child, the rusage may be
+ * NULL. Fixture scripts are spawned the same way. The default is
+ * the real system, tests put a simulated timeline and fake children
+ * behind it. Pipes stay real, a fake spawn writes the output into them.
+ */
+struct ptest_backend {
+	int64_t (*clock_ms)(void *);
+	int64_t (*clock_us)(void *);
+	int64_t (*wall_ms)(void *);
+	pid_t (*spawn)(void *, const struct ptest_list *, int, int);
+	int (*poll)(void *, struct pollfd *, nfds_t, int);
+	int (*kill)(void *, pid_t, int);
+	pid_t (*wait)(void *, pid_t, int *, int, struct rusage *);
+
+	void *data;
+};
+
 struct ptest_options {
 	char **dirs;
 	int dirs_no;
 	int padding1;
 	char **exclude;
+	int exclude_no;
 	int list;
 	unsigned int timeout;
+	unsigned int heartbeat;
+	int fail_fast;
 	char **ptests;
 	char *xml_filename;
+	char *cache_filename;
+	char **cache_env;
+	int cache_env_no;
+	int cache_max_age;
+	struct ptest_callbacks *callbacks;
+	struct ptest_stats *stats;
+	struct ptest_config *config;
+	struct ptest_history *history;
+	struct ptest_admission *admission;
+	char *cgroup;
+	double adaptive_factor;
+	unsigned int deadline;
+	unsigned int adaptive_floor;
+	int sandbox;
+	int netns;
+	int separate_stderr;
+	int output_fail;
+	unsigned int output_head;
+	unsigned int output_tail;
+	unsigned int time_budget;
+	int padding2;
+	const struct ptest_backend *backend;
+	char *fixtures;
 };
 
+/* Runs hook cb of every client of the chain, timed as report overhead. */
+#define PTEST_CALLBACK(opts, cb, ...) \
+	do { \
+		struct ptest_callbacks *c; \
+		int64_t cb_start = (opts)->stats ? \
+			ptest_backend_clock_us((opts)->backend) : 0; \
+		for (c = (opts)->callbacks; c != NULL; c = c->next) \
+			if (c->cb != NULL) \
+				c->cb(c->data, __VA_ARGS__); \
+		if ((opts)->stats) \
+			(opts)->stats->report_us += \
+				ptest_backend_clock_us((opts)->backend) - cb_start; \
+	} while (0)
+
 
+extern int64_t ptest_clock_ms(void);
+extern int64_t ptest_clock_us(void);
+/* be itself, or the real system for NULL. */
+extern const struct ptest_backend *ptest_backend_get(const struct ptest_backend *);
+/* Clocks and sleep of a backend, the real system for NULL. */
+extern int64_t ptest_backend_clock_ms(const struct ptest_backend *);
+extern int64_t ptest_backend_clock_us(const struct ptest_backend *);
+extern int64_t ptest_backend_wall_ms(const struct ptest_backend *);
+extern void ptest_backend_sleep(const struct ptest_backend *, int);
 extern void check_allocation1(void *, size_t, char *, int, int);
 extern struct ptest_list *get_available_ptests(const char *);
+extern struct ptest_list *get_available_ptests_dirs(char **, int,
+		struct ptest_pool *, FILE *);
 extern int print_ptests(struct ptest_list *, FILE *);
 extern struct ptest_list *filter_ptests(struct ptest_list *, char **, int);
-extern int run_ptests(struct ptest_list *, const struct ptest_options,
+extern int run_ptests(struct ptest_list *, const struct ptest_options *,
 		const char *, FILE *, FILE *);
 
+extern void json_print_string(FILE *, const char *, size_t);
+extern void ptest_stats_print(FILE *, const struct ptest_stats *);
+
+extern void xml_start(FILE *, int);
 extern FILE *xml_create(int, char *);
 extern void xml_add_case(FILE *, int, const char *, int, int);
+extern void xml_add_result(FILE *, const struct ptest_list *, const char *);
+extern void xml_add_skipped(FILE *, const char *, const char *);
 extern void xml_finish(FILE *);
 
 void set_opts_dir(char * od);